@@ -35,10 +35,14 @@
 
 #include "packet-service.h"
 
+#include <string.h>
+
 #include "rtl8019dev.h"
 
 #include "uip_arp.h"
 
+#include "tcpip.h"
+
 static void output(u8_t *hdr, u16_t hdrlen, u8_t *data, u16_t datalen);
 
 static const struct packet_service_state state =
@@ -89,6 +93,29 @@ EK_EVENTHANDLER(eventhandler, ev, data)
 EK_POLLHANDLER(pollhandler)
 {
 #define BUF ((struct uip_eth_hdr *)&uip_buf[0])
+#if UIP_INPUT_RING > 0
+  u8_t *slot;
+  u16_t len;
+
+  /* Read all frames that the device has received into the input
+     ring, and hand them to the stack as one burst. ARP frames are
+     processed directly. */
+  while((slot = tcpip_input_slot()) != NULL &&
+	(len = RTL8019dev_read(slot)) > 0) {
+    if(((struct uip_eth_hdr *)slot)->type == HTONS(UIP_ETHTYPE_IP)) {
+      tcpip_input_put(len - sizeof(struct uip_eth_hdr));
+    } else if(((struct uip_eth_hdr *)slot)->type == HTONS(UIP_ETHTYPE_ARP)) {
+      memcpy(uip_buf, slot, len);
+      uip_len = len;
+      uip_arp_arpin();
+      if(uip_len > 0) {
+	RTL8019dev_send();
+      }
+    }
+  }
+  uip_len = 0;
+  tcpip_input();
+#else /* UIP_INPUT_RING > 0 */
   
   /* Poll Ethernet device to see if there is a frame avaliable. */
   uip_len = RTL8019dev_poll();
@@ -109,6 +136,6 @@ EK_POLLHANDLER(pollhandler)
       }
     }
   }
-
+#endif /* UIP_INPUT_RING > 0 */
 }
 /*---------------------------------------------------------------------------*/
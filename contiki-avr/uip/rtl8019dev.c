@@ -53,6 +53,12 @@ void RTL8019dev_send(void)
 
 
 unsigned int RTL8019dev_poll(void)
+{
+	return RTL8019dev_read(uip_buf);
+}
+
+
+unsigned int RTL8019dev_read(unsigned char *buf)
 {
 	unsigned int packetLength;
 	
@@ -69,8 +75,8 @@ unsigned int RTL8019dev_poll(void)
       return 0;
 	}
 	
-	// copy the packet data into the uIP packet buffer
-	RTL8019retreivePacketData( uip_buf, packetLength );
+	// copy the packet data into the given packet buffer
+	RTL8019retreivePacketData( buf, packetLength );
 	RTL8019endPacketRetreive();
 		
 	return packetLength;
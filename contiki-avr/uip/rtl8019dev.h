@@ -57,4 +57,13 @@ void RTL8019dev_send(void);
 unsigned int RTL8019dev_poll(void);
 
 
+/*****************************************************************************
+*  unsigned int RTL8019dev_read(unsigned char *buf)
+*  Returns:     Length of the packet retreived, or zero if no packet retreived
+*  Description: Like RTL8019dev_poll(), but stores the packet in buf, which
+*                 must be UIP_BUFSIZE bytes large, instead of in uip_buf
+*****************************************************************************/
+unsigned int RTL8019dev_read(unsigned char *buf);
+
+
 #endif /* __RTL8019DEV_H__ */
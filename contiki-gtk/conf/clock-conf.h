@@ -2,6 +2,8 @@
 #define __CLOCK_CONF_H__
 
 typedef unsigned long clock_time_t;
+#ifndef CLOCK_CONF_SECOND
 #define CLOCK_CONF_SECOND 1000
+#endif /* CLOCK_CONF_SECOND */
 
 #endif /* __CLOCK_CONF_H__ */
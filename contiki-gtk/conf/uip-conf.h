@@ -34,7 +34,9 @@
  */
 #ifndef __UIP_CONF_H__
 
+#ifndef UIP_CONF_MAX_CONNECTIONS
 #define UIP_CONF_MAX_CONNECTIONS 40
+#endif /* UIP_CONF_MAX_CONNECTIONS */
 #define UIP_CONF_MAX_LISTENPORTS 40
 #define UIP_CONF_BUFFER_SIZE     800
 
@@ -0,0 +1,540 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+
+/*
+ * A benchmark that runs two uIP stacks in the same process, connected
+ * by the loopback device (see loopdev.h). The client stack runs a
+ * bulk transfer, a request/response test and a connection rate test
+ * against the server stack, one after the other.
+ *
+ * Time is virtual: the clock counts microseconds, and the main loop
+ * moves it forward to the next packet arrival or timer deadline
+ * whenever there is nothing left to do. The results therefore show
+ * the behaviour of the TCP implementation over the shaped link, and
+ * do not depend on the speed of the host. The host time that each
+ * test takes is shown as well.
+ *
+ * With -w, the packets that the stacks send are written to a file in
+ * the pcap format (see tcpdump.h).
+ */
+
+#include "ek.h"
+#include "clock.h"
+#include "timer.h"
+
+#include "uip.h"
+#include "tcpip.h"
+#include "uip-fw.h"
+#include "uip-fw-service.h"
+#include "loopdev.h"
+#include "tcpdump.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+
+#define CLIENT 0
+#define SERVER 1
+
+#define BULK_PORT 5001
+#define RR_PORT   5002
+#define CRR_PORT  5003
+
+/* The sizes of the requests and responses of the request/response
+   test. */
+#define REQSIZE  64
+#define RESPSIZE 64
+
+/* The largest number of latency samples that are kept. */
+#define SAMPLES 10000
+
+enum {
+  TEST_BULK,
+  TEST_RR,
+  TEST_CRR,
+  TEST_DONE
+};
+
+static const char *names[] = {"bulk", "rr", "crr"};
+
+static unsigned long bulksize = 1000000;
+static unsigned long count = 1000;
+
+static struct uip_fw_netif loopif[2] =
+  {{UIP_FW_NETIF(0,0,0,0, 0,0,0,0, loopdev_output)},
+   {UIP_FW_NETIF(0,0,0,0, 0,0,0,0, loopdev_output)}};
+
+static clock_time_t now;
+
+/* The state of the test that the client is running. */
+static struct {
+  u8_t test;
+  unsigned long done, errors;
+  unsigned long acked;
+  u16_t unacked, received;
+  struct uip_conn *conn;
+  clock_time_t start, sent;
+  struct timeval wallstart;
+  unsigned long packets;
+} c;
+
+static clock_time_t samples[SAMPLES];
+static unsigned long nsamples;
+
+static u8_t pattern[UIP_TCP_MSS];
+
+static u16_t rrreceived;
+
+static ek_event_t next;
+
+static int capture = -1;
+
+EK_EVENTHANDLER(client_eventhandler, ev, data);
+EK_PROCESS(client, "Benchmark client", EK_PRIO_NORMAL,
+	   client_eventhandler, NULL, NULL);
+
+EK_EVENTHANDLER(server_eventhandler, ev, data);
+EK_PROCESS(server, "Benchmark server", EK_PRIO_NORMAL,
+	   server_eventhandler, NULL, NULL);
+
+/*-----------------------------------------------------------------------------------*/
+clock_time_t
+clock_time(void)
+{
+  return now;
+}
+/*-----------------------------------------------------------------------------------*/
+static unsigned long
+packets(void)
+{
+  return loopdev_stats[CLIENT].packets + loopdev_stats[SERVER].packets;
+}
+/*-----------------------------------------------------------------------------------*/
+static int
+compare(const void *a, const void *b)
+{
+  clock_time_t x = *(const clock_time_t *)a, y = *(const clock_time_t *)b;
+
+  return x < y? -1: x > y;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+sample(clock_time_t t)
+{
+  if(nsamples < SAMPLES) {
+    samples[nsamples++] = t;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Print the results of the test that has just finished and start the
+   next one. The rates are per virtual second. */
+static void
+report(unsigned long bytes)
+{
+  struct timeval wallend;
+  double secs, wallsecs;
+  unsigned long n;
+
+  gettimeofday(&wallend, NULL);
+  secs = (double)(now - c.start) / CLOCK_SECOND;
+  wallsecs = (wallend.tv_sec - c.wallstart.tv_sec) +
+    (wallend.tv_usec - c.wallstart.tv_usec) / 1e6;
+  if(secs == 0) {
+    secs = 1.0 / CLOCK_SECOND;
+  }
+  n = packets() - c.packets;
+
+  printf("%-4s %8.3f s %10.0f packets/s %12.0f bytes/s",
+	 names[c.test], secs, n / secs, bytes / secs);
+  if(c.test != TEST_BULK) {
+    printf(" %10.0f trans/s", c.done / secs);
+  }
+  if(nsamples > 0) {
+    qsort(samples, nsamples, sizeof(clock_time_t), compare);
+    printf("  p50 %lu us  p99 %lu us",
+	   (unsigned long)(samples[nsamples * 50 / 100] *
+			   1000000 / CLOCK_SECOND),
+	   (unsigned long)(samples[nsamples * 99 / 100] *
+			   1000000 / CLOCK_SECOND));
+  }
+  if(c.errors > 0) {
+    printf("  %lu errors", c.errors);
+  }
+  printf("  (%.3f s host, %.0f packets/s)\n", wallsecs,
+	 wallsecs > 0? n / wallsecs: 0);
+
+  c.done = 0;
+  if(++c.test != TEST_DONE) {
+    ek_post(EK_PROC_ID(&client), next, NULL);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+open_conn(u16_t port)
+{
+  u16_t addr[2];
+
+  uip_setcontext(CLIENT);
+  uip_ipaddr(addr, 10,0,0,2);
+  c.sent = clock_time();
+  c.unacked = c.received = 0;
+  c.conn = tcp_connect(addr, HTONS(port), NULL);
+  if(c.conn == NULL) {
+    fprintf(stderr, "contiki-bench: out of connections\n");
+    exit(1);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+start(void)
+{
+  c.errors = 0;
+  c.acked = 0;
+  nsamples = 0;
+  c.start = clock_time();
+  gettimeofday(&c.wallstart, NULL);
+  c.packets = packets();
+
+  switch(c.test) {
+  case TEST_BULK:
+    open_conn(BULK_PORT);
+    break;
+  case TEST_RR:
+    open_conn(RR_PORT);
+    break;
+  case TEST_CRR:
+    open_conn(CRR_PORT);
+    break;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Called when the connection of the current test has been closed,
+   aborted or has timed out. */
+static void
+closed(void)
+{
+  if(!uip_closed()) {
+    ++c.errors;
+  }
+
+  switch(c.test) {
+  case TEST_BULK:
+    report(c.acked);
+    break;
+  case TEST_RR:
+    report((unsigned long)c.done * (REQSIZE + RESPSIZE));
+    break;
+  case TEST_CRR:
+    if(uip_closed() && c.received == RESPSIZE) {
+      sample(clock_time() - c.sent);
+    } else if(uip_closed()) {
+      ++c.errors;
+    }
+    if(++c.done == count) {
+      report((unsigned long)c.done * (REQSIZE + RESPSIZE));
+    } else {
+      ek_post(EK_PROC_ID(&client), next, NULL);
+    }
+    break;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Send bulksize bytes and close the connection once all of them have
+   been acknowledged. */
+static void
+bulk_appcall(void)
+{
+  u16_t len;
+
+  if(uip_acked()) {
+    c.acked += c.unacked;
+    c.unacked = 0;
+    if(c.acked == bulksize) {
+      uip_close();
+      return;
+    }
+  }
+
+  if(uip_rexmit()) {
+    uip_send(pattern, c.unacked);
+  } else if(c.unacked == 0 && c.acked < bulksize &&
+	    (uip_connected() || uip_acked() || uip_poll())) {
+    len = uip_mss();
+    if(bulksize - c.acked < len) {
+      len = bulksize - c.acked;
+    }
+    uip_send(pattern, len);
+    c.unacked = len;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Send a request as soon as the response to the previous one has
+   arrived, and measure the time from request to response. The
+   connection rate test sends a single request on every connection,
+   and the server then closes the connection. */
+static void
+rr_appcall(void)
+{
+  if(uip_acked()) {
+    c.unacked = 0;
+  }
+
+  if(uip_connected()) {
+    if(c.test == TEST_RR) {
+      c.sent = clock_time();
+    }
+    uip_send(pattern, REQSIZE);
+    c.unacked = REQSIZE;
+  } else if(uip_newdata()) {
+    c.received += uip_datalen();
+    if(c.test == TEST_RR && c.received >= RESPSIZE) {
+      c.received -= RESPSIZE;
+      sample(clock_time() - c.sent);
+      if(++c.done == count) {
+	uip_close();
+      } else {
+	c.sent = clock_time();
+	uip_send(pattern, REQSIZE);
+	c.unacked = REQSIZE;
+      }
+    }
+  } else if(uip_rexmit() && c.unacked > 0) {
+    uip_send(pattern, c.unacked);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+EK_EVENTHANDLER(client_eventhandler, ev, data)
+{
+  EK_EVENTHANDLER_ARGS(ev, data);
+
+  if(ev == EK_EVENT_INIT) {
+    next = ek_alloc_event();
+    c.test = TEST_BULK;
+    start();
+  } else if(ev == next) {
+    if(c.test == TEST_CRR && c.done > 0) {
+      /* The next connection of the connection rate test. */
+      open_conn(CRR_PORT);
+    } else {
+      start();
+    }
+  } else if(ev == tcpip_event && uip_conn == c.conn) {
+    /* uIP reports a connection that the remote host has closed
+       again when our FIN has been acknowledged, so the connection is
+       forgotten the first time. */
+    if(uip_closed() || uip_aborted() || uip_timedout()) {
+      c.conn = NULL;
+      closed();
+    } else if(c.test == TEST_BULK) {
+      bulk_appcall();
+    } else {
+      rr_appcall();
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* The server discards the bulk data and answers each request with a
+   response. It closes the connections of the connection rate test
+   once the response has been acknowledged, and lets the client close
+   the other connections. */
+EK_EVENTHANDLER(server_eventhandler, ev, data)
+{
+  EK_EVENTHANDLER_ARGS(ev, data);
+
+  if(ev == EK_EVENT_INIT) {
+    uip_setcontext(SERVER);
+    tcp_listen(HTONS(BULK_PORT));
+    tcp_listen(HTONS(RR_PORT));
+    tcp_listen(HTONS(CRR_PORT));
+  } else if(ev == tcpip_event && uip_conn->lport != HTONS(BULK_PORT)) {
+    if(uip_connected()) {
+      rrreceived = 0;
+    }
+    if(uip_acked() && uip_conn->lport == HTONS(CRR_PORT)) {
+      uip_close();
+    } else if(uip_newdata()) {
+      rrreceived += uip_datalen();
+      if(rrreceived >= REQSIZE) {
+	rrreceived -= REQSIZE;
+	uip_send(pattern, RESPSIZE);
+      }
+    } else if(uip_rexmit()) {
+      uip_send(pattern, RESPSIZE);
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Run Contiki until there is nothing more to do, as in evloop.c. */
+static void
+run(void)
+{
+  do {
+    while(ek_run() > 0);
+    timer_next_clear();
+  } while(ek_run() > 0 || ek_poll_request);
+}
+/*-----------------------------------------------------------------------------------*/
+static int
+write_capture(int fd, char *buf, unsigned int len)
+{
+  return write(fd, buf, len);
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+flush_capture(void)
+{
+  if(capture != -1 && tcpdump_capture_flush(write_capture, capture) == -1) {
+    perror("contiki-bench: write");
+    exit(1);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: contiki-bench [-b bulk bytes] [-n transactions]"
+	  " [-d delay us] [-r rate bytes/s] [-l loss %%] [-w file]\n");
+  exit(1);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  static struct tcpdump_filter filter;
+  unsigned long delay, rate, loss;
+  clock_time_t interval, arrival;
+  u16_t addr[2];
+  int opt, set;
+  u8_t i;
+
+  delay = 100;
+  rate = 12500000;
+  loss = 0;
+  while((opt = getopt(argc, argv, "b:n:d:r:l:w:")) != -1) {
+    switch(opt) {
+    case 'b':
+      bulksize = strtoul(optarg, NULL, 0);
+      break;
+    case 'n':
+      count = strtoul(optarg, NULL, 0);
+      break;
+    case 'd':
+      delay = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      rate = strtoul(optarg, NULL, 0);
+      break;
+    case 'l':
+      loss = strtoul(optarg, NULL, 0);
+      break;
+    case 'w':
+      capture = open(optarg, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if(capture == -1) {
+	perror(optarg);
+	exit(1);
+      }
+      break;
+    default:
+      usage();
+    }
+  }
+  if(count == 0 || loss > 100) {
+    usage();
+  }
+
+  printf("link: delay %lu us, rate %lu bytes/s, loss %lu%%, mss %d\n",
+	 delay, rate, loss, UIP_TCP_MSS);
+  
+  ek_init();
+
+  tcpip_init(NULL);
+  uip_fw_service_init(NULL);
+
+  loopdev_init();
+  loopdev_connect(CLIENT, SERVER);
+  loopdev_shape(delay * CLOCK_SECOND / 1000000, rate, loss);
+
+  for(i = CLIENT; i <= SERVER; ++i) {
+    uip_setcontext(i);
+    uip_ipaddr(addr, 10,0,0,1 + i);
+    uip_sethostaddr(addr);
+    uip_ipaddr(addr, 255,255,255,0);
+    uip_setnetmask(addr);
+    uip_fw_init();
+    uip_fw_default(&loopif[i]);
+  }
+  
+  /* Every packet crosses the link from the stack that sends it to the
+     stack that receives it, so only the sent packets are captured. */
+  if(capture != -1) {
+    filter.dir = TCPDUMP_OUT;
+    tcpdump_capture_start(&filter);
+  }
+
+  ek_start(&server);
+  ek_start(&client);
+
+  /* Move the clock forward to the next packet arrival or timer
+     deadline whenever all that can be done now has been done. */
+  while(c.test != TEST_DONE) {
+    run();
+    flush_capture();
+    if(loopdev_poll() > 0) {
+      continue;
+    }
+    
+    set = timer_next(&interval);
+    if(loopdev_next(&arrival) && (!set || arrival < interval)) {
+      interval = arrival;
+      set = 1;
+    }
+    if(!set) {
+      fprintf(stderr, "contiki-bench: stalled in the %s test\n",
+	      names[c.test]);
+      return 1;
+    }
+    now += interval;
+  }
+
+  if(capture != -1) {
+    flush_capture();
+    printf("capture: %lu packets dropped\n", tcpdump_capture_drops());
+    close(capture);
+  }
+
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
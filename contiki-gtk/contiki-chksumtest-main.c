@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+/*
+ * A differential test and a benchmark of the checksum functions of
+ * the gtk uip_arch.c.
+ *
+ * uip_chksum(), uip_ipchksum(), uip_tcpchksum() and uip_udpchksum()
+ * are run on random data of random lengths and alignments, and the
+ * results are compared with those of the 16-bit word at a time code
+ * that the port used before. Then both are timed on a few packet
+ * sizes. contiki-chksumtest uses the fastest SIMD version that the
+ * CPU supports, contiki-chksumtest-sse2 at most SSE2 and
+ * contiki-chksumtest-portable none (see UIP_ARCH_CONF_SIMD).
+ */
+
+#include "uip.h"
+#include "uip_arch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define BUF ((uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define IP_PROTO_TCP    6
+#define IP_PROTO_UDP    17
+
+#define MAXLEN 1500
+
+static u8_t data[MAXLEN + 16];
+static volatile u16_t sum;
+
+/*-----------------------------------------------------------------------------------*/
+void
+tcpip_uipcall(void)
+{
+}
+/*-----------------------------------------------------------------------------------*/
+/* The checksum functions as they were before. */
+static u16_t
+ref_chksum(u8_t *dataptr, u16_t len)
+{
+  u16_t acc, tmp;
+
+  for(acc = 0; len > 1; len -= 2) {
+    tmp = HTONS((((u16_t)*dataptr) << 8)) + HTONS((u16_t)*(dataptr + 1));
+    acc += tmp;
+    if(acc < tmp) {
+      ++acc;
+    }
+    dataptr += 2;
+  }
+
+  /* add up any odd byte */
+  if(len == 1) {
+    tmp = HTONS(((u16_t)(*dataptr)) << 8);
+    acc += tmp;
+    if(acc < tmp) {
+      ++acc;
+    }
+  }
+
+  return acc;
+}
+/*-----------------------------------------------------------------------------------*/
+static u16_t
+ref_add(u16_t sum, u16_t n)
+{
+  if((sum += n) < n) {
+    ++sum;
+  }
+  return sum;
+}
+/*-----------------------------------------------------------------------------------*/
+static u16_t
+ref_transport_chksum(u8_t proto)
+{
+  u16_t len, sum;
+
+  len = (((u16_t)(BUF->len[0]) << 8) + BUF->len[1]) - UIP_IPH_LEN;
+  if(proto == IP_PROTO_TCP) {
+    sum = ref_add(ref_chksum(&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN],
+			     UIP_TCPH_LEN),
+		  ref_chksum(uip_appdata, len - UIP_TCPH_LEN));
+  } else {
+    sum = ref_chksum(&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN], len);
+  }
+  sum = ref_add(sum, BUF->srcipaddr[0]);
+  sum = ref_add(sum, BUF->srcipaddr[1]);
+  sum = ref_add(sum, BUF->destipaddr[0]);
+  sum = ref_add(sum, BUF->destipaddr[1]);
+  sum = ref_add(sum, (u16_t)HTONS((u16_t)proto));
+  return ref_add(sum, (u16_t)HTONS(len));
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+fill(u8_t *p, u16_t len, u8_t ones)
+{
+  while(len-- > 0) {
+    *p++ = ones? 0xff: rand();
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+set_len(u16_t len)
+{
+  BUF->len[0] = len >> 8;
+  BUF->len[1] = len & 0xff;
+}
+/*-----------------------------------------------------------------------------------*/
+static int
+check(const char *name, unsigned long n, u16_t len, u16_t sum, u16_t ref)
+{
+  if(sum != ref) {
+    fprintf(stderr, "contiki-chksumtest: %s of %u bytes differs in round"
+	    " %lu: 0x%04x, should be 0x%04x\n", name, len, n, sum, ref);
+    return 1;
+  }
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
+static double
+now(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: contiki-chksumtest [-n rounds]\n");
+  exit(1);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  static const u16_t sizes[] = {20, 64, 256, 576, 1024, 1460};
+  unsigned long count, n, iterations;
+  double t, ref;
+  u16_t len;
+  u8_t *p, ones, i;
+  int opt, fail;
+
+  count = 200000;
+  while((opt = getopt(argc, argv, "n:")) != -1) {
+    switch(opt) {
+    case 'n':
+      count = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage();
+    }
+  }
+
+  srand(1);
+  fail = 0;
+  for(n = 0; n < count && !fail; ++n) {
+    /* Every seventh round uses all ones, which is where the carries
+       pile up. */
+    ones = n % 7 == 0;
+
+    len = rand() % (MAXLEN + 1);
+    p = &data[rand() % 16];
+    fill(p, len, ones);
+    fail |= check("uip_chksum()", n, len,
+		  uip_chksum((u16_t *)p, len), ref_chksum(p, len));
+
+    fill(&uip_buf[UIP_LLH_LEN], UIP_TCPIP_HLEN, ones);
+    fail |= check("uip_ipchksum()", n, UIP_IPH_LEN,
+		  uip_ipchksum(), ref_chksum(&uip_buf[UIP_LLH_LEN],
+					     UIP_IPH_LEN));
+
+    /* The TCP data is either in uip_buf or anywhere else. */
+    len = UIP_TCPH_LEN + rand() % (UIP_BUFSIZE - UIP_LLH_LEN -
+				   UIP_TCPIP_HLEN + 1);
+    set_len(UIP_IPH_LEN + len);
+    if(n & 1) {
+      uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
+      fill(uip_appdata, len - UIP_TCPH_LEN, ones);
+    } else {
+      uip_appdata = &data[rand() % 16];
+      fill(uip_appdata, len - UIP_TCPH_LEN, ones);
+    }
+    fail |= check("uip_tcpchksum()", n, len,
+		  uip_tcpchksum(), ref_transport_chksum(IP_PROTO_TCP));
+
+    len = UIP_UDPH_LEN + rand() % (UIP_BUFSIZE - UIP_LLH_LEN -
+				   UIP_IPUDPH_LEN + 1);
+    set_len(UIP_IPH_LEN + len);
+    fill(&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN], len, ones);
+    fail |= check("uip_udpchksum()", n, len,
+		  uip_udpchksum(), ref_transport_chksum(IP_PROTO_UDP));
+  }
+  if(fail) {
+    return 1;
+  }
+  printf("%lu rounds matched the old checksum functions\n", count);
+
+  fill(data, sizeof(data), 0);
+  for(i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    len = sizes[i];
+    iterations = 100000000 / (len + 64);
+
+    t = now();
+    for(n = 0; n < iterations; ++n) {
+      sum = ref_chksum(data, len);
+    }
+    ref = (now() - t) / iterations;
+
+    t = now();
+    for(n = 0; n < iterations; ++n) {
+      sum = uip_chksum((u16_t *)data, len);
+    }
+    t = (now() - t) / iterations;
+
+    printf("%4u bytes: old %7.1f ns %6.2f GB/s, new %7.1f ns %6.2f GB/s\n",
+	   len, ref * 1e9, len / ref / 1e9, t * 1e9, len / t / 1e9);
+  }
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+/*
+ * A microbenchmark of the demultiplexing of incoming TCP segments to
+ * connections.
+ *
+ * A number of connections are opened to a listening port of the uIP
+ * stack with made up SYN and ACK segments, and a data segment is sent
+ * on each of them to check that it reaches the right connection. Then
+ * a pure ACK for the connection that was opened last is fed to
+ * uip_input() over and over, and the time per segment is shown. The
+ * last connection is the last one in use in the uip_conns array,
+ * which is the worst case for the linear scan. contiki-connbench uses
+ * the linear scan and contiki-connbench-hash the connection hash table
+ * (see UIP_TCP_HASHSIZE).
+ *
+ * Unless a number of connections is given with -c, the benchmark is
+ * run with 10, 100, 1000 and 2000 connections, as far as UIP_CONNS
+ * allows, and the results are shown as a table.
+ */
+
+#include "uip.h"
+#include "uip_arch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#define BUF ((uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#define TCP_SYN 0x02
+#define TCP_ACK 0x10
+
+#define PORT      80
+#define BASE_PORT 2000
+
+static struct uip_conn *conns[UIP_CONNS];
+static u16_t connport;
+static u8_t appflags;
+
+/*-----------------------------------------------------------------------------------*/
+void
+tcpip_uipcall(void)
+{
+  appflags = uip_flags;
+  if(uip_connected()) {
+    conns[HTONS(uip_conn->rport) - BASE_PORT] = uip_conn;
+  }
+  if(uip_newdata()) {
+    connport = HTONS(uip_conn->rport);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+put32(u8_t *p, unsigned long n)
+{
+  p[0] = n >> 24;
+  p[1] = n >> 16;
+  p[2] = n >> 8;
+  p[3] = n;
+}
+/*-----------------------------------------------------------------------------------*/
+static unsigned long
+get32(u8_t *p)
+{
+  return ((unsigned long)p[0] << 24) | ((unsigned long)p[1] << 16) |
+    ((unsigned long)p[2] << 8) | p[3];
+}
+/*-----------------------------------------------------------------------------------*/
+/* Make a segment from the remote port rport in uip_buf. The remote
+   hosts are spread over a few addresses. */
+static void
+segment(u16_t rport, u8_t flags, unsigned long seq, unsigned long ack,
+	u16_t len)
+{
+  memset(uip_buf, 0, UIP_LLH_LEN + UIP_TCPIP_HLEN);
+  uip_len = UIP_TCPIP_HLEN + len;
+  BUF->vhl = 0x45;
+  BUF->len[0] = uip_len >> 8;
+  BUF->len[1] = uip_len & 0xff;
+  BUF->ttl = 64;
+  BUF->proto = UIP_PROTO_TCP;
+  uip_ipaddr(BUF->srcipaddr, 10, 0, 0, 2 + rport % 5);
+  uip_ipaddr(BUF->destipaddr, 10, 0, 0, 1);
+  BUF->srcport = htons(rport);
+  BUF->destport = HTONS(PORT);
+  put32(BUF->seqno, seq);
+  put32(BUF->ackno, ack);
+  BUF->tcpoffset = 5 << 4;
+  BUF->flags = flags;
+  BUF->wnd[0] = 0x10;
+  uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
+  memset(uip_appdata, 'x', len);
+  BUF->tcpchksum = ~(uip_tcpchksum());
+  BUF->ipchksum = ~(uip_ipchksum());
+}
+/*-----------------------------------------------------------------------------------*/
+/* Open nconns connections, check that segments reach them, and
+   return the time in ns that uip_input() takes for a pure ACK to the
+   last one, or a negative value if the stack misbehaves. */
+static double
+run(u16_t nconns, unsigned long count)
+{
+  static unsigned long iss[UIP_CONNS];
+  static u8_t ack[UIP_LLH_LEN + UIP_TCPIP_HLEN];
+  unsigned long n;
+  struct timeval start, end;
+  u16_t ipaddr[2], i;
+
+  memset(conns, 0, sizeof(conns));
+  uip_init();
+  uip_ipaddr(ipaddr, 10, 0, 0, 1);
+  uip_sethostaddr(ipaddr);
+  uip_listen(HTONS(PORT));
+
+  /* Open the connections, and complete the handshakes in the reverse
+     order. */
+  for(i = 0; i < nconns; ++i) {
+    segment(BASE_PORT + i, TCP_SYN, 1000, 0, 0);
+    uip_input();
+    if(uip_len == 0 || BUF->flags != (TCP_SYN | TCP_ACK)) {
+      fprintf(stderr, "contiki-connbench: no SYNACK on connection %u\n", i);
+      return -1;
+    }
+    iss[i] = get32(BUF->seqno) + 1;
+  }
+  for(i = nconns; i > 0; --i) {
+    appflags = 0;
+    segment(BASE_PORT + i - 1, TCP_ACK, 1001, iss[i - 1], 0);
+    uip_input();
+    if(!(appflags & UIP_CONNECTED)) {
+      fprintf(stderr, "contiki-connbench: connection %u not opened\n", i - 1);
+      return -1;
+    }
+  }
+
+  /* Every data segment must reach its own connection. */
+  for(i = 0; i < nconns; ++i) {
+    connport = 0;
+    segment(BASE_PORT + i, TCP_ACK, 1001, iss[i], 1);
+    uip_input();
+    if(connport != BASE_PORT + i || conns[i] == NULL ||
+       HTONS(conns[i]->rport) != BASE_PORT + i) {
+      fprintf(stderr, "contiki-connbench: segment for connection %u went"
+	      " astray\n", i);
+      return -1;
+    }
+  }
+
+  segment(BASE_PORT + nconns - 1, TCP_ACK, 1002, iss[nconns - 1], 0);
+  memcpy(ack, uip_buf, sizeof(ack));
+  gettimeofday(&start, NULL);
+  for(n = 0; n < count; ++n) {
+    memcpy(uip_buf, ack, sizeof(ack));
+    uip_len = UIP_TCPIP_HLEN;
+    uip_input();
+  }
+  gettimeofday(&end, NULL);
+  if(uip_len != 0) {
+    fprintf(stderr, "contiki-connbench: the ACK was answered\n");
+    return -1;
+  }
+
+  return ((end.tv_sec - start.tv_sec) * 1e9 +
+	  (end.tv_usec - start.tv_usec) * 1e3) / count;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: contiki-connbench [-c connections] [-n segments]\n");
+  exit(1);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  static const u16_t sweep[] = {10, 100, 1000, 2000};
+  unsigned long count;
+  u16_t i, nconns;
+  double ns;
+  int opt;
+
+  count = 1000000;
+  nconns = 0;
+  while((opt = getopt(argc, argv, "c:n:")) != -1) {
+    switch(opt) {
+    case 'c':
+      nconns = strtoul(optarg, NULL, 0);
+      if(nconns == 0) {
+	usage();
+      }
+      break;
+    case 'n':
+      count = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage();
+    }
+  }
+  if(nconns > UIP_CONNS || count == 0) {
+    usage();
+  }
+
+  printf("%s, %d connections at most\n",
+	 UIP_TCP_HASHSIZE > 0? "hash table": "linear scan", UIP_CONNS);
+  printf("connections  ns/segment\n");
+  for(i = 0; i < sizeof(sweep) / sizeof(sweep[0]); ++i) {
+    if(nconns == 0 && sweep[i] > UIP_CONNS) {
+      break;
+    }
+    ns = run(nconns > 0? nconns: sweep[i], count);
+    if(ns < 0) {
+      return 1;
+    }
+    printf("%11u  %10.1f\n", nconns > 0? nconns: sweep[i], ns);
+    if(nconns > 0) {
+      break;
+    }
+  }
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
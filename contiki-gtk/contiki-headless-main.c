@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+/*
+ * A Contiki for Linux that runs without GTK. The desktop is served by
+ * the VNC server, and the web server and the shell server are started
+ * at boot. The system sleeps in the event loop (see evloop.h) until
+ * the network device has frames or a timer expires.
+ *
+ * uIP uses the tap device, unless a network interface is named on
+ * the command line (see packetdev.h).
+ */
+
+#include "ek.h"
+#include "clock.h"
+#include "timer.h"
+
+#include "uip.h"
+#include "uip_arp.h"
+#include "resolv.h"
+#include "ctk.h"
+
+#include "ctk-vncserver.h"
+#include "telnetd.h"
+#include "webserver.h"
+
+#include "cfs-posix.h"
+
+#include "uip-fw.h"
+#include "uip-fw-service.h"
+#include "tapdev.h"
+#include "packetdev.h"
+#include "evloop.h"
+
+#include "program-handler.h"
+#include "log.h"
+
+#include <stdio.h>
+
+u8_t tapdev_send(void);
+static struct uip_fw_netif tapif =
+  {UIP_FW_NETIF(0,0,0,0, 0,0,0,0, tapdev_send)};
+static struct uip_fw_netif packetif =
+  {UIP_FW_NETIF(0,0,0,0, 0,0,0,0, packetdev_send)};
+
+static struct timer arptimer;
+
+EK_POLLHANDLER(arp_pollhandler);
+EK_PROCESS(arp, "ARP timer", EK_PRIO_NORMAL,
+	   NULL, arp_pollhandler, NULL);
+
+/*-----------------------------------------------------------------------------------*/
+/* The GTK port runs the ARP timer from the tap device's GTK timeout. */
+EK_POLLHANDLER(arp_pollhandler)
+{
+  if(timer_expired(&arptimer)) {
+    timer_reset(&arptimer);
+    uip_arp_timer();
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  u16_t addr[2];
+
+  evloop_init();
+  
+  ek_init();
+  
+  tcpip_init(NULL);
+
+  ctk_init();
+  ctk_vncserver_init(NULL);
+  
+  uip_init();
+  uip_ipaddr(addr, 192,168,2,2);
+  uip_sethostaddr(addr);
+
+  uip_ipaddr(addr, 192,168,2,1);
+  uip_setdraddr(addr);
+
+  uip_ipaddr(addr, 255,255,255,0);
+  uip_setnetmask(addr);  
+
+  resolv_init(NULL);
+  
+  /* If an interface is named on the command line, uIP is attached to
+     it with the packet device instead of to the tap device. */
+  uip_fw_service_init(NULL);
+  uip_fw_init();
+  if(argc > 1) {
+    packetdev_init(argv[1]);
+    uip_fw_default(&packetif);
+  } else {
+    tapdev_init();
+    uip_fw_default(&tapif);
+  }
+
+  timer_set(&arptimer, CLOCK_SECOND * 10);
+  ek_start(&arp);
+
+  program_handler_init();
+
+  cfs_posix_init(NULL);
+
+  webserver_init(NULL);
+  telnetd_init(NULL);
+
+  evloop_run();
+    
+  return 0;
+
+  argv = argv;
+  argc = argc;
+}
+/*-----------------------------------------------------------------------------------*/
+#include <sys/time.h>
+ 
+clock_time_t
+clock_time(void)
+{
+  struct timeval tv;
+  struct timezone tz;
+   
+  gettimeofday(&tv, &tz);
+ 
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+/*-----------------------------------------------------------------------------------*/
+#if LOG_CONF_ENABLED
+void
+log_message(const char *part1, const char *part2)
+{
+  printf("%s%s\n", part1, part2);
+}
+#endif /* LOG_CONF_ENABLED */
+/*-----------------------------------------------------------------------------------*/
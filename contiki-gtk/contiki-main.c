@@ -62,7 +62,7 @@
 
 
 
-void tapdev_send(void);
+u8_t tapdev_send(void);
 static struct uip_fw_netif tapif =
   {UIP_FW_NETIF(0,0,0,0, 0,0,0,0, tapdev_send)};
 
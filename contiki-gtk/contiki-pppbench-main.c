@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+/*
+ * A benchmark of the AHDLC framing of the PPP implementation over a
+ * pseudo terminal.
+ *
+ * Frames of random bytes are sent with ahdlc_tx() to the master side
+ * of a pseudo terminal in raw mode, and are read back from the slave
+ * side the way ppp_poll() reads them. Every frame is checked against
+ * the one that was sent. With AHDLC_CONF_BLOCK_IO, the pseudo
+ * terminal is read and written in blocks and the bytes are handed to
+ * ahdlc_rx_buf(); without it, one character at a time is moved with
+ * ppp_arch_putchar() and ppp_arch_getchar() and handed to ahdlc_rx().
+ *
+ * With -t, a few hand made frames are instead fed to ahdlc_rx() to
+ * check escaping, protocol field compression and the dropping of
+ * frames that are too short.
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include "uip.h"
+#include "ppp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define MAXLEN (PPP_RX_BUFFER_SIZE - 4)
+
+#ifdef AHDLC_CONF_RXBUF
+#define RXBUF AHDLC_CONF_RXBUF
+#else /* AHDLC_CONF_RXBUF */
+#define RXBUF 32
+#endif /* AHDLC_CONF_RXBUF */
+
+u8_t ppp_rx_buffer[PPP_RX_BUFFER_SIZE];
+
+static int master, slave;
+
+static unsigned long writes, reads;
+
+static u8_t packet[MAXLEN];
+static u16_t protocol, size, received;
+static u8_t differs;
+
+extern u8_t ahdlc_flags;
+
+void debug_printf(char *format, ...);
+
+/*-----------------------------------------------------------------------------------*/
+void
+debug_printf(char *format, ...)
+{
+}
+/*-----------------------------------------------------------------------------------*/
+void
+ppp_upcall(u16_t proto, u8_t *buffer, u16_t len)
+{
+  received = len + 1;
+  differs = proto != protocol || len != size ||
+    memcmp(buffer, packet, len) != 0;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+ppp_rx_error(void)
+{
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+write_all(u8_t *buf, u16_t len)
+{
+  int ret;
+
+  ++writes;
+  while(len > 0) {
+    ret = write(master, buf, len);
+    if(ret == -1) {
+      perror("contiki-pppbench: write");
+      exit(1);
+    }
+    buf += ret;
+    len -= ret;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static u16_t
+read_some(u8_t *buf, u16_t len)
+{
+  int ret;
+
+  ++reads;
+  ret = read(slave, buf, len);
+  if(ret == -1) {
+    return 0;
+  }
+  return ret;
+}
+/*-----------------------------------------------------------------------------------*/
+#if AHDLC_CONF_BLOCK_IO
+void
+ppp_arch_write(u8_t *buf, u16_t len)
+{
+  write_all(buf, len);
+}
+/*-----------------------------------------------------------------------------------*/
+u16_t
+ppp_arch_read(u8_t *buf, u16_t len)
+{
+  return read_some(buf, len);
+}
+/*-----------------------------------------------------------------------------------*/
+/* The receive loop of ppp_poll(). */
+static void
+rx_poll(void)
+{
+  static u8_t rxbuf[RXBUF];
+  static u16_t rxpos, rxlen;
+
+  while(received == 0) {
+    if(rxpos == rxlen) {
+      rxpos = 0;
+      rxlen = ppp_arch_read(rxbuf, RXBUF);
+      if(rxlen == 0) {
+	break;
+      }
+    }
+    rxpos += ahdlc_rx_buf(&rxbuf[rxpos], rxlen - rxpos);
+  }
+}
+#endif /* AHDLC_CONF_BLOCK_IO */
+/*-----------------------------------------------------------------------------------*/
+void
+ppp_arch_putchar(u8_t c)
+{
+  write_all(&c, 1);
+}
+/*-----------------------------------------------------------------------------------*/
+u8_t
+ppp_arch_getchar(u8_t *c)
+{
+  return read_some(c, 1);
+}
+/*-----------------------------------------------------------------------------------*/
+#if !AHDLC_CONF_BLOCK_IO
+/* The receive loop of ppp_poll(). */
+static void
+rx_poll(void)
+{
+  u8_t c;
+
+  while(received == 0 && ppp_arch_getchar(&c)) {
+    ahdlc_rx(c);
+  }
+}
+#endif /* !AHDLC_CONF_BLOCK_IO */
+/*-----------------------------------------------------------------------------------*/
+static void
+open_pty(void)
+{
+  struct termios t;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if(master == -1 || grantpt(master) == -1 || unlockpt(master) == -1) {
+    perror("contiki-pppbench: posix_openpt");
+    exit(1);
+  }
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if(slave == -1) {
+    perror("contiki-pppbench: open");
+    exit(1);
+  }
+  tcgetattr(slave, &t);
+  cfmakeraw(&t);
+  tcsetattr(slave, TCSANOW, &t);
+}
+/*-----------------------------------------------------------------------------------*/
+/* The FCS computed bit by bit, as in RFC 1662, to check the table
+   driven one against. */
+static u16_t
+fcs_bits(u16_t fcs, u8_t c)
+{
+  u8_t i;
+
+  fcs ^= c;
+  for(i = 0; i < 8; ++i) {
+    fcs = (fcs & 1)? (fcs >> 1) ^ 0x8408: fcs >> 1;
+  }
+  return fcs;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+rx_escaped(u8_t c)
+{
+  if(c < 0x20 || c == 0x7d || c == 0x7e) {
+    ahdlc_rx(0x7d);
+    c ^= 0x20;
+  }
+  ahdlc_rx(c);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Feed a frame with the given bytes and a good FCS to ahdlc_rx(), and
+   check what is passed up: nothing if proto is 0, otherwise the
+   protocol proto and the last len bytes of the frame. */
+static int
+rx_check(const char *name, const u8_t *frame, u16_t framelen,
+	 u16_t proto, u16_t len)
+{
+  u16_t fcs, i;
+
+  fcs = 0xffff;
+  for(i = 0; i < framelen; ++i) {
+    fcs = fcs_bits(fcs, frame[i]);
+  }
+  fcs ^= 0xffff;
+
+  protocol = proto;
+  size = len;
+  memcpy(packet, &frame[framelen - len], len);
+  received = 0;
+  ahdlc_rx(0x7e);
+  for(i = 0; i < framelen; ++i) {
+    rx_escaped(frame[i]);
+  }
+  rx_escaped(fcs & 0xff);
+  rx_escaped(fcs >> 8);
+  ahdlc_rx(0x7e);
+
+  if(proto == 0? received != 0: received == 0 || differs) {
+    fprintf(stderr, "contiki-pppbench: %s failed\n", name);
+    return 1;
+  }
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
+static int
+test(void)
+{
+  static const u8_t full[] = {0xff, 0x03, 0x00, 0x21,
+			      0x7e, 0x7d, 0x11, 0x45, 0x00};
+  static const u8_t pfc[] = {0xff, 0x03, 0x21, 0x45, 0x00, 0x7e};
+  static const u8_t nopfc[] = {0x00, 0x21, 0x45};
+  static const u8_t empty[] = {0x00, 0x21};
+  static const u8_t shortframe[] = {0x21};
+  static u8_t buffer[PPP_RX_BUFFER_SIZE];
+  int fail;
+
+  /* The frame is received into the buffer given to ahdlc_init(). */
+  memset(ppp_rx_buffer, 0, sizeof(ppp_rx_buffer));
+  ahdlc_init(buffer, sizeof(buffer));
+  ahdlc_rx_ready();
+
+  fail = rx_check("escaped bytes", full, sizeof(full), IPV4, 5);
+  if(buffer[2] != 0x7e || ppp_rx_buffer[2] != 0) {
+    fprintf(stderr, "contiki-pppbench: receive buffer failed\n");
+    fail = 1;
+  }
+
+  /* A compressed protocol field is only taken as such when it has
+     been negotiated, and an uncompressed one is always accepted. */
+  fail |= rx_check("compressed protocol", pfc, sizeof(pfc), 0x2145, 2);
+  ahdlc_flags |= PPP_PFC;
+  fail |= rx_check("compressed protocol", pfc, sizeof(pfc), IPV4, 3);
+  fail |= rx_check("uncompressed protocol", nopfc, sizeof(nopfc), IPV4, 1);
+
+  /* A frame must hold a protocol field and the FCS. */
+  fail |= rx_check("empty frame", empty, sizeof(empty), IPV4, 0);
+  fail |= rx_check("short frame", shortframe, sizeof(shortframe), 0, 0);
+
+  if(!fail) {
+    printf("framing tests passed\n");
+  }
+  return fail;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+usage(void)
+{
+  fprintf(stderr, "usage: contiki-pppbench [-t] [-n frames] [-s size]\n");
+  exit(1);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  unsigned long count, n, bytes;
+  struct timeval start, end;
+  clock_t cpu;
+  double secs;
+  u16_t i;
+  int opt;
+
+  count = 100000;
+  size = MAXLEN;
+  while((opt = getopt(argc, argv, "tn:s:")) != -1) {
+    switch(opt) {
+    case 't':
+      return test();
+    case 'n':
+      count = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      size = strtoul(optarg, NULL, 0);
+      break;
+    default:
+      usage();
+    }
+  }
+  if(size == 0 || size > MAXLEN) {
+    usage();
+  }
+
+  open_pty();
+  ahdlc_init(ppp_rx_buffer, PPP_RX_BUFFER_SIZE);
+  protocol = IPV4;
+  ahdlc_rx_ready();
+  srand(1);
+
+  bytes = 0;
+  gettimeofday(&start, NULL);
+  cpu = clock();
+  for(n = 0; n < count; ++n) {
+    for(i = 0; i < size; ++i) {
+      packet[i] = rand();
+    }
+    ahdlc_tx(IPV4, NULL, packet, 0, size);
+
+    received = 0;
+    while(received == 0) {
+      rx_poll();
+    }
+    if(differs) {
+      fprintf(stderr, "contiki-pppbench: frame %lu differs\n", n);
+      return 1;
+    }
+    bytes += size;
+  }
+  cpu = clock() - cpu;
+  gettimeofday(&end, NULL);
+
+  secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("%lu frames of %u bytes: %.3f s, %.0f frames/s, %.0f bytes/s,"
+	 " %.2f us cpu/frame, %.1f writes and %.1f reads/frame\n",
+	 count, size, secs, count / secs, bytes / secs,
+	 (double)cpu / CLOCKS_PER_SEC * 1e6 / count,
+	 (double)writes / count, (double)reads / count);
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+/*
+ * A test of the reassembly of interleaved IP fragments.
+ *
+ * A number of hosts each send an ICMP echo request of DATALEN bytes
+ * in three fragments, all with the same IP ID. The fragments of the
+ * hosts are interleaved and each datagram arrives out of order. The
+ * test checks that every echo reply goes back to the right host and
+ * carries the payload of its request byte for byte. With as many
+ * hosts as there are reassembly buffers (UIP_REASS_CONTEXTS), every
+ * datagram must be reassembled; with more hosts, the datagrams that
+ * are evicted must be counted as dropped and the others must still be
+ * intact.
+ */
+
+#include "uip.h"
+#include "uip_arch.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BUF ((uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+#define IP_MF 0x20
+
+#define DATALEN 600
+#define FRAGLEN 200
+#define NFRAGS  (DATALEN / FRAGLEN)
+#define IPID    100
+
+/*-----------------------------------------------------------------------------------*/
+void
+tcpip_uipcall(void)
+{
+}
+/*-----------------------------------------------------------------------------------*/
+/* The byte at offset i of the ICMP message from host. */
+static u8_t
+payload(u8_t host, u16_t i)
+{
+  return (u8_t)(i + host * 7);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Make fragment frag of the echo request from host in uip_buf. */
+static void
+fragment(u8_t host, u8_t frag)
+{
+  u8_t *ip;
+  u16_t off, i;
+
+  ip = &uip_buf[UIP_LLH_LEN];
+  off = frag * FRAGLEN;
+  memset(uip_buf, 0, UIP_LLH_LEN + UIP_IPH_LEN);
+  uip_len = UIP_IPH_LEN + FRAGLEN;
+  BUF->vhl = 0x45;
+  BUF->len[0] = uip_len >> 8;
+  BUF->len[1] = uip_len & 0xff;
+  BUF->ttl = 64;
+  BUF->proto = UIP_PROTO_ICMP;
+  uip_ipaddr(BUF->srcipaddr, 10, 0, 0, 2 + host);
+  uip_ipaddr(BUF->destipaddr, 10, 0, 0, 1);
+  BUF->ipid[0] = IPID >> 8;
+  BUF->ipid[1] = IPID & 0xff;
+  BUF->ipoffset[0] = ((off / 8) >> 8) | (frag < NFRAGS - 1? IP_MF: 0);
+  BUF->ipoffset[1] = (off / 8) & 0xff;
+  for(i = 0; i < FRAGLEN; ++i) {
+    ip[UIP_IPH_LEN + i] = payload(host, off + i);
+  }
+  if(frag == 0) {
+    /* An echo request with a zero checksum, which uIP does not
+       check. */
+    ip[UIP_IPH_LEN] = 8;
+    ip[UIP_IPH_LEN + 1] = 0;
+    ip[UIP_IPH_LEN + 2] = 0;
+    ip[UIP_IPH_LEN + 3] = 0;
+  }
+  BUF->ipchksum = ~(uip_ipchksum());
+}
+/*-----------------------------------------------------------------------------------*/
+/* Check the echo reply to host in uip_buf. */
+static int
+reply_ok(u8_t host)
+{
+  u8_t *ip;
+  u16_t i;
+
+  ip = &uip_buf[UIP_LLH_LEN];
+  if(uip_len != UIP_IPH_LEN + DATALEN ||
+     BUF->destipaddr[0] != HTONS((10 << 8) | 0) ||
+     BUF->destipaddr[1] != HTONS(2 + host) ||
+     ip[UIP_IPH_LEN] != 0) {
+    return 0;
+  }
+  /* The identifier and sequence number follow the type, code and
+     checksum. */
+  for(i = 4; i < DATALEN; ++i) {
+    if(ip[UIP_IPH_LEN + i] != payload(host, i)) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Send the datagrams of the given number of hosts, and return the
+   number of intact replies, or -1 if a reply was wrong. */
+static int
+run(u8_t hosts)
+{
+  static const u8_t order[NFRAGS] = {2, 0, 1};
+  u16_t ipaddr[2];
+  u8_t host, k;
+  int replies;
+
+  uip_init();
+  uip_ipaddr(ipaddr, 10, 0, 0, 1);
+  uip_sethostaddr(ipaddr);
+  memset(&uip_stat, 0, sizeof(uip_stat));
+
+  replies = 0;
+  for(k = 0; k < NFRAGS; ++k) {
+    for(host = 0; host < hosts; ++host) {
+      fragment(host, order[k]);
+      uip_input();
+      if(uip_len > 0) {
+	if(k != NFRAGS - 1 || !reply_ok(host)) {
+	  fprintf(stderr, "contiki-reasstest: wrong reply to host %u"
+		  " with %u hosts\n", host, hosts);
+	  return -1;
+	}
+	++replies;
+      }
+    }
+  }
+  return replies;
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(void)
+{
+  u8_t hosts;
+  int replies, fail;
+
+  fail = 0;
+  for(hosts = 1; hosts <= UIP_REASS_CONTEXTS + 2; ++hosts) {
+    replies = run(hosts);
+    printf("%u hosts, %u buffers: %d datagrams reassembled, %u dropped\n",
+	   hosts, UIP_REASS_CONTEXTS, replies, uip_stat.ip.drop);
+    if(replies < 0 ||
+       (hosts <= UIP_REASS_CONTEXTS && replies != hosts) ||
+       (hosts > UIP_REASS_CONTEXTS && replies + uip_stat.ip.drop < hosts)) {
+      fail = 1;
+    }
+  }
+  if(fail) {
+    fprintf(stderr, "contiki-reasstest: failed\n");
+  }
+  return fail;
+}
+/*-----------------------------------------------------------------------------------*/
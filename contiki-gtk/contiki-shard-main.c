@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+/*
+ * A headless Contiki that serves HTTP from one uIP stack per
+ * processor core. Every worker thread runs a Contiki instance of its
+ * own, and the tap device steers the connections to the workers (see
+ * tapdev-shard.h).
+ */
+
+#include "ek.h"
+#include "clock.h"
+
+#include "uip.h"
+#include "tcpip.h"
+#include "httpd.h"
+
+#include "tapdev-shard.h"
+
+EK_EVENTHANDLER(webserver_eventhandler, ev, data);
+EK_PROCESS(webserver, "Web server", EK_PRIO_NORMAL,
+	   webserver_eventhandler, NULL, NULL);
+
+/*-----------------------------------------------------------------------------------*/
+EK_EVENTHANDLER(webserver_eventhandler, ev, data)
+{
+  EK_EVENTHANDLER_ARGS(ev, data);
+
+  if(ev == EK_EVENT_INIT) {
+    httpd_init();
+  } else if(ev == tcpip_event) {
+    httpd_appcall(data);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Called by each worker thread, with its own stack selected. All
+   stacks use the same addresses. */
+static void
+shard_init(u8_t shard)
+{
+  u16_t addr[2];
+
+  uip_ipaddr(addr, 192,168,2,2);
+  uip_sethostaddr(addr);
+
+  uip_ipaddr(addr, 192,168,2,1);
+  uip_setdraddr(addr);
+
+  uip_ipaddr(addr, 255,255,255,0);
+  uip_setnetmask(addr);
+
+  ek_start(&webserver);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  tapdev_shard_init();
+  tapdev_shard_start(shard_init);
+
+  /* The main thread reads the tap device and hands the frames to the
+     workers. */
+  tapdev_shard_dispatch();
+
+  return 0;
+
+  argv = argv;
+  argc = argc;
+}
+/*-----------------------------------------------------------------------------------*/
+#include <sys/time.h>
+ 
+clock_time_t
+clock_time(void)
+{
+  struct timeval tv;
+  struct timezone tz;
+   
+  gettimeofday(&tv, &tz);
+ 
+  return tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+httpd_log_file(u16_t *requester, char *file)
+{
+}
+/*-----------------------------------------------------------------------------------*/
+void
+httpd_log(char *msg)
+{
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,329 @@
+/*
+ * Copyright (c) 2002, Adam Dunkels.
+ * All rights reserved. 
+ *
+ * Redistribution and use in source and binary forms, with or without 
+ * modification, are permitted provided that the following conditions 
+ * are met: 
+ * 1. Redistributions of source code must retain the above copyright 
+ *    notice, this list of conditions and the following disclaimer. 
+ * 2. Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following
+ *    disclaimer in the documentation and/or other materials provided
+ *    with the distribution. 
+ * 3. The name of the author may not be used to endorse or promote
+ *    products derived from this software without specific prior
+ *    written permission.  
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS
+ * OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ * WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+ * GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.  
+ *
+ * This file is part of the Contiki desktop environment 
+ *
+ */
+
+/*
+ * A benchmark of the SLIP implementation over a pseudo terminal.
+ *
+ * Packets of random bytes are sent with slipdev_send() to the master
+ * side of a pseudo terminal in raw mode, and are read back with
+ * slipdev_poll() from the slave side. Every packet is checked against
+ * the one that was sent. The SLIP implementation is built with
+ * SLIPDEV_CONF_BLOCK_IO, so that it reads and writes the pseudo
+ * terminal in blocks.
+ *
+ * With -r, the packets are instead taken from a pcap file (with the
+ * Ethernet or the raw IP link type), which is replayed as many times
+ * as needed. Built as contiki-cslipbench, with SLIPDEV_CONF_CSLIP, the
+ * TCP/IP headers are compressed, and the number of bytes written to
+ * the pseudo terminal per packet shows what the compression saves; -u
+ * turns the compression off for comparison.
+ */
+
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include "uip.h"
+#include "slipdev.h"
+#include "clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define TRACE_SIZE 0x40000
+#define TRACE_PACKETS 4096
+
+static int master, slave;
+
+static unsigned long writes, reads, written;
+
+/* The packets read from a pcap file. */
+static u8_t trace[TRACE_SIZE];
+static u16_t trace_len[TRACE_PACKETS];
+static unsigned int trace_packets;
+
+/*-----------------------------------------------------------------------------------*/
+clock_time_t
+clock_time(void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * CLOCK_SECOND + tv.tv_usec / (1000000 / CLOCK_SECOND);
+}
+/*-----------------------------------------------------------------------------------*/
+void
+slipdev_write(u8_t *buf, u16_t len)
+{
+  int ret;
+
+  ++writes;
+  written += len;
+  while(len > 0) {
+    ret = write(master, buf, len);
+    if(ret == -1) {
+      perror("contiki-slipbench: write");
+      exit(1);
+    }
+    buf += ret;
+    len -= ret;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+u16_t
+slipdev_read(u8_t *buf, u16_t len)
+{
+  int ret;
+
+  ++reads;
+  ret = read(slave, buf, len);
+  if(ret == -1) {
+    return 0;
+  }
+  return ret;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+open_pty(void)
+{
+  struct termios t;
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if(master == -1 || grantpt(master) == -1 || unlockpt(master) == -1) {
+    perror("contiki-slipbench: posix_openpt");
+    exit(1);
+  }
+  slave = open(ptsname(master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if(slave == -1) {
+    perror("contiki-slipbench: open");
+    exit(1);
+  }
+  tcgetattr(slave, &t);
+  cfmakeraw(&t);
+  tcsetattr(slave, TCSANOW, &t);
+}
+/*-----------------------------------------------------------------------------------*/
+static unsigned long
+get32(u8_t *p, int swap)
+{
+  if(swap) {
+    return ((unsigned long)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+  }
+  return ((unsigned long)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0];
+}
+/*-----------------------------------------------------------------------------------*/
+/* Read the IP packets of a pcap file into the trace buffer. */
+static void
+read_trace(char *name)
+{
+  static u8_t buf[0x10000];
+  u8_t hdr[24];
+  unsigned long caplen, linktype, skip, size;
+  int swap;
+  FILE *f;
+
+  f = fopen(name, "rb");
+  if(f == NULL) {
+    perror(name);
+    exit(1);
+  }
+  if(fread(hdr, 1, 24, f) != 24) {
+    fprintf(stderr, "contiki-slipbench: %s: not a pcap file\n", name);
+    exit(1);
+  }
+  if(get32(hdr, 0) == 0xa1b2c3d4UL) {
+    swap = 0;
+  } else if(get32(hdr, 1) == 0xa1b2c3d4UL) {
+    swap = 1;
+  } else {
+    fprintf(stderr, "contiki-slipbench: %s: not a pcap file\n", name);
+    exit(1);
+  }
+  linktype = get32(&hdr[20], swap);
+  if(linktype == 1) {
+    skip = 14;
+  } else if(linktype == 101) {
+    skip = 0;
+  } else {
+    fprintf(stderr, "contiki-slipbench: %s: link type %lu not supported\n",
+	    name, linktype);
+    exit(1);
+  }
+
+  size = 0;
+  while(fread(hdr, 1, 16, f) == 16) {
+    caplen = get32(&hdr[8], swap);
+    if(caplen > sizeof(buf) || fread(buf, 1, caplen, f) != caplen) {
+      break;
+    }
+    /* Only complete IPv4 packets that fit in uip_buf are used. */
+    if(caplen <= skip || caplen != get32(&hdr[12], swap) ||
+       (skip == 14 && (buf[12] != 0x08 || buf[13] != 0x00)) ||
+       (buf[skip] >> 4) != 4 ||
+       caplen - skip > UIP_BUFSIZE - UIP_LLH_LEN) {
+      continue;
+    }
+    if(trace_packets == TRACE_PACKETS || size + caplen - skip > TRACE_SIZE) {
+      break;
+    }
+    memcpy(&trace[size], &buf[skip], caplen - skip);
+    trace_len[trace_packets++] = caplen - skip;
+    size += caplen - skip;
+  }
+  fclose(f);
+  if(trace_packets == 0) {
+    fprintf(stderr, "contiki-slipbench: %s: no IP packets\n", name);
+    exit(1);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+usage(void)
+{
+#if SLIPDEV_CONF_CSLIP
+  fprintf(stderr, "usage: contiki-cslipbench [-n packets] [-s size]"
+	  " [-r pcapfile] [-u]\n");
+#else /* SLIPDEV_CONF_CSLIP */
+  fprintf(stderr, "usage: contiki-slipbench [-n packets] [-s size]"
+	  " [-r pcapfile]\n");
+#endif /* SLIPDEV_CONF_CSLIP */
+  exit(1);
+}
+/*-----------------------------------------------------------------------------------*/
+int
+main(int argc, char **argv)
+{
+  static u8_t packet[UIP_BUFSIZE];
+  unsigned long count, n, bytes, pos;
+  struct timeval start, end;
+  clock_t cpu;
+  double secs;
+  u16_t size, len, i;
+  int opt;
+#if SLIPDEV_CONF_CSLIP
+  int compress;
+#endif /* SLIPDEV_CONF_CSLIP */
+
+  count = 100000;
+  size = UIP_BUFSIZE - UIP_LLH_LEN;
+#if SLIPDEV_CONF_CSLIP
+  compress = 1;
+  while((opt = getopt(argc, argv, "n:s:r:u")) != -1) {
+#else /* SLIPDEV_CONF_CSLIP */
+  while((opt = getopt(argc, argv, "n:s:r:")) != -1) {
+#endif /* SLIPDEV_CONF_CSLIP */
+    switch(opt) {
+    case 'n':
+      count = strtoul(optarg, NULL, 0);
+      break;
+    case 's':
+      size = strtoul(optarg, NULL, 0);
+      break;
+    case 'r':
+      read_trace(optarg);
+      break;
+#if SLIPDEV_CONF_CSLIP
+    case 'u':
+      compress = 0;
+      break;
+#endif /* SLIPDEV_CONF_CSLIP */
+    default:
+      usage();
+    }
+  }
+  if(size == 0 || size > UIP_BUFSIZE - UIP_LLH_LEN) {
+    usage();
+  }
+
+  open_pty();
+  slipdev_init();
+#if SLIPDEV_CONF_CSLIP
+  if(!compress) {
+    slipdev_vjhc.tx_slots = 0;
+  }
+#endif /* SLIPDEV_CONF_CSLIP */
+  srand(1);
+
+  bytes = pos = 0;
+  gettimeofday(&start, NULL);
+  cpu = clock();
+  for(n = 0; n < count; ++n) {
+    if(trace_packets > 0) {
+      if(n % trace_packets == 0) {
+	pos = 0;
+      }
+      size = trace_len[n % trace_packets];
+      memcpy(packet, &trace[pos], size);
+      pos += size;
+    } else {
+      for(i = 0; i < size; ++i) {
+	packet[i] = rand();
+      }
+#if SLIPDEV_CONF_CSLIP
+      /* CSLIP takes the type of a packet from its first byte, so the
+	 random packets are made to look like UDP packets. */
+      packet[0] = 0x45;
+      packet[9] = UIP_PROTO_UDP;
+#endif /* SLIPDEV_CONF_CSLIP */
+    }
+    memcpy(&uip_buf[UIP_LLH_LEN], packet, size);
+    uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
+    uip_len = size;
+    slipdev_send();
+
+    while((len = slipdev_poll()) == 0);
+    if(len != size || memcmp(&uip_buf[UIP_LLH_LEN], packet, size) != 0) {
+      fprintf(stderr, "contiki-slipbench: packet %lu differs\n", n);
+      return 1;
+    }
+    bytes += size;
+  }
+  cpu = clock() - cpu;
+  gettimeofday(&end, NULL);
+
+  secs = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+  printf("%lu packets of %.1f bytes: %.3f s, %.0f packets/s, %.0f bytes/s,"
+	 " %.2f us cpu/packet, %.1f writes and %.1f reads/packet,"
+	 " %.1f bytes/packet on the line\n",
+	 count, (double)bytes / count, secs, count / secs, bytes / secs,
+	 (double)cpu / CLOCKS_PER_SEC * 1e6 / count,
+	 (double)writes / count, (double)reads / count,
+	 (double)written / count);
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the Contiki desktop OS.
+ *
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#include "ek.h"
+#include "timer.h"
+
+#include "evloop.h"
+
+#ifdef EVLOOP_CONF_FDS
+#define EVLOOP_FDS EVLOOP_CONF_FDS
+#else /* EVLOOP_CONF_FDS */
+#define EVLOOP_FDS 8
+#endif /* EVLOOP_CONF_FDS */
+
+static int epfd, timerfd;
+
+static struct {
+  int fd;
+  void (* callback)(int fd);
+} fds[EVLOOP_FDS];
+static unsigned char nfds;
+
+/*-----------------------------------------------------------------------------------*/
+void
+evloop_init(void)
+{
+  struct epoll_event ev;
+  
+  epfd = epoll_create1(0);
+  timerfd = timerfd_create(CLOCK_MONOTONIC, 0);
+  if(epfd == -1 || timerfd == -1) {
+    perror("evloop: evloop_init");
+    exit(1);
+  }
+
+  /* The timer file descriptor is the only one that is not in the
+     table, and is told apart by its index. */
+  ev.events = EPOLLIN;
+  ev.data.u32 = EVLOOP_FDS;
+  epoll_ctl(epfd, EPOLL_CTL_ADD, timerfd, &ev);
+}
+/*-----------------------------------------------------------------------------------*/
+/**
+ * Call a function when a file descriptor becomes readable.
+ *
+ * \param fd The file descriptor.
+ *
+ * \param callback The function, which is called with the file
+ * descriptor as its argument. It must read what is available, since
+ * the loop only sleeps again once ek_run() has nothing more to do.
+ */
+void
+evloop_add(int fd, void (* callback)(int fd))
+{
+  struct epoll_event ev;
+  
+  if(nfds == EVLOOP_FDS) {
+    fprintf(stderr, "evloop: evloop_add: too many file descriptors\n");
+    return;
+  }
+
+  fds[nfds].fd = fd;
+  fds[nfds].callback = callback;
+  ev.events = EPOLLIN;
+  ev.data.u32 = nfds;
+  if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    perror("evloop: evloop_add: epoll_ctl");
+    return;
+  }
+  ++nfds;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Run Contiki until there is nothing more to do. ek_run() processes
+   one event and returns the number of events still waiting. A last
+   pass is made with an empty queue, so that the poll handlers see the
+   effects of the last event, and timer_expired() records the
+   deadlines of the timers they are waiting for. */
+static void
+run(void)
+{
+  do {
+    while(ek_run() > 0);
+    timer_next_clear();
+  } while(ek_run() > 0 || ek_poll_request);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Arm the timer file descriptor for the earliest deadline, or disarm
+   it if no poll handler is waiting for a timer. */
+static void
+arm(clock_time_t interval, int set)
+{
+  struct itimerspec its;
+  unsigned long ms;
+
+  its.it_interval.tv_sec = its.it_interval.tv_nsec = 0;
+  its.it_value.tv_sec = its.it_value.tv_nsec = 0;
+  if(set) {
+    /* A zero it_value disarms the timer, so the shortest timeout is
+       one nanosecond. */
+    ms = (unsigned long)interval * 1000 / CLOCK_SECOND;
+    its.it_value.tv_sec = ms / 1000;
+    its.it_value.tv_nsec = (ms % 1000) * 1000000 + 1;
+  }
+  timerfd_settime(timerfd, 0, &its, NULL);
+}
+/*-----------------------------------------------------------------------------------*/
+/**
+ * Run the event loop. This function never returns.
+ */
+void
+evloop_run(void)
+{
+  struct epoll_event events[EVLOOP_FDS + 1];
+  clock_time_t interval;
+  uint64_t expirations;
+  int i, n, set;
+
+  while(1) {
+    run();
+    
+    set = timer_next(&interval);
+    if(set && interval == 0) {
+      continue;
+    }
+    arm(interval, set);
+
+    n = epoll_wait(epfd, events, EVLOOP_FDS + 1, -1);
+    for(i = 0; i < n; ++i) {
+      if(events[i].data.u32 == EVLOOP_FDS) {
+	read(timerfd, &expirations, sizeof(expirations));
+      } else {
+	fds[events[i].data.u32].callback(fds[events[i].data.u32].fd);
+      }
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,419 @@
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+
+
+#include <errno.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+
+#if WITH_CTKGTK
+#include <gtk/gtk.h>
+#else /* WITH_CTKGTK */
+#include "evloop.h"
+#endif /* WITH_CTKGTK */
+
+/* BYTE_ORDER is set by uipopt.h, not by the C library headers. */
+#undef BYTE_ORDER
+
+#include "uip.h"
+#include "uip_arch.h"
+#include "uip_arp.h"
+#include "uip-fw.h"
+#include "tcpip.h"
+
+#include "packetdev.h"
+
+/* The version of the ring. With TPACKET_V2, the default, every frame
+   is handed over as soon as it has been received. With TPACKET_V3,
+   the kernel fills a block with many frames and hands it over when it
+   is full or when it has been open for TIMEOUT milliseconds, which is
+   at least one kernel tick. This gives few wakeups under load, but
+   adds the timeout to the round trip time when the load is light, so
+   it has to be asked for. */
+#ifdef PACKETDEV_CONF_VERSION
+#define VERSION PACKETDEV_CONF_VERSION
+#else /* PACKETDEV_CONF_VERSION */
+#define VERSION 2
+#endif /* PACKETDEV_CONF_VERSION */
+
+/* The size and number of the blocks in the receive ring. */
+#ifdef PACKETDEV_CONF_BLOCKSIZE
+#define BLOCKSIZE PACKETDEV_CONF_BLOCKSIZE
+#else /* PACKETDEV_CONF_BLOCKSIZE */
+#define BLOCKSIZE (1 << 16)
+#endif /* PACKETDEV_CONF_BLOCKSIZE */
+
+#ifdef PACKETDEV_CONF_BLOCKS
+#define BLOCKS PACKETDEV_CONF_BLOCKS
+#else /* PACKETDEV_CONF_BLOCKS */
+#define BLOCKS 16
+#endif /* PACKETDEV_CONF_BLOCKS */
+
+#ifdef PACKETDEV_CONF_TIMEOUT
+#define TIMEOUT PACKETDEV_CONF_TIMEOUT
+#else /* PACKETDEV_CONF_TIMEOUT */
+#define TIMEOUT 1
+#endif /* PACKETDEV_CONF_TIMEOUT */
+
+/* The number of frames in the transmit ring. Each frame holds one
+   uIP packet. */
+#ifdef PACKETDEV_CONF_TXFRAMES
+#define TXFRAMES PACKETDEV_CONF_TXFRAMES
+#else /* PACKETDEV_CONF_TXFRAMES */
+#define TXFRAMES 64
+#endif /* PACKETDEV_CONF_TXFRAMES */
+
+#define FRAMESIZE 2048
+#define RXFRAMES (BLOCKSIZE / FRAMESIZE * BLOCKS)
+
+#if VERSION == 3
+#define TPACKET_VERSION TPACKET_V3
+typedef struct tpacket3_hdr frame_hdr;
+#else /* VERSION == 3 */
+#define TPACKET_VERSION TPACKET_V2
+typedef struct tpacket2_hdr frame_hdr;
+#endif /* VERSION == 3 */
+
+/* The frame data follows right after the header in the transmit
+   ring, and the link level address after the header in the receive
+   ring. */
+#define HDRLEN TPACKET_ALIGN(sizeof(frame_hdr))
+
+#define BUF ((struct uip_eth_hdr *)&uip_buf[0])
+#define TCPBUF ((uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
+#define UDPBUF ((uip_udpip_hdr *)&uip_buf[UIP_LLH_LEN])
+
+static int fd;
+static u8_t *rxring, *txring;
+static unsigned int rxindex, txframe;
+
+/* Set while the received frames are processed, so that the frames
+   that are sent in response are only handed to the kernel once all
+   received frames have been processed. */
+static u8_t ininput, txpending;
+
+static void flush(void);
+
+/*-----------------------------------------------------------------------------------*/
+static u8_t
+do_send(void)
+{
+  frame_hdr *hdr;
+  u16_t hdrlen;
+
+  hdr = (frame_hdr *)&txring[txframe * FRAMESIZE];
+  if(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) !=
+     TP_STATUS_AVAILABLE) {
+    /* The ring is full. A send() without MSG_DONTWAIT returns when the
+       kernel has sent all frames in the ring, so the frame is only
+       dropped if that fails. */
+    txpending = 0;
+    if(send(fd, NULL, 0, 0) == -1) {
+      perror("packetdev: do_send: send");
+    }
+    if(__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) !=
+       TP_STATUS_AVAILABLE) {
+      return UIP_FW_DROPPED;
+    }
+  }
+
+  hdrlen = UIP_TCPIP_HLEN + UIP_LLH_LEN;
+  if(uip_len < hdrlen) {
+    hdrlen = uip_len;
+  }
+  memcpy((u8_t *)hdr + HDRLEN, uip_buf, hdrlen);
+  memcpy((u8_t *)hdr + HDRLEN + hdrlen, uip_appdata, uip_len - hdrlen);
+  hdr->tp_len = uip_len;
+#if VERSION == 3
+  hdr->tp_next_offset = 0;
+#endif /* VERSION == 3 */
+  __atomic_store_n(&hdr->tp_status, TP_STATUS_SEND_REQUEST,
+		   __ATOMIC_RELEASE);
+
+  if(++txframe == TXFRAMES) {
+    txframe = 0;
+  }
+  
+  txpending = 1;
+  if(!ininput) {
+    flush();
+  }
+  return UIP_FW_OK;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Ask the kernel to send the frames in the transmit ring. */
+static void
+flush(void)
+{
+  if(txpending) {
+    txpending = 0;
+    if(send(fd, NULL, 0, MSG_DONTWAIT) == -1 && errno != EAGAIN) {
+      perror("packetdev: flush: send");
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+u8_t
+packetdev_send(void)
+{
+  uip_arp_out();
+  return do_send();
+}
+/*-----------------------------------------------------------------------------------*/
+/* The frames that the host sends over a veth pair have not had their
+   TCP or UDP checksum computed, since the checksum is left to the
+   network card. It is computed here instead. */
+static void
+chksum_complete(void)
+{
+  if(TCPBUF->proto == UIP_PROTO_TCP) {
+    uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
+    TCPBUF->tcpchksum = 0;
+    TCPBUF->tcpchksum = ~(uip_tcpchksum());
+  } else if(UDPBUF->proto == UIP_PROTO_UDP) {
+    UDPBUF->udpchksum = 0;
+    UDPBUF->udpchksum = ~(uip_udpchksum());
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+frame_input(u8_t *frame, u16_t len, u8_t csumnotready)
+{
+  memcpy(uip_buf, frame, len);
+  uip_len = len;
+
+  if(BUF->type == htons(UIP_ETHTYPE_IP)) {
+    if(csumnotready) {
+      chksum_complete();
+    }
+    uip_arp_ipin();
+    uip_len -= sizeof(struct uip_eth_hdr);
+    tcpip_input();
+  } else if(BUF->type == htons(UIP_ETHTYPE_ARP)) {
+    uip_arp_arpin();
+    if(uip_len > 0) {
+      do_send();
+    }
+#if UIP_ARP_QUEUE > 0
+    /* Send the packets that were waiting for the ARP reply. */
+    for(uip_arp_flush(); uip_len > 0; uip_arp_flush()) {
+      do_send();
+    }
+#endif /* UIP_ARP_QUEUE > 0 */
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Hand a received frame to uIP, unless it is one of the frames that
+   we have sent ourselves. */
+static void
+hdr_input(frame_hdr *hdr)
+{
+  struct sockaddr_ll *sll;
+
+  sll = (struct sockaddr_ll *)((u8_t *)hdr + HDRLEN);
+  if(sll->sll_pkttype != PACKET_OUTGOING &&
+     hdr->tp_snaplen <= UIP_BUFSIZE) {
+    frame_input((u8_t *)hdr + hdr->tp_mac, hdr->tp_snaplen,
+		(hdr->tp_status & TP_STATUS_CSUMNOTREADY) != 0);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Process all blocks, or frames, that the kernel has handed over,
+   and give them back. */
+static void
+input(int source)
+{
+#if VERSION == 3
+  struct tpacket_block_desc *block;
+  struct tpacket3_hdr *hdr;
+  unsigned int i;
+
+  ininput = 1;
+  while(1) {
+    block = (struct tpacket_block_desc *)&rxring[rxindex * BLOCKSIZE];
+    if((__atomic_load_n(&block->hdr.bh1.block_status, __ATOMIC_ACQUIRE) &
+	TP_STATUS_USER) == 0) {
+      break;
+    }
+
+    hdr = (struct tpacket3_hdr *)((u8_t *)block +
+				  block->hdr.bh1.offset_to_first_pkt);
+    for(i = 0; i < block->hdr.bh1.num_pkts; ++i) {
+      hdr_input(hdr);
+      hdr = (struct tpacket3_hdr *)((u8_t *)hdr + hdr->tp_next_offset);
+    }
+
+    __atomic_store_n(&block->hdr.bh1.block_status, TP_STATUS_KERNEL,
+		     __ATOMIC_RELEASE);
+    if(++rxindex == BLOCKS) {
+      rxindex = 0;
+    }
+  }
+#else /* VERSION == 3 */
+  struct tpacket2_hdr *hdr;
+
+  ininput = 1;
+  while(1) {
+    hdr = (struct tpacket2_hdr *)&rxring[rxindex * FRAMESIZE];
+    if((__atomic_load_n(&hdr->tp_status, __ATOMIC_ACQUIRE) &
+	TP_STATUS_USER) == 0) {
+      break;
+    }
+
+    hdr_input(hdr);
+
+    __atomic_store_n(&hdr->tp_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+    if(++rxindex == RXFRAMES) {
+      rxindex = 0;
+    }
+  }
+#endif /* VERSION == 3 */
+  ininput = 0;
+  flush();
+}
+/*-----------------------------------------------------------------------------------*/
+#if WITH_CTKGTK
+static void
+read_callback(gpointer data, gint source, GdkInputCondition condition)
+{
+  input(source);
+}
+#endif /* WITH_CTKGTK */
+/*-----------------------------------------------------------------------------------*/
+/**
+ * Attach uIP to a network interface.
+ *
+ * \param ifname The name of the interface.
+ */
+void
+packetdev_init(const char *ifname)
+{
+  struct tpacket_req3 req;
+  struct sockaddr_ll addr;
+  struct ifreq ifr;
+  struct uip_eth_addr ethaddr;
+  int version, i;
+  size_t rxsize, txsize;
+
+  fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if(fd == -1) {
+    perror("packetdev: packetdev_init: socket");
+    exit(1);
+  }
+
+  version = TPACKET_VERSION;
+  if(setsockopt(fd, SOL_PACKET, PACKET_VERSION,
+		&version, sizeof(version)) == -1) {
+    perror("packetdev: packetdev_init: PACKET_VERSION");
+    exit(1);
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = BLOCKSIZE;
+  req.tp_block_nr = BLOCKS;
+  req.tp_frame_size = FRAMESIZE;
+  req.tp_frame_nr = RXFRAMES;
+#if VERSION == 3
+  req.tp_retire_blk_tov = TIMEOUT;
+#endif /* VERSION == 3 */
+  if(setsockopt(fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) == -1) {
+    perror("packetdev: packetdev_init: PACKET_RX_RING");
+    exit(1);
+  }
+  rxsize = (size_t)BLOCKSIZE * BLOCKS;
+
+  /* The transmit ring has a single block of fixed size frames. */
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = FRAMESIZE * TXFRAMES;
+  req.tp_block_nr = 1;
+  req.tp_frame_size = FRAMESIZE;
+  req.tp_frame_nr = TXFRAMES;
+  if(setsockopt(fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) == -1) {
+    perror("packetdev: packetdev_init: PACKET_TX_RING");
+    exit(1);
+  }
+  txsize = (size_t)FRAMESIZE * TXFRAMES;
+
+  /* Both rings are mapped at once, the transmit ring right after the
+     receive ring. */
+  rxring = mmap(NULL, rxsize + txsize, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_LOCKED, fd, 0);
+  if(rxring == MAP_FAILED) {
+    rxring = mmap(NULL, rxsize + txsize, PROT_READ | PROT_WRITE,
+		  MAP_SHARED, fd, 0);
+  }
+  if(rxring == MAP_FAILED) {
+    perror("packetdev: packetdev_init: mmap");
+    exit(1);
+  }
+  txring = rxring + rxsize;
+
+  memset(&ifr, 0, sizeof(ifr));
+  strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+  if(ioctl(fd, SIOCGIFHWADDR, &ifr) == -1) {
+    perror("packetdev: packetdev_init: SIOCGIFHWADDR");
+    exit(1);
+  }
+  for(i = 0; i < 6; ++i) {
+    ethaddr.addr[i] = ifr.ifr_hwaddr.sa_data[i];
+  }
+  uip_setethaddr(ethaddr);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sll_family = AF_PACKET;
+  addr.sll_protocol = htons(ETH_P_ALL);
+  addr.sll_ifindex = if_nametoindex(ifname);
+  if(addr.sll_ifindex == 0 ||
+     bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+    perror("packetdev: packetdev_init: bind");
+    exit(1);
+  }
+
+#if WITH_CTKGTK
+  gdk_input_add(fd, GDK_INPUT_READ, read_callback, NULL);
+#else /* WITH_CTKGTK */
+  evloop_add(fd, input);
+#endif /* WITH_CTKGTK */
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+#ifndef __PACKETDEV_H__
+#define __PACKETDEV_H__
+
+#include "uip.h"
+
+/*
+ * The packet device attaches uIP to a Linux network interface, such
+ * as one end of a veth pair, through a memory mapped TPACKET_V2
+ * socket, or TPACKET_V3 if PACKETDEV_CONF_VERSION is 3. The kernel
+ * puts the received frames in a ring that is shared with uIP, and
+ * sends the frames that uIP puts in a shared transmit ring. All frames
+ * that are written while the received frames are processed are sent
+ * with a single system call. packetdev_send() returns UIP_FW_DROPPED
+ * if the transmit ring is full and the kernel fails to empty it.
+ *
+ * uIP takes the hardware address of the interface, so the host should
+ * not have an IP address on the same interface.
+ *
+ * Example:
+ \code
+ static struct uip_fw_netif packetif =
+   {UIP_FW_NETIF(0,0,0,0, 0,0,0,0, packetdev_send)};
+
+ packetdev_init("veth0");
+ uip_fw_default(&packetif);
+ \endcode
+ */
+
+void packetdev_init(const char *ifname);
+u8_t packetdev_send(void);
+
+#endif /* __PACKETDEV_H__ */
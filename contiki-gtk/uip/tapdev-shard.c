@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/ioctl.h>
+#include <sys/eventfd.h>
+
+#ifdef linux
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#define DEVTAP "/dev/net/tun"
+#else  /* linux */
+#define DEVTAP "/dev/tap0"
+#endif /* linux */
+
+/* uipopt.h sets BYTE_ORDER from UIP_CONF_BYTE_ORDER instead of the C
+   library. */
+#undef BYTE_ORDER
+
+#include "ek.h"
+#include "timer.h"
+#include "packet-service.h"
+
+#include "uip.h"
+#include "uip_arp.h"
+#include "tcpip.h"
+
+#include "tapdev-shard.h"
+
+/* The number of frames that can wait for each worker. Must be a
+   power of two. */
+#ifdef TAPDEV_SHARD_CONF_RING
+#define RING TAPDEV_SHARD_CONF_RING
+#else /* TAPDEV_SHARD_CONF_RING */
+#define RING 64
+#endif /* TAPDEV_SHARD_CONF_RING */
+
+/* The longest time, in milliseconds, that a worker sleeps before it
+   runs its timers. */
+#define TICK 10
+
+#define BUF ((struct uip_eth_hdr *)&uip_buf[0])
+#define IPBUF(f) ((uip_tcpip_hdr *)&(f)[UIP_LLH_LEN])
+
+struct frame {
+  u16_t len;
+  u8_t buf[UIP_BUFSIZE];
+};
+
+/* The frames are passed from the dispatcher to a worker through a
+   single-producer, single-consumer ring. Only the dispatcher writes
+   head and only the worker writes tail. The worker sets idle before
+   it goes to sleep, and is then woken up through the wakeup event
+   file descriptor. */
+struct shard {
+  struct frame ring[RING];
+  unsigned int head, tail;
+  int idle, wakeup;
+  pthread_t thread;
+  unsigned long frames, drops;
+};
+
+static struct shard shards[UIP_CONTEXTS];
+static void (* shard_init)(u8_t shard);
+static int fd;
+
+static void output(u8_t *hdr, u16_t hdrlen, u8_t *data, u16_t datalen);
+
+static const struct packet_service_state state =
+  {
+    PACKET_SERVICE_VERSION,
+    output
+  };
+
+EK_PROCESS(proc, PACKET_SERVICE_NAME ": TAP shard", EK_PRIO_NORMAL,
+	   NULL, NULL, (void *)&state);
+
+/*-----------------------------------------------------------------------------------*/
+void
+tapdev_shard_init(void)
+{
+  char buf[1024];
+  u8_t i;
+
+  fd = open(DEVTAP, O_RDWR);
+  if(fd == -1) {
+    perror("tapdev-shard: tapdev_shard_init: open");
+    exit(1);
+  }
+
+#ifdef linux
+  {
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP|IFF_NO_PI;
+    if(ioctl(fd, TUNSETIFF, (void *) &ifr) < 0) {
+      perror("tapdev-shard: tapdev_shard_init: ioctl");
+      exit(1);
+    }
+  }
+#endif /* linux */
+
+  snprintf(buf, sizeof(buf), "ifconfig tap0 inet 192.168.2.1");
+  system(buf);
+  printf("%s\n", buf);
+
+  for(i = 0; i < UIP_CONTEXTS; ++i) {
+    shards[i].wakeup = eventfd(0, 0);
+    if(shards[i].wakeup == -1) {
+      perror("tapdev-shard: tapdev_shard_init: eventfd");
+      exit(1);
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+do_send(void)
+{
+  u8_t tmpbuf[UIP_BUFSIZE + UIP_LLH_LEN];
+  u16_t hdrlen;
+
+  hdrlen = UIP_TCPIP_HLEN + UIP_LLH_LEN;
+  if(uip_len < hdrlen) {
+    hdrlen = uip_len;
+  }
+  memcpy(tmpbuf, uip_buf, hdrlen);
+  memcpy(&tmpbuf[hdrlen], uip_appdata, uip_len - hdrlen);
+
+  /* A frame is written with a single write(), so the workers can
+     share the file descriptor. */
+  if(write(fd, tmpbuf, uip_len) == -1) {
+    perror("tapdev-shard: do_send: write");
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+output(u8_t *hdr, u16_t hdrlen, u8_t *data, u16_t datalen)
+{
+  uip_arp_out();
+  do_send();
+}
+/*-----------------------------------------------------------------------------------*/
+/* Process the frames that the dispatcher has given to a worker. */
+static void
+shard_input(struct shard *s)
+{
+  unsigned int head;
+  struct frame *f;
+
+  while(s->tail != (head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE))) {
+    f = &s->ring[s->tail & (RING - 1)];
+    memcpy(uip_buf, f->buf, f->len);
+    uip_len = f->len;
+    __atomic_store_n(&s->tail, s->tail + 1, __ATOMIC_RELEASE);
+
+    if(BUF->type == HTONS(UIP_ETHTYPE_IP)) {
+      uip_arp_ipin();
+      uip_len -= sizeof(struct uip_eth_hdr);
+      tcpip_input();
+    } else if(BUF->type == HTONS(UIP_ETHTYPE_ARP)) {
+      uip_arp_arpin();
+      /* Every worker learns from the ARP frames, but only the first
+	 one answers the requests. */
+      if(uip_len > 0 && uip_getcontext() == 0) {
+	do_send();
+      }
+#if UIP_ARP_QUEUE > 0
+      for(uip_arp_flush(); uip_len > 0; uip_arp_flush()) {
+	do_send();
+      }
+#endif /* UIP_ARP_QUEUE > 0 */
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void *
+shard_thread(void *arg)
+{
+  struct shard *s;
+  struct pollfd pfd;
+  struct timer arptimer;
+  eventfd_t n;
+
+  s = (struct shard *)arg;
+  uip_setcontext(s - shards);
+
+  ek_init();
+  tcpip_init(NULL);
+  ek_service_start(PACKET_SERVICE_NAME, &proc);
+  shard_init(s - shards);
+
+  timer_set(&arptimer, CLOCK_SECOND * 10);
+
+  pfd.fd = s->wakeup;
+  pfd.events = POLLIN;
+  while(1) {
+    shard_input(s);
+    while(ek_run() > 0);
+
+    if(timer_expired(&arptimer)) {
+      timer_restart(&arptimer);
+      uip_arp_timer();
+    }
+
+    /* Sleep until the dispatcher has new frames for us, or until it
+       is time to run the timers. The ring is checked again after
+       idle has been set, so that no wakeup is lost. */
+    __atomic_store_n(&s->idle, 1, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(&s->head, __ATOMIC_SEQ_CST) == s->tail &&
+       poll(&pfd, 1, TICK) > 0) {
+      eventfd_read(s->wakeup, &n);
+    }
+    __atomic_store_n(&s->idle, 0, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+tapdev_shard_start(void (* init)(u8_t shard))
+{
+  u8_t i;
+
+  shard_init = init;
+  for(i = 0; i < UIP_CONTEXTS; ++i) {
+    pthread_create(&shards[i].thread, NULL, shard_thread, &shards[i]);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Hash a frame by its IP addresses and, unless it is a fragment, by
+   its port numbers. The TCP and UDP port numbers are at the same
+   place in the header. */
+static u8_t
+steer(u8_t *frame)
+{
+  uip_tcpip_hdr *hdr;
+  u16_t h;
+
+  hdr = IPBUF(frame);
+  h = hdr->srcipaddr[0] ^ hdr->srcipaddr[1] ^
+    hdr->destipaddr[0] ^ hdr->destipaddr[1];
+  if((hdr->proto == UIP_PROTO_TCP || hdr->proto == UIP_PROTO_UDP) &&
+     (hdr->ipoffset[0] & 0x3f) == 0 && hdr->ipoffset[1] == 0) {
+    h ^= hdr->srcport ^ hdr->destport;
+  }
+  h ^= h >> 8;
+  return (u8_t)(h % UIP_CONTEXTS);
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+put(struct shard *s, u8_t *frame, u16_t len)
+{
+  unsigned int tail;
+
+  tail = __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE);
+  if(s->head - tail == RING) {
+    ++s->drops;
+    return;
+  }
+  memcpy(s->ring[s->head & (RING - 1)].buf, frame, len);
+  s->ring[s->head & (RING - 1)].len = len;
+  ++s->frames;
+  __atomic_store_n(&s->head, s->head + 1, __ATOMIC_SEQ_CST);
+
+  if(__atomic_load_n(&s->idle, __ATOMIC_SEQ_CST)) {
+    eventfd_write(s->wakeup, 1);
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+void
+tapdev_shard_dispatch(void)
+{
+  u8_t frame[UIP_BUFSIZE];
+  int ret;
+  u8_t i;
+
+  while(1) {
+    ret = read(fd, frame, UIP_BUFSIZE);
+    if(ret == -1) {
+      perror("tapdev-shard: tapdev_shard_dispatch: read");
+      continue;
+    }
+
+    if(((struct uip_eth_hdr *)frame)->type == HTONS(UIP_ETHTYPE_IP)) {
+      put(&shards[steer(frame)], frame, ret);
+    } else if(((struct uip_eth_hdr *)frame)->type ==
+	      HTONS(UIP_ETHTYPE_ARP)) {
+      for(i = 0; i < UIP_CONTEXTS; ++i) {
+	put(&shards[i], frame, ret);
+      }
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+#ifndef __TAPDEV_SHARD_H__
+#define __TAPDEV_SHARD_H__
+
+#include "uip.h"
+
+/*
+ * The sharded tap device runs UIP_CONTEXTS worker threads, each with
+ * a Contiki instance and uIP stack of its own. A dispatcher thread
+ * reads the frames from the tap device and steers each frame to a
+ * worker by a hash of its addresses and port numbers, so that all
+ * segments of a connection are handled by the same worker. ARP
+ * frames are given to all workers.
+ *
+ * The build must set UIP_CONF_CONTEXT_THREADS, and UIP_CONF_CONTEXT_TLS
+ * and CC_CONF_THREAD_LOCAL to __thread.
+ *
+ * Only connections that are opened by the remote host are steered
+ * correctly, since the replies to a connection opened by a worker
+ * may be steered to another worker.
+ */
+
+void tapdev_shard_init(void);
+void tapdev_shard_start(void (* init)(u8_t shard));
+void tapdev_shard_dispatch(void);
+
+#endif /* __TAPDEV_SHARD_H__ */
@@ -35,6 +35,7 @@
  */
 
 
+#include <errno.h>
 #include <fcntl.h>
 #include <stdlib.h>
 #include <stdio.h>
@@ -47,7 +48,11 @@
 #include <sys/uio.h>
 #include <sys/socket.h>
 
+#if WITH_CTKGTK
 #include <gtk/gtk.h>
+#else /* WITH_CTKGTK */
+#include "evloop.h"
+#endif /* WITH_CTKGTK */
 
 #ifdef linux
 #include <sys/ioctl.h>
@@ -58,15 +63,58 @@
 #define DEVTAP "/dev/tap0"
 #endif /* linux */
 
+/* The C library headers define BYTE_ORDER, which uipopt.h sets from
+   UIP_CONF_BYTE_ORDER. */
+#undef BYTE_ORDER
+
 #include "uip.h"
 #include "uip_arp.h"
+#include "uip-fw.h"
 
 
 #include "tcpip.h"
 
 #define DROP 0
 
+/* The number of queues that the tap device is opened with. More than
+   one queue requires a kernel with IFF_MULTI_QUEUE support. */
+#ifdef TAPDEV_CONF_QUEUES
+#define TAPDEV_QUEUES TAPDEV_CONF_QUEUES
+#else /* TAPDEV_CONF_QUEUES */
+#define TAPDEV_QUEUES 1
+#endif /* TAPDEV_CONF_QUEUES */
+
+/* The largest number of frames that are read from a queue in one
+   input callback, so that the GUI is not starved during a flood. */
+#ifdef TAPDEV_CONF_BURST
+#define TAPDEV_BURST TAPDEV_CONF_BURST
+#else /* TAPDEV_CONF_BURST */
+#define TAPDEV_BURST 32
+#endif /* TAPDEV_CONF_BURST */
+
+/* Count the frames and the system calls made for them, and print the
+   number of frames per system call every 10 seconds. The tap device
+   takes exactly one frame per write, so only the frames are counted
+   on the transmit side. */
+#ifdef TAPDEV_CONF_STATISTICS
+#define TAPDEV_STATISTICS TAPDEV_CONF_STATISTICS
+#else /* TAPDEV_CONF_STATISTICS */
+#define TAPDEV_STATISTICS 0
+#endif /* TAPDEV_CONF_STATISTICS */
+
+#if TAPDEV_STATISTICS
+#define TAPDEV_STAT(s) s
+static struct {
+  unsigned long rxframes, rxcalls, txframes;
+} stats;
+#else /* TAPDEV_STATISTICS */
+#define TAPDEV_STAT(s)
+#endif /* TAPDEV_STATISTICS */
+
 static int drop = 0;
+static int fds[TAPDEV_QUEUES];
+/* The queue that the last frame was read from. Replies are written to
+   the same queue. */
 static int fd;
 
 static unsigned long lasttime;
@@ -75,31 +123,13 @@ static struct timezone tz;
 #define BUF ((struct uip_eth_hdr *)&uip_buf[0])
 
 static void do_send(void);
-void tapdev_send(void);
+u8_t tapdev_send(void);
 
 
 static void
-read_callback(gpointer data, gint source, GdkInputCondition condition)
+arp_input(void)
 {
-  int ret;
-  
-  ret = read(fd, uip_buf, UIP_BUFSIZE);
-  
-  if(ret == -1) {
-    perror("tap_dev: tapdev_read: read");
-  }
-  
-  uip_len = ret;
-  
-  if(BUF->type == htons(UIP_ETHTYPE_IP)) {
-    uip_arp_ipin();
-    uip_len -= sizeof(struct uip_eth_hdr);
-    /*    uip_input();*/
-    tcpip_input();
-    /* If the above function invocation resulted in data that
-       should be sent out on the network, the global variable
-       uip_len is set to a value > 0. */
-  } else if(BUF->type == htons(UIP_ETHTYPE_ARP)) {
+  if(BUF->type == htons(UIP_ETHTYPE_ARP)) {
     uip_arp_arpin();
     /* If the above function invocation resulted in data that
        should be sent out on the network, the global variable
@@ -107,9 +137,95 @@ read_callback(gpointer data, gint source, GdkInputCondition condition)
     if(uip_len > 0) {
       do_send();
     }
+#if UIP_ARP_QUEUE > 0
+    /* Send the packets that were waiting for the ARP reply. */
+    for(uip_arp_flush(); uip_len > 0; uip_arp_flush()) {
+      do_send();
+    }
+#endif /* UIP_ARP_QUEUE > 0 */
   }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Read one frame from the non-blocking queue descriptor. Returns the
+   length of the frame, or 0 when the queue is empty. */
+static int
+queue_read(u8_t *buf)
+{
+  int ret;
+
+  TAPDEV_STAT(++stats.rxcalls);
+  ret = read(fd, buf, UIP_BUFSIZE);
+  if(ret == -1) {
+    if(errno != EAGAIN && errno != EWOULDBLOCK) {
+      perror("tap_dev: tapdev_read: read");
+    }
+    return 0;
+  }
+  TAPDEV_STAT(++stats.rxframes);
+  return ret;
+}
+
+static void
+input(int source)
+{
+  int ret, n;
+#if UIP_INPUT_RING > 0
+  u8_t *slot;
+#endif /* UIP_INPUT_RING > 0 */
+
+  fd = source;
+
+  /* The queue is drained until the read would block, so that a burst
+     of frames costs one trip through the GTK main loop and a single
+     extra read() call. */
+#if UIP_INPUT_RING > 0
+  /* The frames are read into the input ring, so that tcpip_input()
+     can process them as one burst. */
+  for(n = 0; n < TAPDEV_BURST && (slot = tcpip_input_slot()) != NULL; ++n) {
+    ret = queue_read(slot);
+    if(ret == 0) {
+      break;
+    }
 
+    if(((struct uip_eth_hdr *)slot)->type == htons(UIP_ETHTYPE_IP)) {
+      tcpip_input_put(ret - sizeof(struct uip_eth_hdr));
+    } else {
+      memcpy(uip_buf, slot, ret);
+      uip_len = ret;
+      arp_input();
+    }
+  }
 
+  uip_len = 0;
+  tcpip_input();
+#else /* UIP_INPUT_RING > 0 */
+  for(n = 0; n < TAPDEV_BURST; ++n) {
+    ret = queue_read(uip_buf);
+    if(ret == 0) {
+      break;
+    }
+  
+    uip_len = ret;
+  
+    if(BUF->type == htons(UIP_ETHTYPE_IP)) {
+      uip_arp_ipin();
+      uip_len -= sizeof(struct uip_eth_hdr);
+      /*    uip_input();*/
+      tcpip_input();
+      /* If the above function invocation resulted in data that
+	 should be sent out on the network, the global variable
+	 uip_len is set to a value > 0. */
+    } else {
+      arp_input();
+    }
+  }
+#endif /* UIP_INPUT_RING > 0 */
+}
+#if WITH_CTKGTK
+static void
+read_callback(gpointer data, gint source, GdkInputCondition condition)
+{
+  input(source);
 }
 gint
 timeout_callback(gpointer data)
@@ -144,45 +260,77 @@ timeout_callback(gpointer data)
   if(++arptimer == 20) {	
     uip_arp_timer();
     arptimer = 0;
+#if TAPDEV_STATISTICS
+    printf("tapdev: rx %lu frames/%lu calls, tx %lu frames\n",
+	   stats.rxframes, stats.rxcalls, stats.txframes);
+    if(stats.rxcalls > 0) {
+      printf("tapdev: %lu.%02lu rx frames per call\n",
+	     stats.rxframes / stats.rxcalls,
+	     stats.rxframes * 100 / stats.rxcalls % 100);
+    }
+#endif /* TAPDEV_STATISTICS */
   }
  
   return TRUE;
 }
+#endif /* WITH_CTKGTK */
 
 /*-----------------------------------------------------------------------------------*/
 void
 tapdev_init(void)
 {
   char buf[1024];
+  int i;
+#ifdef linux
+  struct ifreq ifr;
+
+  memset(&ifr, 0, sizeof(ifr));
+  ifr.ifr_flags = IFF_TAP|IFF_NO_PI;
+#if TAPDEV_QUEUES > 1
+  ifr.ifr_flags |= IFF_MULTI_QUEUE;
+#endif /* TAPDEV_QUEUES > 1 */
+#endif /* linux */
   
-  fd = open(DEVTAP, O_RDWR);
-  if(fd == -1) {
-    perror("tapdev: tapdev_init: open");
-    return;
-  }
+  for(i = 0; i < TAPDEV_QUEUES; ++i) {
+    fds[i] = open(DEVTAP, O_RDWR);
+    if(fds[i] == -1) {
+      perror("tapdev: tapdev_init: open");
+      return;
+    }
 
 #ifdef linux
-  {
-    struct ifreq ifr;
-    memset(&ifr, 0, sizeof(ifr));
-    ifr.ifr_flags = IFF_TAP|IFF_NO_PI;
-    if (ioctl(fd, TUNSETIFF, (void *) &ifr) < 0) {
-      perror(buf);
+    /* The first ioctl() fills in the name of the device, so that the
+       other queues are attached to the same device. */
+    if (ioctl(fds[i], TUNSETIFF, (void *) &ifr) < 0) {
+      perror("tapdev: tapdev_init: ioctl");
       exit(1);
     }
-  }
 #endif /* Linux */
 
+    fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+  }
+  fd = fds[0];
+
   snprintf(buf, sizeof(buf), "ifconfig tap0 inet 192.168.2.1");
   system(buf);
   printf("%s\n", buf); 
 
   lasttime = 0;
 
-  gdk_input_add(fd, GDK_INPUT_READ,
-		read_callback, NULL);
+#if WITH_CTKGTK
+  for(i = 0; i < TAPDEV_QUEUES; ++i) {
+    gdk_input_add(fds[i], GDK_INPUT_READ,
+		  read_callback, NULL);
+  }
 
   gtk_timeout_add(500, timeout_callback, NULL);
+#else /* WITH_CTKGTK */
+  /* Without GTK, the periodic processing is done by the tcpip
+     process and the ARP timer is run by the main program. */
+  for(i = 0; i < TAPDEV_QUEUES; ++i) {
+    evloop_add(fds[i], input);
+  }
+#endif /* WITH_CTKGTK */
 }
 /*-----------------------------------------------------------------------------------*/
 unsigned int
@@ -243,8 +391,8 @@ static void
 do_send(void) 
 {
   int ret;
-  char tmpbuf[UIP_BUFSIZE];
-  int i;
+  struct iovec iov[2];
+  int hdrlen;
 
   if(fd <= 0) {
     return;
@@ -259,30 +407,35 @@ do_send(void)
     return;
   }
 #endif /* DROP */
-  
-  for(i = 0; i < UIP_TCPIP_HLEN + UIP_LLH_LEN; i++) {
-    tmpbuf[i] = uip_buf[i];
-  }
 
-  
-  for(; i < uip_len; i++) {
-    tmpbuf[i] = uip_appdata[i - UIP_TCPIP_HLEN - UIP_LLH_LEN];
+  /* The headers and the application data are gathered by writev(),
+     instead of being copied into a temporary buffer. The tap device
+     takes exactly one frame per call. */
+  hdrlen = UIP_TCPIP_HLEN + UIP_LLH_LEN;
+  if(uip_len < hdrlen) {
+    hdrlen = uip_len;
   }
-  
-  ret = write(fd, tmpbuf, uip_len);
+  iov[0].iov_base = uip_buf;
+  iov[0].iov_len = hdrlen;
+  iov[1].iov_base = uip_appdata;
+  iov[1].iov_len = uip_len - hdrlen;
+
+  ret = writev(fd, iov, uip_len > hdrlen? 2: 1);
   
   if(ret == -1) {
     perror("tap_dev: tapdev_send: writev");
     exit(1);
   }
+  TAPDEV_STAT(++stats.txframes);
 }  
 /*-----------------------------------------------------------------------------------*/
-void
+u8_t
 tapdev_send(void)
 {
 
   uip_arp_out();
 
   do_send();
+  return UIP_FW_OK;
 }
 /*-----------------------------------------------------------------------------------*/
@@ -39,8 +39,35 @@
 #include "uip.h"
 #include "uip_arch.h"
 
+#include <string.h>
+
+/* UIP_ARCH_CONF_SIMD limits the SIMD versions of the checksum that
+   may be used: 0 for none, 1 for SSE2 and 2 for SSE2 and AVX2. */
+#ifdef UIP_ARCH_CONF_SIMD
+#define SIMD UIP_ARCH_CONF_SIMD
+#else /* UIP_ARCH_CONF_SIMD */
+#define SIMD 2
+#endif /* UIP_ARCH_CONF_SIMD */
+
+#if SIMD > 0 && defined(__GNUC__) && \
+    (defined(__i386__) || defined(__x86_64__))
+#define CHKSUM_X86 1
+#include <immintrin.h>
+#endif /* SIMD > 0 && __GNUC__ && (__i386__ || __x86_64__) */
+
 #define BUF ((uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
 #define IP_PROTO_TCP    6
+#define IP_PROTO_UDP    17
+
+/* The checksum functions below add up the data into a 64-bit
+   accumulator, and the carries are folded back into 16 bits only when
+   the checksum is complete. Since 2^16 is congruent to 1 modulo
+   0xffff, adding 32-bit words yields the same one's complement sum as
+   adding the 16-bit words they consist of. */
+typedef unsigned long long chksum_acc_t;
+
+static chksum_acc_t (* chksum_add)(chksum_acc_t acc,
+				   const u8_t *data, u16_t len);
 
 /*-----------------------------------------------------------------------------------*/
 void
@@ -71,82 +98,176 @@ uip_add32(u8_t *op32, u16_t op16)
   }
 }
 /*-----------------------------------------------------------------------------------*/
-u16_t
-uip_chksum(u16_t *sdata, u16_t len)
+static u16_t
+chksum_fold(chksum_acc_t acc)
 {
-  u8_t *dataptr;
-  static u16_t acc, tmp;
-  
-  dataptr = sdata;
-  for(acc = 0; len > 1; len -= 2) {
-    tmp = HTONS((((u16_t)*dataptr) << 8)) + HTONS((u16_t)*(dataptr + 1));
-    acc += tmp;
-    if(acc < tmp) {
-      ++acc;
-    }
-    dataptr += 2;
+  acc = (acc >> 32) + (acc & 0xffffffffUL);
+  acc = (acc >> 32) + (acc & 0xffffffffUL);
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+  acc = (acc >> 16) + (acc & 0xffff);
+  return (u16_t)acc;
+}
+/*-----------------------------------------------------------------------------------*/
+static chksum_acc_t
+chksum_add_portable(chksum_acc_t acc, const u8_t *data, u16_t len)
+{
+  unsigned int w0, w1, w2, w3;
+  u16_t h;
+  u8_t last[2];
+
+  while(len >= 16) {
+    memcpy(&w0, data, 4);
+    memcpy(&w1, data + 4, 4);
+    memcpy(&w2, data + 8, 4);
+    memcpy(&w3, data + 12, 4);
+    acc += (chksum_acc_t)w0 + w1 + w2 + w3;
+    data += 16;
+    len -= 16;
   }
-  
+  while(len >= 4) {
+    memcpy(&w0, data, 4);
+    acc += w0;
+    data += 4;
+    len -= 4;
+  }
+  if(len >= 2) {
+    memcpy(&h, data, 2);
+    acc += h;
+    data += 2;
+    len -= 2;
+  }
+
   /* add up any odd byte */
   if(len == 1) {
-    tmp = HTONS(((u16_t)(*dataptr)) << 8);
-    acc += tmp;
-    if(acc < tmp) {
-      ++acc;
-    }
+    last[0] = *data;
+    last[1] = 0;
+    memcpy(&h, last, 2);
+    acc += h;
   }
 
   return acc;
 }
 /*-----------------------------------------------------------------------------------*/
+#if CHKSUM_X86
+/* The SIMD versions zero-extend the 16-bit words into 32-bit lanes. A
+   lane receives two words per iteration, so it cannot overflow for
+   any length that fits in a u16_t. */
+__attribute__((target("sse2")))
+static chksum_acc_t
+chksum_add_sse2(chksum_acc_t acc, const u8_t *data, u16_t len)
+{
+  __m128i sum, zero, v;
+  unsigned int lanes[4];
+
+  sum = zero = _mm_setzero_si128();
+  while(len >= 16) {
+    v = _mm_loadu_si128((const __m128i *)data);
+    sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(v, zero));
+    sum = _mm_add_epi32(sum, _mm_unpackhi_epi16(v, zero));
+    data += 16;
+    len -= 16;
+  }
+  _mm_storeu_si128((__m128i *)lanes, sum);
+  acc += (chksum_acc_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+  return chksum_add_portable(acc, data, len);
+}
+/*-----------------------------------------------------------------------------------*/
+#if SIMD > 1
+__attribute__((target("avx2")))
+static chksum_acc_t
+chksum_add_avx2(chksum_acc_t acc, const u8_t *data, u16_t len)
+{
+  __m256i sum, zero, v;
+  unsigned int lanes[8];
+
+  sum = zero = _mm256_setzero_si256();
+  while(len >= 32) {
+    v = _mm256_loadu_si256((const __m256i *)data);
+    sum = _mm256_add_epi32(sum, _mm256_unpacklo_epi16(v, zero));
+    sum = _mm256_add_epi32(sum, _mm256_unpackhi_epi16(v, zero));
+    data += 32;
+    len -= 32;
+  }
+  _mm256_storeu_si256((__m256i *)lanes, sum);
+  acc += (chksum_acc_t)lanes[0] + lanes[1] + lanes[2] + lanes[3] +
+    lanes[4] + lanes[5] + lanes[6] + lanes[7];
+
+  return chksum_add_portable(acc, data, len);
+}
+#endif /* SIMD > 1 */
+#endif /* CHKSUM_X86 */
+/*-----------------------------------------------------------------------------------*/
+static chksum_acc_t
+chksum(chksum_acc_t acc, const u8_t *data, u16_t len)
+{
+  /* Pick the fastest implementation that the CPU supports the first
+     time we are called. */
+  if(chksum_add == NULL) {
+    chksum_add = chksum_add_portable;
+#if CHKSUM_X86
+    __builtin_cpu_init();
+#if SIMD > 1
+    if(__builtin_cpu_supports("avx2")) {
+      chksum_add = chksum_add_avx2;
+    } else
+#endif /* SIMD > 1 */
+    if(__builtin_cpu_supports("sse2")) {
+      chksum_add = chksum_add_sse2;
+    }
+#endif /* CHKSUM_X86 */
+  }
+  return chksum_add(acc, data, len);
+}
+/*-----------------------------------------------------------------------------------*/
+u16_t
+uip_chksum(u16_t *sdata, u16_t len)
+{
+  return chksum_fold(chksum(0, (u8_t *)sdata, len));
+}
+/*-----------------------------------------------------------------------------------*/
 u16_t
 uip_ipchksum(void)
 {
   return uip_chksum((u16_t *)&uip_buf[UIP_LLH_LEN], UIP_IPH_LEN);
 }
 /*-----------------------------------------------------------------------------------*/
-u16_t
-uip_tcpchksum(void)
+static u16_t
+transport_chksum(u8_t proto)
 {
-  u16_t hsum, sum;
-
-  
-  /* Compute the checksum of the TCP header. */
-  hsum = uip_chksum((u16_t *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN], UIP_TCPH_LEN);
+  chksum_acc_t acc;
+  u16_t len;
 
-  /* Compute the checksum of the data in the TCP packet and add it to
-     the TCP header checksum. */
-  sum = uip_chksum((u16_t *)uip_appdata,
-		   (u16_t)(((((u16_t)(BUF->len[0]) << 8) + BUF->len[1]) -
-		   UIP_IPTCPH_LEN)));
+  /* The length of the TCP or UDP segment, including its header. */
+  len = (((u16_t)(BUF->len[0]) << 8) + BUF->len[1]) - UIP_IPH_LEN;
 
-
-  if((sum += hsum) < hsum) {
-    ++sum;
-  }
-  
-  if((sum += BUF->srcipaddr[0]) < BUF->srcipaddr[0]) {
-    ++sum;
-  }
-  if((sum += BUF->srcipaddr[1]) < BUF->srcipaddr[1]) {
-    ++sum;
-  }
-  if((sum += BUF->destipaddr[0]) < BUF->destipaddr[0]) {
-    ++sum;
-  }
-  if((sum += BUF->destipaddr[1]) < BUF->destipaddr[1]) {
-    ++sum;
-  }
-  if((sum += (u16_t)HTONS((u16_t)IP_PROTO_TCP)) < (u16_t)HTONS((u16_t)IP_PROTO_TCP)) {
-    ++sum;
+  /* The TCP data may be located anywhere in memory, as pointed to by
+     uip_appdata, whereas UDP data always is in the uip_buf. */
+  if(proto == IP_PROTO_TCP && len >= UIP_TCPH_LEN) {
+    acc = chksum(0, &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN], UIP_TCPH_LEN);
+    acc = chksum(acc, uip_appdata, len - UIP_TCPH_LEN);
+  } else {
+    acc = chksum(0, &uip_buf[UIP_LLH_LEN + UIP_IPH_LEN], len);
   }
 
-  hsum = (u16_t)HTONS((((u16_t)(BUF->len[0]) << 8) + BUF->len[1]) - UIP_IPH_LEN);
-  
-  if((sum += hsum) < hsum) {
-    ++sum;
-  }
-  
-  return sum;
+  /* Add the pseudo-header. */
+  acc += (chksum_acc_t)BUF->srcipaddr[0] + BUF->srcipaddr[1] +
+    BUF->destipaddr[0] + BUF->destipaddr[1] +
+    (u16_t)HTONS((u16_t)proto) + (u16_t)HTONS(len);
+
+  return chksum_fold(acc);
+}
+/*-----------------------------------------------------------------------------------*/
+u16_t
+uip_tcpchksum(void)
+{
+  return transport_chksum(IP_PROTO_TCP);
+}
+/*-----------------------------------------------------------------------------------*/
+u16_t
+uip_udpchksum(void)
+{
+  return transport_chksum(IP_PROTO_UDP);
 }
 /*-----------------------------------------------------------------------------------*/
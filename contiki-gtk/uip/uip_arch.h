@@ -46,5 +46,6 @@ void uip_add32(u8_t *op32, u16_t op16);
 u16_t uip_chksum(u16_t *data, u16_t len);
 u16_t uip_ipchksum(void);
 u16_t uip_tcpchksum(void);
+u16_t uip_udpchksum(void);
 
 #endif /* __UIP_ARCH_H__ */
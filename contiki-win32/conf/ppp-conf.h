@@ -70,4 +70,7 @@
 #define IPCP_GET_PRI_DNS		1	
 #define IPCP_GET_SEC_DNS		1
 
+/* uncomment next line to compress TCP/IP headers (RFC 1144) */
+/*#define IPCP_VJ			1*/
+
 #endif /* __PPP_CONF_H__ */
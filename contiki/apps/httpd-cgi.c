@@ -202,7 +202,7 @@ make_processes(void *s)
 static
 PT_THREAD(processes(struct httpd_state *s, char *ptr))
 {
-  static struct ek_proc *p;
+  static CC_THREAD_LOCAL struct ek_proc *p;
   
   PSOCK_BEGIN(&s->sout);
 
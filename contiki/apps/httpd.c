@@ -169,7 +169,7 @@ PT_THREAD(handle_script(struct httpd_state *s))
 static
 PT_THREAD(send_headers(struct httpd_state *s, const char *statushdr))
 {
-  static char *ptr;
+  static CC_THREAD_LOCAL char *ptr;
 
   PSOCK_BEGIN(&s->sout);
 
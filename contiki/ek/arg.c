@@ -64,6 +64,7 @@
  */
 
 #include "arg.h"
+#include "cc.h"
 
 /**
  * \internal Structure used for holding an argument buffer.
@@ -73,7 +74,7 @@ struct argbuf {
   char used;
 };
 
-static struct argbuf bufs[1];
+static CC_THREAD_LOCAL struct argbuf bufs[1];
 
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -72,7 +72,7 @@ struct ek_service {
  * \hideinitializer
  */
 #define EK_SERVICE(service, name) \
- static struct ek_service service = {name, EK_ID_NONE}
+ static CC_THREAD_LOCAL struct ek_service service = {name, EK_ID_NONE}
 
 /**
  * Start a service.
@@ -132,20 +132,20 @@
  * \internal Pointer to the currently running process structure.
  *
  */
-struct ek_proc *ek_procs = NULL;
-struct ek_proc *ek_proclist[EK_CONF_MAXPROCS];
-struct ek_proc *ek_current = NULL;
+CC_THREAD_LOCAL struct ek_proc *ek_procs = NULL;
+CC_THREAD_LOCAL struct ek_proc *ek_proclist[EK_CONF_MAXPROCS];
+CC_THREAD_LOCAL struct ek_proc *ek_current = NULL;
  
-ek_event_t ek_event_quit;
-ek_event_t ek_event_msg;
+CC_THREAD_LOCAL ek_event_t ek_event_quit;
+CC_THREAD_LOCAL ek_event_t ek_event_msg;
 
-static ek_event_t lastevent;
+static CC_THREAD_LOCAL ek_event_t lastevent;
 
 #if CC_FUNCTION_POINTER_ARGS
 
 #else /* CC_FUNCTION_POINTER_ARGS */
-ek_event_t ek_eventhandler_s;
-ek_data_t ek_eventhandler_data;
+CC_THREAD_LOCAL ek_event_t ek_eventhandler_s;
+CC_THREAD_LOCAL ek_data_t ek_eventhandler_data;
 #endif /* CC_FUNCTION_POINTER_ARGS */      
 
 
@@ -158,10 +158,10 @@ struct event_data {
   ek_id_t id;
 };
 
-static ek_num_events_t nevents, fevent;
-static struct event_data events[EK_CONF_NUMEVENTS];
+static CC_THREAD_LOCAL ek_num_events_t nevents, fevent;
+static CC_THREAD_LOCAL struct event_data events[EK_CONF_NUMEVENTS];
 
-volatile unsigned char ek_poll_request;
+CC_THREAD_LOCAL volatile unsigned char ek_poll_request;
 
 
 /*-----------------------------------------------------------------------------------*/
@@ -181,7 +181,7 @@ ek_alloc_event(void)
 static void
 procs_add(struct ek_proc *p)
 {
-  static struct ek_proc *q, *r;
+  static CC_THREAD_LOCAL struct ek_proc *q, *r;
   
   /* The process should be placed on the process list according to the
      process' priority. The higher the priority, the earlier on the
@@ -382,10 +382,10 @@ ek_init(void)
 void
 ek_process_event(void)
 { 
-  static ek_event_t s;
-  static ek_data_t data;
-  static ek_id_t id;
-  static struct ek_proc *p;
+  static CC_THREAD_LOCAL ek_event_t s;
+  static CC_THREAD_LOCAL ek_data_t data;
+  static CC_THREAD_LOCAL ek_id_t id;
+  static CC_THREAD_LOCAL struct ek_proc *p;
   
   /* If there are any events in the queue, take the first one and
      walk through the list of processes to see if the event should be
@@ -524,7 +524,7 @@ ek_run(void)
 ek_err_t
 ek_post(ek_id_t id, ek_event_t s, ek_data_t data)
 {
-  static unsigned char snum;
+  static CC_THREAD_LOCAL unsigned char snum;
   
   if(nevents == EK_CONF_NUMEVENTS) {
     return EK_ERR_FULL;
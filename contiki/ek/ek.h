@@ -185,7 +185,7 @@ typedef unsigned char ek_err_t;
  */
 #ifndef EK_PROCESS
 #define EK_PROCESS(name, strname, prio, eventh, pollh, stateptr)	\
-  static struct ek_proc name = {NULL, EK_ID_NONE, strname, prio, eventh, pollh, stateptr}
+  static CC_THREAD_LOCAL struct ek_proc name = {NULL, EK_ID_NONE, strname, prio, eventh, pollh, stateptr}
 #endif /* EK_PROCESS */
 
 struct ek_proc {
@@ -374,14 +374,14 @@ struct ek_proc *ek_process(ek_id_t id);
 #define EK_EVENTHANDLER_ARGS(s, data) ek_event_t s = ek_eventhandler_s; \
                                       ek_data_t data = ek_eventhandler_data
 
-extern ek_event_t ek_eventhandler_s;
-extern ek_data_t ek_eventhandler_data;
+extern CC_THREAD_LOCAL ek_event_t ek_eventhandler_s;
+extern CC_THREAD_LOCAL ek_data_t ek_eventhandler_data;
 
 #endif /* CC_FUNCTION_POINTER_ARGS */
 
-extern struct ek_proc *ek_current;
-extern struct ek_proc *ek_procs;
-extern struct ek_proc *ek_proclist[EK_CONF_MAXPROCS];
+extern CC_THREAD_LOCAL struct ek_proc *ek_current;
+extern CC_THREAD_LOCAL struct ek_proc *ek_procs;
+extern CC_THREAD_LOCAL struct ek_proc *ek_proclist[EK_CONF_MAXPROCS];
 
 void ek_process_event(void);
 void ek_process_poll(void);
@@ -420,7 +420,7 @@ void ek_replace(struct ek_proc *newp, void *arg);
 /*-----------------------------------------------------------------------------------*/
 void ek_post_synch(ek_id_t id, ek_event_t ev, ek_data_t data);
 
-extern volatile unsigned char ek_poll_request;
+extern CC_THREAD_LOCAL volatile unsigned char ek_poll_request;
 #define EK_REQUEST_POLL() ek_poll_request = 1
 
 #endif /* __EK_H__ */
@@ -95,6 +95,17 @@
 #define CC_DOUBLE_HASH 0
 #endif /* CC_CONF_DOUBLE_HASH */
 
+/**
+ * Configure the storage class for variables that should have one
+ * instance per thread, for hosted ports that run several Contiki
+ * instances as threads in one process (e.g. __thread with gcc).
+ */
+#ifdef CC_CONF_THREAD_LOCAL
+#define CC_THREAD_LOCAL CC_CONF_THREAD_LOCAL
+#else /* CC_CONF_THREAD_LOCAL */
+#define CC_THREAD_LOCAL
+#endif /* CC_CONF_THREAD_LOCAL */
+
 #ifndef NULL
 #define NULL 0
 #endif /* NULL */
@@ -96,6 +96,9 @@
 void
 memb_init(struct memb_blocks *m)
 {
+#ifdef CC_CONF_THREAD_LOCAL
+  m->mem = m->getmem();
+#endif /* CC_CONF_THREAD_LOCAL */
   memset(m->mem, 0, (m->size + 1) * m->num);
 }
 /*------------------------------------------------------------------------------*/
@@ -47,6 +47,8 @@
 #ifndef __MEMB_H__
 #define __MEMB_H__
 
+#include "cc.h"
+
 /**
  * Declare a memory block.
  *
@@ -68,7 +70,15 @@ MEMB(connections, sizeof(struct connection), 16);
  * \param num The total number of memory chunks in the block.
  *
  */
-#if CC_DOUBLE_HASH
+#ifdef CC_CONF_THREAD_LOCAL
+/* The address of a thread-local array is not a constant, so the
+   memory of a thread-local block is looked up by memb_init(). */
+#define MEMB(name, size, num) \
+        static CC_THREAD_LOCAL char name##_memb_mem[(size + 1) * num]; \
+        static char *name##_memb_getmem(void) {return name##_memb_mem;} \
+        static CC_THREAD_LOCAL struct memb_blocks name = \
+          {size, num, NULL, name##_memb_getmem}
+#elif CC_DOUBLE_HASH
 #define MEMB(name, size, num) \
         static char name##_memb_mem[(size + 1) * num]; \
         static struct memb_blocks name = {size, num, name##_memb_mem}
@@ -82,6 +92,9 @@ struct memb_blocks {
   unsigned short size;
   unsigned short num;
   char *mem;
+#ifdef CC_CONF_THREAD_LOCAL
+  char *(* getmem)(void);
+#endif /* CC_CONF_THREAD_LOCAL */
 };
 
 void  memb_init(struct memb_blocks *m);
@@ -82,6 +82,11 @@
  */
 #include "timer.h"
 
+#ifdef TIMER_CONF_NEXT
+static clock_time_t next;
+static unsigned char nextset;
+#endif /* TIMER_CONF_NEXT */
+
 /*---------------------------------------------------------------------------*/
 /**
  * Set a timer.
@@ -154,7 +159,67 @@ timer_restart(struct timer *t)
 int
 timer_expired(struct timer *t)
 {
+#ifdef TIMER_CONF_NEXT
+  clock_time_t deadline;
+  
+  if((clock_time_t)(clock_time() - t->start) >= (clock_time_t)t->interval) {
+    return 1;
+  }
+
+  /* The deadline is earlier than the next one if the difference
+     between them wraps around. */
+  deadline = t->start + t->interval;
+  if(!nextset ||
+     (clock_time_t)(next - deadline) < (clock_time_t)(deadline - next)) {
+    next = deadline;
+    nextset = 1;
+  }
+  return 0;
+#else /* TIMER_CONF_NEXT */
   return (clock_time_t)(clock_time() - t->start) >= (clock_time_t)t->interval;
+#endif /* TIMER_CONF_NEXT */
+}
+/*---------------------------------------------------------------------------*/
+#ifdef TIMER_CONF_NEXT
+/**
+ * Forget the deadlines that timer_expired() has seen.
+ *
+ * This function is called before the poll handlers are run, so that
+ * only the timers that are still being checked are taken into
+ * account by timer_next().
+ */
+void
+timer_next_clear(void)
+{
+  nextset = 0;
+}
+/*---------------------------------------------------------------------------*/
+/**
+ * Get the time until the earliest deadline.
+ *
+ * \param interval A pointer to where the time until the earliest
+ * deadline that timer_expired() has seen since timer_next_clear() is
+ * stored. The time is zero if the deadline has already passed.
+ *
+ * \return Non-zero if a deadline was seen, zero otherwise.
+ */
+int
+timer_next(clock_time_t *interval)
+{
+  clock_time_t now;
+
+  if(!nextset) {
+    return 0;
+  }
+  
+  now = clock_time();
+  if((clock_time_t)(next - now) < (clock_time_t)(now - next)) {
+    *interval = next - now;
+  } else {
+    *interval = 0;
+  }
+  return 1;
 }
 /*---------------------------------------------------------------------------*/
+#endif /* TIMER_CONF_NEXT */
 
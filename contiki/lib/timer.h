@@ -67,4 +67,15 @@ void timer_reset(struct timer *t);
 void timer_restart(struct timer *t);
 int timer_expired(struct timer *t);
 
+#ifdef TIMER_CONF_NEXT
+/*
+ * When TIMER_CONF_NEXT is set, timer_expired() remembers the earliest
+ * deadline of the timers that it finds not to have expired. A main
+ * loop that sleeps between the calls to ek_run() uses this to know
+ * when the poll handlers next have something to do.
+ */
+void timer_next_clear(void);
+int timer_next(clock_time_t *interval);
+#endif /* TIMER_CONF_NEXT */
+
 #endif /* __TIMER_H__ */
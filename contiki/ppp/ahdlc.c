@@ -57,7 +57,17 @@
 #include "uip.h"
 #include "ppp.h"
 
-#if 0
+#include <string.h>
+
+/* If AHDLC_CONF_DEBUG is set, a debug message is printed with
+   debug_printf() for every frame. */
+#ifdef AHDLC_CONF_DEBUG
+#define AHDLC_DEBUG AHDLC_CONF_DEBUG
+#else /* AHDLC_CONF_DEBUG */
+#define AHDLC_DEBUG 0
+#endif /* AHDLC_CONF_DEBUG */
+
+#if !AHDLC_DEBUG
 #define DEBUG1(x)
 #else
 #include <stdio.h>
@@ -78,6 +88,16 @@
 #define AHDLC_PFC		0x10
 #define AHDLC_ACFC		0x20
 
+/*---------------------------------------------------------------------------
+ * The number of bytes that are written to the serial device at a
+ * time. Must be at least 2.
+ ---------------------------------------------------------------------------*/
+#ifdef AHDLC_CONF_TXBUF
+#define TXBUF AHDLC_CONF_TXBUF
+#else /* AHDLC_CONF_TXBUF */
+#define TXBUF 32
+#endif /* AHDLC_CONF_TXBUF */
+
 /*---------------------------------------------------------------------------
  * Private Local Globals
  *	10 bytes	- standard
@@ -105,29 +125,87 @@ u16_t ahdlc_max_rx_buffer_size;
 u8_t ahdlc_rx_tobig_error;
 #endif
 
+/* The escaped frame that is being sent */
+static u8_t txbuf[TXBUF];
+static u16_t txlen;
+
 /*---------------------------------------------------------------------------*/
-/* Simple and fast CRC16 routine for embedded processors.
- *	Just slightly slower than the table lookup method but consumes
- *	almost no space.  Much faster and smaller than the loop and
- *	shift method that is widely used in the embedded space. 
- *	Can be optimized even more in .ASM
+/* Table driven CRC16 (the PPP FCS of RFC 1662, polynomial 0x8408).
+ *	The table holds the CRC of each byte value, so that the CRC is
+ *	updated with one lookup per byte instead of the shifts of the
+ *	formula below, which the table was computed with.
  *
  *	data = (crcvalue ^ inputchar) & 0xff;
  *	data = (data ^ (data << 4)) & 0xff;
  *	crc = (crc >> 8) ^ ((data << 8) ^ (data <<3) ^ (data >> 4))
  */
 /*---------------------------------------------------------------------------*/
-static u16_t
-crcadd(u16_t crcvalue, u8_t c)
-{
-  u16_t b;
+static const u16_t fcstab[256] = {
+  0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
+  0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
+  0x1081, 0x0108, 0x3393, 0x221a, 0x56a5, 0x472c, 0x75b7, 0x643e,
+  0x9cc9, 0x8d40, 0xbfdb, 0xae52, 0xdaed, 0xcb64, 0xf9ff, 0xe876,
+  0x2102, 0x308b, 0x0210, 0x1399, 0x6726, 0x76af, 0x4434, 0x55bd,
+  0xad4a, 0xbcc3, 0x8e58, 0x9fd1, 0xeb6e, 0xfae7, 0xc87c, 0xd9f5,
+  0x3183, 0x200a, 0x1291, 0x0318, 0x77a7, 0x662e, 0x54b5, 0x453c,
+  0xbdcb, 0xac42, 0x9ed9, 0x8f50, 0xfbef, 0xea66, 0xd8fd, 0xc974,
+  0x4204, 0x538d, 0x6116, 0x709f, 0x0420, 0x15a9, 0x2732, 0x36bb,
+  0xce4c, 0xdfc5, 0xed5e, 0xfcd7, 0x8868, 0x99e1, 0xab7a, 0xbaf3,
+  0x5285, 0x430c, 0x7197, 0x601e, 0x14a1, 0x0528, 0x37b3, 0x263a,
+  0xdecd, 0xcf44, 0xfddf, 0xec56, 0x98e9, 0x8960, 0xbbfb, 0xaa72,
+  0x6306, 0x728f, 0x4014, 0x519d, 0x2522, 0x34ab, 0x0630, 0x17b9,
+  0xef4e, 0xfec7, 0xcc5c, 0xddd5, 0xa96a, 0xb8e3, 0x8a78, 0x9bf1,
+  0x7387, 0x620e, 0x5095, 0x411c, 0x35a3, 0x242a, 0x16b1, 0x0738,
+  0xffcf, 0xee46, 0xdcdd, 0xcd54, 0xb9eb, 0xa862, 0x9af9, 0x8b70,
+  0x8408, 0x9581, 0xa71a, 0xb693, 0xc22c, 0xd3a5, 0xe13e, 0xf0b7,
+  0x0840, 0x19c9, 0x2b52, 0x3adb, 0x4e64, 0x5fed, 0x6d76, 0x7cff,
+  0x9489, 0x8500, 0xb79b, 0xa612, 0xd2ad, 0xc324, 0xf1bf, 0xe036,
+  0x18c1, 0x0948, 0x3bd3, 0x2a5a, 0x5ee5, 0x4f6c, 0x7df7, 0x6c7e,
+  0xa50a, 0xb483, 0x8618, 0x9791, 0xe32e, 0xf2a7, 0xc03c, 0xd1b5,
+  0x2942, 0x38cb, 0x0a50, 0x1bd9, 0x6f66, 0x7eef, 0x4c74, 0x5dfd,
+  0xb58b, 0xa402, 0x9699, 0x8710, 0xf3af, 0xe226, 0xd0bd, 0xc134,
+  0x39c3, 0x284a, 0x1ad1, 0x0b58, 0x7fe7, 0x6e6e, 0x5cf5, 0x4d7c,
+  0xc60c, 0xd785, 0xe51e, 0xf497, 0x8028, 0x91a1, 0xa33a, 0xb2b3,
+  0x4a44, 0x5bcd, 0x6956, 0x78df, 0x0c60, 0x1de9, 0x2f72, 0x3efb,
+  0xd68d, 0xc704, 0xf59f, 0xe416, 0x90a9, 0x8120, 0xb3bb, 0xa232,
+  0x5ac5, 0x4b4c, 0x79d7, 0x685e, 0x1ce1, 0x0d68, 0x3ff3, 0x2e7a,
+  0xe70e, 0xf687, 0xc41c, 0xd595, 0xa12a, 0xb0a3, 0x8238, 0x93b1,
+  0x6b46, 0x7acf, 0x4854, 0x59dd, 0x2d62, 0x3ceb, 0x0e70, 0x1ff9,
+  0xf78f, 0xe606, 0xd49d, 0xc514, 0xb1ab, 0xa022, 0x92b9, 0x8330,
+  0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78
+};
 
-  b = (crcvalue ^ c) & 0xFF;
-  b = (b ^ (b << 4) & 0xFF);
-  b = (b << 8) ^ (b << 3) ^ (b >> 4);
+#define CRCADD(crcvalue, c) \
+  (((crcvalue) >> 8) ^ fcstab[((crcvalue) ^ (c)) & 0xff])
   
-  return ((crcvalue >> 8) ^ b);
-}
+/*---------------------------------------------------------------------------*/
+/* Character classes for escaping.  ESC_FLAG bytes (0x7d and 0x7e) are
+ *	always escaped, ESC_CTL bytes (below 0x20) only when the async
+ *	map says so.  The receive and transmit loops look bytes up in
+ *	this table to find the runs of bytes that need no escaping.
+ */
+/*---------------------------------------------------------------------------*/
+#define ESC_FLAG		0x1
+#define ESC_CTL			0x2
+
+static const u8_t escape[256] = {
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
 /*---------------------------------------------------------------------------*/
 /* ahdlc_init(buffer, buffersize) - this initializes the ahdlc engine to
  *	allow for rx frames.
@@ -143,6 +221,7 @@ ahdlc_init(u8_t *buffer, u16_t maxrxbuffersize)
 #ifdef AHDLC_COUNTERS
   ahdlc_rx_tobig_error = 0;
 #endif
+  txlen = 0;
 }
 /*---------------------------------------------------------------------------*/
 /* ahdlc_rx_ready() - resets the ahdlc engine to the beginning of frame 
@@ -157,6 +236,57 @@ ahdlc_rx_ready(void)
   ahdlc_flags |= AHDLC_RX_READY;
 }
 /*---------------------------------------------------------------------------*/
+/* rx_frame() - handle the 0x7e that ends a frame.  A frame with a good
+ *	CRC is passed up, and the engine is reset for the next frame.
+ *
+ *	Returns 1 if a frame was passed up, 0 otherwise.
+ */
+/*---------------------------------------------------------------------------*/
+static u8_t
+rx_frame(void)
+{
+  if(ahdlc_rx_crc == CRC_GOOD_VALUE && ahdlc_rx_count > 3) {
+    DEBUG1(("\nReceiving packet with good crc value, len %d\n",ahdlc_rx_count));
+    /* we hae a good packet, turn off CTS until we are done with
+       this packet */
+    /*CTS_OFF();*/
+    /* remove CRC bytes from packet */
+    ahdlc_rx_count -= 2;
+
+    /* lock PPP buffer */
+    ahdlc_flags &= ~AHDLC_RX_READY;
+    /*
+     * upcall routine must fully process frame before return
+     *	as returning signifies that buffer belongs to AHDLC again.
+     *	A compressed protocol field is a single odd byte.
+     */
+    if((ahdlc_rx_buffer[0] & 0x1) && (ahdlc_flags & PPP_PFC)) {
+      /* Send up packet */
+      ppp_upcall((u16_t)ahdlc_rx_buffer[0],
+		 (u8_t *)&ahdlc_rx_buffer[1],
+		 (u16_t)(ahdlc_rx_count - 1));
+    } else {
+      /* Send up packet */
+      ppp_upcall((u16_t)(ahdlc_rx_buffer[0] << 8 | ahdlc_rx_buffer[1]),
+		 (u8_t *)&ahdlc_rx_buffer[2], (u16_t)(ahdlc_rx_count - 2));
+    }
+    ahdlc_rx_ready();
+    return 1;
+  } else if(ahdlc_rx_count > 3) {
+    DEBUG1(("\nReceiving packet with bad crc value, was 0x%04x len %d\n",ahdlc_rx_crc, ahdlc_rx_count));
+#ifdef AHDLC_COUNTERS
+    ++ahdlc_crc_error;
+#endif
+    ppp_rx_error();
+    /* Shouldn't we dump the packet and not pass it up? */
+    /*ppp_upcall((u16_t)ahdlc_rx_buffer[0],
+      (u8_t *)&ahdlc_rx_buffer[0], (u16_t)(ahdlc_rx_count+2));
+      dump_ppp_packet(&ahdlc_rx_buffer[0],ahdlc_rx_count);*/
+  }
+  ahdlc_rx_ready();
+  return 0;
+}
+/*---------------------------------------------------------------------------*/
 /* ahdlc receive function - This routine processes incoming bytes and tries
  *	to build a PPP frame.
  *
@@ -168,8 +298,6 @@ ahdlc_rx_ready(void)
 u8_t
 ahdlc_rx(u8_t c)   
 {    
-  static u16_t protocol;
-  
   /* check to see if PPP packet is useable, we should have hardware
      flow control set, but if host ignores it and sends us a char when
      the PPP Receive packet is in use, discard the character. +++ */
@@ -198,48 +326,11 @@ ahdlc_rx(u8_t c)
       c = c ^ 0x20;	
     } else if(c == 0x7e) {
       /* handle frame end */
-      if(ahdlc_rx_crc == CRC_GOOD_VALUE) {
-	DEBUG1(("\nReceiving packet with good crc value, len %d\n",ahdlc_rx_count));
-	/* we hae a good packet, turn off CTS until we are done with
-	   this packet */
-	/*CTS_OFF();*/
-	/* remove CRC bytes from packet */
-	ahdlc_rx_count -= 2;		
-	
-	/* lock PPP buffer */
-	ahdlc_flags &= ~AHDLC_RX_READY;
-	/*
-	 * upcall routine must fully process frame before return
-	 *	as returning signifies that buffer belongs to AHDLC again.
-	 */
-	if((c & 0x1) && (ahdlc_flags & PPP_PFC)) {
-	  /* Send up packet */
-	  ppp_upcall((u16_t)ahdlc_rx_buffer[0],
-		     (u8_t *)&ahdlc_rx_buffer[1],
-		     (u16_t)(ahdlc_rx_count - 1));
-	} else {
-	  /* Send up packet */
-	  ppp_upcall((u16_t)(ahdlc_rx_buffer[0] << 8 | ahdlc_rx_buffer[1]), 
-		     (u8_t *)&ahdlc_rx_buffer[2], (u16_t)(ahdlc_rx_count - 2));
-	}
-	ahdlc_rx_ready();
-	return 0;
-      } else if(ahdlc_rx_count > 3) {	
-	DEBUG1(("\nReceiving packet with bad crc value, was 0x%04x len %d\n",ahdlc_rx_crc, ahdlc_rx_count));
-#ifdef AHDLC_COUNTERS
-	++ahdlc_crc_error;
-#endif
-	/* Shouldn't we dump the packet and not pass it up? */
-	/*ppp_upcall((u16_t)ahdlc_rx_buffer[0],
-	  (u8_t *)&ahdlc_rx_buffer[0], (u16_t)(ahdlc_rx_count+2));
-	  dump_ppp_packet(&ahdlc_rx_buffer[0],ahdlc_rx_count);*/
-	
-      }
-      ahdlc_rx_ready();	
+      rx_frame();
       return 0;
     } else if(c == 0x7d) {
       /* handle escaped chars*/
-      ahdlc_flags |= PPP_ESCAPED;
+      ahdlc_flags |= AHDLC_ESCAPED;
       return 0;
     }
     
@@ -248,17 +339,18 @@ ahdlc_rx(u8_t c)
 #ifdef AHDLC_COUNTERS			
       ++ahdlc_rx_tobig_error;
 #endif
+      ppp_rx_error();
       ahdlc_rx_ready();
     } else {
       /* Add CRC in */
-      ahdlc_rx_crc = crcadd(ahdlc_rx_crc, c);
+      ahdlc_rx_crc = CRCADD(ahdlc_rx_crc, c);
       /* do auto ACFC, if packet len is zero discard 0xff and 0x03 */
       if(ahdlc_rx_count == 0) {
 	if((c == 0xff) || (c == 0x03))
 	  return 0;
       }
       /* Store char */
-      ppp_rx_buffer[ahdlc_rx_count++] = c;
+      ahdlc_rx_buffer[ahdlc_rx_count++] = c;
     }		
   } else {
     /* we are busy and didn't process the character. */
@@ -268,32 +360,164 @@ ahdlc_rx(u8_t c)
   return 0;
 }
 /*---------------------------------------------------------------------------*/
-/* ahdlc_tx_char(char) - write a character to the serial device, 
- * escape if necessary.
+/* ahdlc_rx_buf(buffer, len) - process a block of incoming bytes.
+ *
+ *	The runs of bytes that are neither flags, escapes nor discarded
+ *	control characters are added to the CRC and copied into the
+ *	frame in one go, the other bytes go through ahdlc_rx().
+ *	Processing stops after a frame has been passed up, so that the
+ *	caller can take care of the frame before the next one arrives,
+ *	and when the buffer is locked.
+ *
+ *	Returns the number of bytes processed; the caller should call
+ *	again with the rest.
+ */
+/*---------------------------------------------------------------------------*/
+u16_t
+ahdlc_rx_buf(u8_t *buffer, u16_t len)
+{
+  u8_t *ptr, *end, *run;
+  u16_t crc, n;
+  u8_t mask;
+
+  ptr = buffer;
+  end = buffer + len;
+  mask = ESC_FLAG;
+  if((ahdlc_flags & AHDLC_RX_ASYNC_MAP) == 0) {
+    mask |= ESC_CTL;
+  }
+
+  while(ptr < end && (ahdlc_flags & AHDLC_RX_READY)) {
+    /* The first bytes of a frame and escaped bytes need the checks
+       of ahdlc_rx(), the others are copied as a run. */
+    if(ahdlc_rx_count > 0 && (ahdlc_flags & AHDLC_ESCAPED) == 0) {
+      n = ahdlc_max_rx_buffer_size - ahdlc_rx_count;
+      if(n > end - ptr) {
+	n = end - ptr;
+      }
+      crc = ahdlc_rx_crc;
+      for(run = ptr; n > 0 && (escape[*ptr] & mask) == 0; ++ptr, --n) {
+	crc = CRCADD(crc, *ptr);
+      }
+      ahdlc_rx_crc = crc;
+      memcpy(&ahdlc_rx_buffer[ahdlc_rx_count], run, ptr - run);
+      ahdlc_rx_count += ptr - run;
+      if(ptr == end) {
+	break;
+      }
+    }
+
+    if(*ptr == 0x7e && (ahdlc_flags & AHDLC_ESCAPED) == 0) {
+      ++ptr;
+      if(rx_frame()) {
+	break;
+      }
+    } else {
+      ahdlc_rx(*ptr++);
+    }
+  }
+  return ptr - buffer;
+}
+/*---------------------------------------------------------------------------*/
+#if !AHDLC_CONF_BLOCK_IO
+/* Without a block interface to the serial device, the blocks are
+   moved through ppp_arch_putchar(). */
+static void
+ppp_arch_write(u8_t *buffer, u16_t len)
+{
+  while(len > 0) {
+    ppp_arch_putchar(*buffer++);
+    --len;
+  }
+}
+#endif /* !AHDLC_CONF_BLOCK_IO */
+/*---------------------------------------------------------------------------*/
+static void
+flush(void)
+{
+  if(txlen > 0) {
+    ppp_arch_write(txbuf, txlen);
+    txlen = 0;
+  }
+}
+/*---------------------------------------------------------------------------*/
+/* ahdlc_tx_buf(protocol, buffer, len) - write a block of frame bytes,
+ *	escaped as necessary.
+ *
+ * The runs of bytes that need no escaping are copied to the output
+ * buffer in one go.  The output buffer is written to the serial device
+ * when it is full and when ahdlc_tx() ends the frame.
  *
  * Relies on local global vars	:	ahdlc_tx_crc, ahdlc_flags.
  * Modifies local global vars	:	ahdlc_tx_crc.
  */
 /*---------------------------------------------------------------------------*/
 void
-ahdlc_tx_char(u16_t protocol, u8_t c)
+ahdlc_tx_buf(u16_t protocol, u8_t *buffer, u16_t len)
 {
-  /* add in crc */
-  ahdlc_tx_crc = crcadd(ahdlc_tx_crc, c);
+  u8_t *run;
+  u16_t crc, runlen, chunk;
+  u8_t mask;
+
   /*
-   * See if we need to escape char, we always escape 0x7d and 0x7e, in the case
-   * of char < 0x20 we only support async map of default or none, so escape if
-   * ASYNC map is not set.  We may want to modify this to support a bitmap set
-   * ASYNC map.
+   * We always escape 0x7d and 0x7e, in the case of char < 0x20 we
+   * only support async map of default or none, so escape if ASYNC map
+   * is not set.
    */
-  if((c == 0x7d) || (c == 0x7e) || 
-     ((c < 0x20) && ((protocol == LCP) ||
-		     (ahdlc_flags & PPP_TX_ASYNC_MAP) == 0))) {
-    /* send escape char and xor byte by 0x20 */
-    ppp_arch_putchar(0x7d);
-    c ^= 0x20;
+  mask = ESC_FLAG;
+  if((protocol == LCP) || (ahdlc_flags & PPP_TX_ASYNC_MAP) == 0) {
+    mask |= ESC_CTL;
+  }
+
+  crc = ahdlc_tx_crc;
+  while(len > 0) {
+    for(run = buffer; len > 0 && (escape[*buffer] & mask) == 0;
+	++buffer, --len) {
+      crc = CRCADD(crc, *buffer);
+    }
+
+    /* Copy the bytes that need no escaping. */
+    runlen = buffer - run;
+    while(runlen > 0) {
+      if(txlen == TXBUF) {
+	flush();
+      }
+      chunk = TXBUF - txlen;
+      if(chunk > runlen) {
+	chunk = runlen;
+      }
+      memcpy(&txbuf[txlen], run, chunk);
+      txlen += chunk;
+      run += chunk;
+      runlen -= chunk;
+    }
+
+    if(len > 0) {
+      /* send escape char and xor byte by 0x20 */
+      crc = CRCADD(crc, *buffer);
+      if(txlen + 2 > TXBUF) {
+	flush();
+      }
+      txbuf[txlen++] = 0x7d;
+      txbuf[txlen++] = *buffer ^ 0x20;
+      ++buffer;
+      --len;
+    }
   }
-  ppp_arch_putchar(c);
+  ahdlc_tx_crc = crc;
+}
+/*---------------------------------------------------------------------------*/
+/* ahdlc_tx_char(char) - write a character to the serial device, 
+ * escape if necessary.
+ *
+ * Relies on local global vars	:	ahdlc_tx_crc, ahdlc_flags.
+ * Modifies local global vars	:	ahdlc_tx_crc.
+ */
+/*---------------------------------------------------------------------------*/
+void
+ahdlc_tx_char(u16_t protocol, u8_t c)
+{
+  ahdlc_tx_buf(protocol, &c, 1);
 }
 /*---------------------------------------------------------------------------*/
 /* ahdlc_tx(protocol,buffer,len) - Transmit a PPP frame.
@@ -308,8 +532,8 @@ u8_t
 ahdlc_tx(u16_t protocol, u8_t *header, u8_t *buffer,
 	 u16_t headerlen, u16_t datalen)
 {
+  u8_t hdr[4];
   u16_t i;
-  u8_t c;
 
   DEBUG1(("\nAHDLC_TX - transmit frame, protocol 0x%04x, length %d\n",protocol,datalen+headerlen));
   
@@ -328,44 +552,42 @@ ahdlc_tx(u16_t protocol, u8_t *header, u8_t *buffer,
      cases */
   
   /* write leading 0x7e */
-  ppp_arch_putchar(0x7e);
+  flush();
+  txbuf[txlen++] = 0x7e;
 
   /* set initial CRC value */
   ahdlc_tx_crc = 0xffff;
   /* send HDLC control and address if not disabled or of LCP frame type */
   /*if((0==(ahdlc_flags & PPP_ACFC)) || ((0xc0==buffer[0]) && (0x21==buffer[1]))) */
+  i = 0;
   if((0 == (ahdlc_flags & PPP_ACFC)) || (protocol == LCP)) {
-    ahdlc_tx_char(protocol, 0xff);
-    ahdlc_tx_char(protocol, 0x03);
+    hdr[i++] = 0xff;
+    hdr[i++] = 0x03;
   }
   
   /* Write Protocol */
-  ahdlc_tx_char(protocol,(u8_t)(protocol >> 8));
-  ahdlc_tx_char(protocol,(u8_t)(protocol & 0xff));
+  hdr[i++] = (u8_t)(protocol >> 8);
+  hdr[i++] = (u8_t)(protocol & 0xff);
+  ahdlc_tx_buf(protocol, hdr, i);
 
   /* write header if it exists */
-  for(i = 0; i < headerlen; ++i) {
-    /* Get next byte from buffer */
-    c = header[i];
-    /* Write it...*/
-    ahdlc_tx_char(protocol, c);
-  }
+  ahdlc_tx_buf(protocol, header, headerlen);
 
   /* Write frame bytes */
-  for(i = 0; i < datalen; ++i) {    
-    /* Get next byte from buffer */
-    c = buffer[i];
-    /* Write it...*/
-    ahdlc_tx_char(protocol, c);
-  }
+  ahdlc_tx_buf(protocol, buffer, datalen);
 	
   /* send crc, lsb then msb */
   i = ahdlc_tx_crc ^ 0xffff;
-  ahdlc_tx_char(protocol, (u8_t)(i & 0xff));
-  ahdlc_tx_char(protocol, (u8_t)((i >> 8) & 0xff));
+  hdr[0] = (u8_t)(i & 0xff);
+  hdr[1] = (u8_t)((i >> 8) & 0xff);
+  ahdlc_tx_buf(protocol, hdr, 2);
 
   /* write trailing 0x7e, probably not needed but it doesn't hurt*/
-  ppp_arch_putchar(0x7e);
+  if(txlen == TXBUF) {
+    flush();
+  }
+  txbuf[txlen++] = 0x7e;
+  flush();
   return 0;
 }
 /*---------------------------------------------------------------------------*/
@@ -51,7 +51,33 @@
 void ahdlc_init(u8_t *, u16_t);
 void ahdlc_rx_ready(void);
 u8_t ahdlc_rx(u8_t);  
+u16_t ahdlc_rx_buf(u8_t *buffer, u16_t len);
 u8_t ahdlc_tx(u16_t protocol, u8_t *header, u8_t *buffer,
 	      u16_t headerlen, u16_t datalen);
+void ahdlc_tx_char(u16_t protocol, u8_t c);
+void ahdlc_tx_buf(u16_t protocol, u8_t *buffer, u16_t len);
+
+/*
+ * The frames are written to the serial device in blocks of up to
+ * AHDLC_CONF_TXBUF bytes.  If AHDLC_CONF_BLOCK_IO is set, the system
+ * implements ppp_arch_write() and ppp_arch_read(), and ppp_poll()
+ * reads the serial device in blocks of up to AHDLC_CONF_RXBUF bytes
+ * that it hands to ahdlc_rx_buf().  Otherwise, the blocks are moved
+ * one character at a time with ppp_arch_putchar() and
+ * ppp_arch_getchar().
+ */
+#if AHDLC_CONF_BLOCK_IO
+/*
+ * Write a block of bytes to the serial device, and do not return
+ * until all bytes have been written.
+ */
+void ppp_arch_write(u8_t *buffer, u16_t len);
+
+/*
+ * Read the available bytes from the serial device, up to len bytes,
+ * and return immediately with the number of bytes read.
+ */
+u16_t ppp_arch_read(u8_t *buffer, u16_t len);
+#endif /* AHDLC_CONF_BLOCK_IO */
 
 #endif /* __AHDLC_H__ */
@@ -90,9 +90,13 @@ uip_ipaddr_t	sec_dns_addr;
 u8_t ipcp_state;
 
 /*
- * in the future add copression protocol and name servers (possibly for servers only)
+ * in the future add name servers (possibly for servers only)
  */
+#ifdef IPCP_VJ
+u8_t ipcplist[] = {0x3, IPCP_COMPRESSION, 0};
+#else
 u8_t ipcplist[] = {0x3, 0};	
+#endif
 
 /*---------------------------------------------------------------------------*/
 /*void
@@ -109,6 +113,11 @@ ipcp_init(void)
   ipcp_state = 0;
   ppp_retry = 0;
   our_ipaddr.ip16[0] = our_ipaddr.ip16[1] = 0;
+#ifdef IPCP_VJ
+  /* Don't compress until the peer asks for it */
+  vjhc_init(&ppp_vjhc);
+  ppp_vjhc.tx_slots = 0;
+#endif
 }
 /*---------------------------------------------------------------------------*/
 /*
@@ -120,6 +129,9 @@ ipcp_rx(u8_t *buffer, u16_t count)
   u8_t *bptr = buffer;
   IPCPPKT *pkt=(IPCPPKT *)buffer;
   u16_t len;
+#ifdef IPCP_VJ
+  u8_t slots = 0, cid = 0, nak = 0;
+#endif
 
   DEBUG1(("IPCP len %d\n",count));
 	
@@ -143,24 +155,68 @@ ipcp_rx(u8_t *buffer, u16_t count)
       /* Reject any protocol not */
       /* Error? if we we need to send a config Reject ++++ this is
 	 good for a subroutine*/
-      /* All we should get is the peer IP address */
-      if(IPCP_IPADDRESS == *bptr++) {
-	/* dump length */
-	++bptr;
+      /* All we should get is the peer IP address, and the header
+	 compression the peer can receive */
+      while(bptr < buffer + len) {
+	/* An option that is shorter than its header, or that does not
+	   fit in the packet, ends the parsing. */
+	if(bptr + 2 > buffer + len || bptr[1] < 2 ||
+	   bptr + bptr[1] > buffer + len) {
+	  break;
+	}
+	switch(*bptr) {
+	case IPCP_IPADDRESS:
 #ifdef IPCP_GET_PEER_IP
-	peer_ip_addr.ip8[0] = *bptr++;
-	peer_ip_addr.ip8[1] = *bptr++;
-	peer_ip_addr.ip8[2] = *bptr++;
-	peer_ip_addr.ip8[3] = *bptr++;
-	DEBUG1(("Peer IP "));
-	/*	printip(peer_ip_addr);*/
-	DEBUG1(("\n"));
-#else
-	bptr += 4;
+	  if(bptr[1] < 6) {
+	    break;
+	  }
+	  peer_ip_addr.ip8[0] = bptr[2];
+	  peer_ip_addr.ip8[1] = bptr[3];
+	  peer_ip_addr.ip8[2] = bptr[4];
+	  peer_ip_addr.ip8[3] = bptr[5];
+	  DEBUG1(("Peer IP "));
+	  /*	printip(peer_ip_addr);*/
+	  DEBUG1(("\n"));
 #endif
-      } else {
-	DEBUG1(("HMMMM this shouldn't happen IPCP1\n"));
+	  break;
+#ifdef IPCP_VJ
+	case IPCP_COMPRESSION:
+	  /* Max-Slot-Id and Comp-Slot-Id follow the protocol. We use no
+	     more slots than we have. Anything but VJ is NAKed. */
+	  if(bptr[1] >= 6 && bptr[2] == (VJC_TCP >> 8) &&
+	     bptr[3] == (VJC_TCP & 0xff)) {
+	    slots = bptr[4] < VJHC_SLOTS? bptr[4] + 1: VJHC_SLOTS;
+	    cid = bptr[5];
+	  } else {
+	    nak = 1;
+	  }
+	  break;
+#endif
+	default:
+	  DEBUG1(("HMMMM this shouldn't happen IPCP1\n"));
+	}
+	bptr += bptr[1];
+      }
+
+#ifdef IPCP_VJ
+      if(nak) {
+	/* write a config NAK with the compression we can receive */
+	bptr = buffer;
+	*bptr++ = CONF_NAK;
+	bptr++;				/* Skip ID (send same one) */
+	*bptr++ = 0;
+	*bptr++ = 10;
+	*bptr++ = IPCP_COMPRESSION;
+	*bptr++ = 0x6;
+	*bptr++ = (u8_t)(VJC_TCP >> 8);
+	*bptr++ = (u8_t)(VJC_TCP & 0xff);
+	*bptr++ = VJHC_SLOTS - 1;
+	*bptr++ = 1;
+	DEBUG1(("Writing NAK frame \n"));
+	ahdlc_tx(IPCP, 0, buffer, 0, (u16_t)(bptr - buffer));
+	break;
       }
+#endif
       
 #if 0			
       if(error) {
@@ -195,6 +251,12 @@ ipcp_rx(u8_t *buffer, u16_t count)
        * Set stuff
        */
       /* ppp_flags |= tflag; */
+#ifdef IPCP_VJ
+      /* Compress what we send if the peer asked for it */
+      vjhc_init(&ppp_vjhc);
+      ppp_vjhc.tx_slots = slots;
+      ppp_vjhc.tx_cid = cid;
+#endif
       DEBUG1(("SET- stuff -- are we up? c=%d dif=%d \n", count, (u16_t)(bptr-buffer)));
 	
       /* write the ACK frame */
@@ -278,6 +340,12 @@ ipcp_rx(u8_t *buffer, u16_t count)
 
     /* Parse ACK and set data */
     while(bptr < buffer + len) {
+      /* An option that is shorter than its header, or that does not
+	 fit in the packet, ends the parsing. */
+      if(bptr + 2 > buffer + len || bptr[1] < 2 ||
+	 bptr + bptr[1] > buffer + len) {
+	break;
+      }
       switch(*bptr++) {
       case IPCP_IPADDRESS:
 	/* dump length */
@@ -304,9 +372,17 @@ ipcp_rx(u8_t *buffer, u16_t count)
 	sec_dns_addr.ip8[2] = *bptr++;
 	sec_dns_addr.ip8[3] = *bptr++;
 	break;
+#endif
+#ifdef IPCP_VJ
+      case IPCP_COMPRESSION:
+	/* The peer wants another compression, so we receive without */
+	ipcp_state |= IPCP_VJ_BIT;
+	bptr += *bptr - 1;
+	break;
 #endif
       default:
 	DEBUG1(("IPCP CONFIG_ACK problem 2\n"));
+	bptr += *bptr - 1;
       }
     }
     ppp_id++;
@@ -333,6 +409,12 @@ ipcp_rx(u8_t *buffer, u16_t count)
 
     /* Parse ACK and set data */
     while(bptr < buffer + len) {
+      /* An option that is shorter than its header, or that does not
+	 fit in the packet, ends the parsing. */
+      if(bptr + 2 > buffer + len || bptr[1] < 2 ||
+	 bptr + bptr[1] > buffer + len) {
+	break;
+      }
       switch(*bptr++) {
       case IPCP_IPADDRESS:
 	ipcp_state |= IPCP_IP_BIT;
@@ -349,9 +431,16 @@ ipcp_rx(u8_t *buffer, u16_t count)
 	ipcp_state |= IPCP_SEC_DNS_BIT;
 	bptr += 5;
 	break;
+#endif
+#ifdef IPCP_VJ
+      case IPCP_COMPRESSION:
+	ipcp_state |= IPCP_VJ_BIT;
+	bptr += *bptr - 1;
+	break;
 #endif
       default:
 	DEBUG1(("IPCP this shoudln't happen 3\n"));
+	bptr += *bptr - 1;
       }
     }
     /* expire the timer to make things happen after a state change */
@@ -420,6 +509,18 @@ ipcp_task(u8_t *buffer)
 	*bptr++ = sec_dns_addr.ip8[2];
 	*bptr++ = sec_dns_addr.ip8[3];
       }
+#endif
+#ifdef IPCP_VJ
+      if(!(ipcp_state & IPCP_VJ_BIT)) {
+	/* Ask the peer to compress, with as many slots as we have, and
+	   allow it to leave out the slot number */
+	*bptr++ = IPCP_COMPRESSION;
+	*bptr++ = 0x6;
+	*bptr++ = (u8_t)(VJC_TCP >> 8);
+	*bptr++ = (u8_t)(VJC_TCP & 0xff);
+	*bptr++ = VJHC_SLOTS - 1;
+	*bptr++ = 1;
+      }
 #endif
       /* Write length */
       t = bptr - buffer;
@@ -86,6 +86,20 @@
 u8_t ppp_rx_buffer[PPP_RX_BUFFER_SIZE];
 /*u8_t ppp_tx_buffer[PPP_TX_BUFFER_SIZE];*/
 
+#if AHDLC_CONF_BLOCK_IO
+/*
+ * Bytes read from the serial device, the ones after a frame are kept
+ *	until the next poll.
+ */
+#ifdef AHDLC_CONF_RXBUF
+#define RXBUF AHDLC_CONF_RXBUF
+#else /* AHDLC_CONF_RXBUF */
+#define RXBUF 32
+#endif /* AHDLC_CONF_RXBUF */
+static u8_t rxbuf[RXBUF];
+static u16_t rxpos, rxlen;
+#endif /* AHDLC_CONF_BLOCK_IO */
+
 /*
  * IP addr set by PPP server
  */
@@ -100,6 +114,10 @@ u8_t ppp_flags;
 u8_t ppp_id;
 u8_t ppp_retry;
 
+#ifdef IPCP_VJ
+struct vjhc ppp_vjhc;
+#endif
+
 #if PACKET_RX_DEBUG
 u16_t ppp_rx_frame_count=0;
 u16_t ppp_rx_tobig_error;
@@ -286,8 +304,22 @@ ppp_connect(void)
 void
 ppp_send(void)
 {
+#ifdef IPCP_VJ
+  u8_t hdr[UIP_TCPIP_HLEN];
+  u8_t hdrlen, type;
+#endif
+
   /* If IPCP came up then our link should be up. */
   if((ipcp_state & IPCP_TX_UP) && (ipcp_state & IPCP_RX_UP)) {
+#ifdef IPCP_VJ
+    /* send the compressed header in place of the TCP/IP header */
+    type = vjhc_compress(&ppp_vjhc, uip_buf, uip_len, hdr, &hdrlen);
+    if(type != VJHC_TYPE_IP) {
+      ahdlc_tx(type == VJHC_TYPE_COMPRESSED_TCP? VJC_TCP: VJUC_TCP,
+	       hdr, uip_appdata, hdrlen, uip_len - UIP_TCPIP_HLEN);
+      return;
+    }
+#endif
     ahdlc_tx(IPV4, uip_buf,        uip_appdata,
 		   UIP_TCPIP_HLEN, uip_len - UIP_TCPIP_HLEN);
   }
@@ -296,7 +328,11 @@ ppp_send(void)
 void
 ppp_poll(void)
 {
+#if AHDLC_CONF_BLOCK_IO
+  u16_t n;
+#else /* AHDLC_CONF_BLOCK_IO */
   u8_t c;
+#endif /* AHDLC_CONF_BLOCK_IO */
 
   uip_len = 0;
 
@@ -304,9 +340,26 @@ ppp_poll(void)
     return;
   }
 
+#if AHDLC_CONF_BLOCK_IO
+  while(uip_len == 0) {
+    if(rxpos == rxlen) {
+      rxpos = 0;
+      rxlen = ppp_arch_read(rxbuf, RXBUF);
+      if(rxlen == 0) {
+	break;
+      }
+    }
+    n = ahdlc_rx_buf(&rxbuf[rxpos], rxlen - rxpos);
+    if(n == 0) {
+      break;
+    }
+    rxpos += n;
+  }
+#else /* AHDLC_CONF_BLOCK_IO */
   while(uip_len == 0 && ppp_arch_getchar(&c)) {
     ahdlc_rx(c);
   }
+#endif /* AHDLC_CONF_BLOCK_IO */
 
   /* If IPCP came up then our link should be up. */
   if((ipcp_state & IPCP_TX_UP) && (ipcp_state & IPCP_RX_UP)) {
@@ -367,6 +420,17 @@ ppp_upcall(u16_t protocol, u8_t *buffer, u16_t len)
       uip_len = len;
       DEBUG1(("\n"));
       break;
+#ifdef IPCP_VJ
+    case VJC_TCP:	/* IPV4 with a compressed TCP/IP header */
+    case VJUC_TCP:
+      DEBUG1(("VJ Packet---\n"));
+      uip_len = vjhc_uncompress(&ppp_vjhc, protocol == VJC_TCP?
+				VJHC_TYPE_COMPRESSED_TCP:
+				VJHC_TYPE_UNCOMPRESSED_TCP,
+				buffer, len, uip_buf, UIP_BUFSIZE);
+      DEBUG1(("\n"));
+      break;
+#endif
     default:
       DEBUG1(("Unknown PPP Packet Type 0x%04x - ",protocol));
       ppp_reject_protocol(protocol, buffer, len);
@@ -376,6 +440,19 @@ ppp_upcall(u16_t protocol, u8_t *buffer, u16_t len)
   }
 }
 /*---------------------------------------------------------------------------*/
+/* ppp_rx_error() - called by the ahdlc layer when it drops a damaged
+ *	frame.
+ */
+/*---------------------------------------------------------------------------*/
+void
+ppp_rx_error(void)
+{
+#ifdef IPCP_VJ
+  /* the next compressed header may be relative to the lost packet */
+  vjhc_error(&ppp_vjhc);
+#endif
+}
+/*---------------------------------------------------------------------------*/
 /* scan_packet(list,buffer,len)
  *
  * list = list of supported ID's
@@ -77,6 +77,8 @@
 #define PAP			0xc023
 #define IPCP			0x8021
 #define	IPV4			0x0021
+#define VJC_TCP			0x002d
+#define VJUC_TCP		0x002f
 
 /* LCP codes packet types */
 #define CONF_REQ		0x1			
@@ -120,6 +122,12 @@ extern u8_t ppp_lcp_state;
 extern u8_t ppp_id;
 extern u8_t ppp_retry;
 
+#ifdef IPCP_VJ
+#include "vjhc.h"
+/* TCP/IP header compression state of the link, set up by IPCP */
+extern struct vjhc ppp_vjhc;
+#endif
+
 /*
  * Function Prototypes
  */
@@ -130,6 +138,7 @@ void ppp_send(void);
 void ppp_poll(void);
 
 void ppp_upcall(u16_t, u8_t *, u16_t);
+void ppp_rx_error(void);
 u16_t scan_packet(u16_t, u8_t *list, u8_t *buffer, u8_t *options, u16_t len);
 
 #endif /* __PPP_H__ */
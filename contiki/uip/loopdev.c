@@ -0,0 +1,239 @@
+/**
+ * \addtogroup uipfw
+ * @{
+ */
+
+/**
+ * \file
+ * Loopback network interface between two uIP stacks.
+ * \author Adam Dunkels <adam@sics.se>
+ */
+
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+
+#include "uip.h"
+#include "uip-fw.h"
+#include "tcpip.h"
+
+#include "loopdev.h"
+
+#include <string.h>
+
+#if UIP_CONTEXTS < 2
+#error "The loopback device requires UIP_CONF_CONTEXTS to be at least 2"
+#endif /* UIP_CONTEXTS < 2 */
+
+/* The number of packets that can be on each link at the same time. */
+#ifdef LOOPDEV_CONF_QUEUE
+#define QUEUE LOOPDEV_CONF_QUEUE
+#else /* LOOPDEV_CONF_QUEUE */
+#define QUEUE 32
+#endif /* LOOPDEV_CONF_QUEUE */
+
+struct packet {
+  clock_time_t arrival;
+  u16_t len;
+  u8_t buf[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+
+/* The link on which a stack sends its packets. The packets arrive in
+   the order they were sent, since they are all delayed equally and
+   the bandwidth makes each packet wait for the one before it. */
+struct link {
+  u8_t peer;
+  u8_t head, count;
+  clock_time_t free;
+  unsigned long rem;
+  struct packet queue[QUEUE];
+};
+
+static struct link links[UIP_CONTEXTS];
+
+struct loopdev_stats loopdev_stats[UIP_CONTEXTS];
+
+static clock_time_t delay;
+static unsigned long rate;
+static u8_t loss;
+
+static unsigned long seed;
+
+/*-----------------------------------------------------------------------------------*/
+void
+loopdev_init(void)
+{
+  u8_t i;
+
+  for(i = 0; i < UIP_CONTEXTS; ++i) {
+    links[i].peer = i;
+    links[i].head = links[i].count = 0;
+  }
+  memset(loopdev_stats, 0, sizeof(loopdev_stats));
+  delay = 0;
+  rate = 0;
+  loss = 0;
+  seed = 1;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+loopdev_connect(u8_t a, u8_t b)
+{
+  links[a].peer = b;
+  links[b].peer = a;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+loopdev_shape(clock_time_t d, unsigned long r, u8_t l)
+{
+  delay = d;
+  rate = r;
+  loss = l;
+}
+/*-----------------------------------------------------------------------------------*/
+/* A fixed pseudo-random sequence makes the losses the same on every
+   run. */
+static u8_t
+lost(void)
+{
+  seed = seed * 1103515245 + 12345;
+  return (seed >> 16) % 100 < loss;
+}
+/*-----------------------------------------------------------------------------------*/
+/**
+ * Send the packet in uip_buf to the peer of the current stack.
+ *
+ * This function is the output function of the loopback uip_fw_netif
+ * of every stack.
+ */
+u8_t
+loopdev_output(void)
+{
+  struct link *l;
+  struct packet *p;
+  clock_time_t now;
+  u16_t hdrlen;
+
+  l = &links[uip_getcontext()];
+  if(lost()) {
+    ++loopdev_stats[uip_getcontext()].lost;
+    return UIP_FW_DROPPED;
+  }
+  if(l->count == QUEUE) {
+    ++loopdev_stats[uip_getcontext()].dropped;
+    return UIP_FW_DROPPED;
+  }
+
+  p = &l->queue[(l->head + l->count) % QUEUE];
+  ++l->count;
+
+  hdrlen = UIP_TCPIP_HLEN;
+  if(uip_len < hdrlen) {
+    hdrlen = uip_len;
+  }
+  memcpy(p->buf, &uip_buf[UIP_LLH_LEN], hdrlen);
+  memcpy(&p->buf[hdrlen], uip_appdata, uip_len - hdrlen);
+  p->len = uip_len;
+
+  /* The packet is put on the link when the packet before it has been
+     sent, and takes the time given by the bandwidth to send. The
+     fractions of a clock tick are carried over to the next packet. */
+  now = clock_time();
+  if((long)(l->free - now) < 0) {
+    l->free = now;
+  }
+  if(rate > 0) {
+    l->rem += (unsigned long)uip_len * CLOCK_SECOND;
+    l->free += l->rem / rate;
+    l->rem %= rate;
+  }
+  p->arrival = l->free + delay;
+
+  return UIP_FW_OK;
+}
+/*-----------------------------------------------------------------------------------*/
+u8_t
+loopdev_poll(void)
+{
+  struct link *l;
+  struct packet *p;
+  u8_t i, n, context;
+
+  context = uip_getcontext();
+  n = 0;
+  for(i = 0; i < UIP_CONTEXTS; ++i) {
+    l = &links[i];
+    while(l->count > 0 &&
+	  (long)(l->queue[l->head].arrival - clock_time()) <= 0) {
+      p = &l->queue[l->head];
+      memcpy(&uip_buf[UIP_LLH_LEN], p->buf, p->len);
+      uip_len = p->len;
+      l->head = (l->head + 1) % QUEUE;
+      --l->count;
+
+      ++loopdev_stats[i].packets;
+      loopdev_stats[i].bytes += uip_len;
+      ++n;
+
+      uip_setcontext(l->peer);
+      tcpip_input();
+    }
+  }
+  uip_setcontext(context);
+  return n;
+}
+/*-----------------------------------------------------------------------------------*/
+u8_t
+loopdev_next(clock_time_t *interval)
+{
+  struct link *l;
+  clock_time_t now, left;
+  u8_t i, set;
+
+  now = clock_time();
+  set = 0;
+  for(i = 0; i < UIP_CONTEXTS; ++i) {
+    l = &links[i];
+    if(l->count > 0) {
+      left = l->queue[l->head].arrival - now;
+      if((long)left < 0) {
+	left = 0;
+      }
+      if(!set || left < *interval) {
+	*interval = left;
+	set = 1;
+      }
+    }
+  }
+  return set;
+}
+/*-----------------------------------------------------------------------------------*/
+/** @} */
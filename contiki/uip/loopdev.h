@@ -0,0 +1,136 @@
+/**
+ * \addtogroup uipfw
+ * @{
+ */
+
+/**
+ * \file
+ * Loopback network interface between two uIP stacks.
+ * \author Adam Dunkels <adam@sics.se>
+ */
+
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+#ifndef __LOOPDEV_H__
+#define __LOOPDEV_H__
+
+#include "uip.h"
+#include "clock.h"
+
+/*
+ * The loopback device connects the uIP stacks of a multi-stack build
+ * (UIP_CONTEXTS) in the same process. Every stack registers a
+ * uip_fw_netif with loopdev_output() as its output function, and the
+ * packets that a stack sends are delivered to its peer stack.
+ *
+ * The packets are queued and delivered by loopdev_poll(), once they
+ * have been on the link for the configured delay and the configured
+ * bandwidth allows. Packets can also be dropped at random. All times
+ * are measured with clock_time(), which may be a virtual clock that
+ * the main loop moves forward with loopdev_next().
+ *
+ * Example:
+ \code
+ static struct uip_fw_netif loopif[2] =
+   {{UIP_FW_NETIF(0,0,0,0, 0,0,0,0, loopdev_output)},
+    {UIP_FW_NETIF(0,0,0,0, 0,0,0,0, loopdev_output)}};
+
+ loopdev_connect(0, 1);
+ for(i = 0; i < 2; ++i) {
+   uip_setcontext(i);
+   uip_fw_default(&loopif[i]);
+ }
+ \endcode
+ */
+
+/**
+ * The counters of the packets that a stack has sent on its link.
+ */
+struct loopdev_stats {
+  unsigned long packets;  /**< The number of packets delivered. */
+  unsigned long bytes;    /**< The number of bytes delivered. */
+  unsigned long lost;     /**< The number of packets dropped at random. */
+  unsigned long dropped;  /**< The number of packets dropped because
+			     the queue was full. */
+};
+
+/**
+ * The counters of each stack, indexed by the number of the stack.
+ */
+extern struct loopdev_stats loopdev_stats[UIP_CONTEXTS];
+
+void loopdev_init(void);
+
+/**
+ * Connect two stacks to each other.
+ *
+ * \param a,b The numbers of the stacks.
+ */
+void loopdev_connect(u8_t a, u8_t b);
+
+/**
+ * Set the properties of all links.
+ *
+ * \param delay The time that a packet takes to cross a link.
+ *
+ * \param rate The bandwidth of a link, in bytes per second, or zero
+ * for unlimited bandwidth.
+ *
+ * \param loss The percentage of packets that are dropped.
+ */
+void loopdev_shape(clock_time_t delay, unsigned long rate, u8_t loss);
+
+u8_t loopdev_output(void);
+
+/**
+ * Deliver the packets that have arrived at their destination.
+ *
+ * The packets are handed to the receiving stack with tcpip_input().
+ * The function must not be called from within uIP.
+ *
+ * \return The number of packets that were delivered.
+ */
+u8_t loopdev_poll(void);
+
+/**
+ * Get the time until the next packet arrives.
+ *
+ * \param interval Filled in with the time until the packet arrives.
+ *
+ * \return Non-zero if a packet is on its way, zero if all links are
+ * idle.
+ */
+u8_t loopdev_next(clock_time_t *interval);
+
+#endif /* __LOOPDEV_H__ */
+
+/** @} */
@@ -17,6 +17,15 @@
  * resolved. It is up to the receiving process to determine if the
  * correct hostname has been found by calling the resolv_lookup()
  * function with the hostname.
+ *
+ * The resolved hostnames are kept in a cache of RESOLV_ENTRIES
+ * entries. A cache of more than eight entries is searched through a
+ * hash table, a smaller one entry by entry. An entry is kept for
+ * the time to live (TTL) of the DNS answer, but at least
+ * RESOLV_MIN_TTL and at most RESOLV_MAX_TTL seconds. A hostname that
+ * does not exist is remembered for RESOLV_NEG_TTL seconds, so that it
+ * is not asked for again and again. When a new hostname does not fit,
+ * the entry that was used the longest time ago is replaced.
  */
 
 /**
@@ -64,6 +73,7 @@
 #include "ek.h"
 #include "tcpip.h"
 #include "resolv.h"
+#include "clock.h"
 
 #include <string.h>
 
@@ -74,6 +84,30 @@
 /** \internal The maximum number of retries when asking for a name. */
 #define MAX_RETRIES 8
 
+/** \internal The shortest time, in seconds, that an answer is kept,
+    so that a process has the time to look it up even if the TTL is
+    zero. */
+#ifdef RESOLV_CONF_MIN_TTL
+#define RESOLV_MIN_TTL RESOLV_CONF_MIN_TTL
+#else /* RESOLV_CONF_MIN_TTL */
+#define RESOLV_MIN_TTL 30
+#endif /* RESOLV_CONF_MIN_TTL */
+
+/** \internal The longest time, in seconds, that an answer is kept. */
+#ifdef RESOLV_CONF_MAX_TTL
+#define RESOLV_MAX_TTL RESOLV_CONF_MAX_TTL
+#else /* RESOLV_CONF_MAX_TTL */
+#define RESOLV_MAX_TTL 86400UL
+#endif /* RESOLV_CONF_MAX_TTL */
+
+/** \internal The time, in seconds, that a hostname that does not
+    exist is remembered. */
+#ifdef RESOLV_CONF_NEG_TTL
+#define RESOLV_NEG_TTL RESOLV_CONF_NEG_TTL
+#else /* RESOLV_CONF_NEG_TTL */
+#define RESOLV_NEG_TTL 60
+#endif /* RESOLV_CONF_NEG_TTL */
+
 /** \internal The DNS message header. */
 struct dns_hdr {
   u16_t id;
@@ -106,6 +140,26 @@ struct dns_answer {
   u16_t ipaddr[2];
 };
 
+#ifndef UIP_CONF_RESOLV_ENTRIES
+#define RESOLV_ENTRIES 8
+#else /* UIP_CONF_RESOLV_ENTRIES */
+#define RESOLV_ENTRIES UIP_CONF_RESOLV_ENTRIES
+#endif /* UIP_CONF_RESOLV_ENTRIES */
+
+/* The number of hash chains, a power of two, or 0 if the entries
+   are searched one by one. Up to eight entries, comparing the name
+   with each entry is as fast as hashing it and needs no table, so
+   small caches are not hashed. */
+#ifdef RESOLV_CONF_HASH
+#define RESOLV_HASH RESOLV_CONF_HASH
+#elif RESOLV_ENTRIES <= 8
+#define RESOLV_HASH 0
+#elif RESOLV_ENTRIES <= 16
+#define RESOLV_HASH 16
+#else
+#define RESOLV_HASH 32
+#endif
+
 struct namemap {
 #define STATE_UNUSED 0
 #define STATE_NEW    1
@@ -115,22 +169,35 @@ struct namemap {
   u8_t state;
   u8_t tmr;
   u8_t retries;
-  u8_t seqno;
   u8_t err;
+#if RESOLV_HASH
+  u8_t next;          /* The next entry in the hash chain, plus one. */
+#endif /* RESOLV_HASH */
+  u16_t seqno;        /* When the entry was last used. */
+  unsigned long expires;
   char name[32];
   u16_t ipaddr[2];
 };
 
-#ifndef UIP_CONF_RESOLV_ENTRIES
-#define RESOLV_ENTRIES 4
-#else /* UIP_CONF_RESOLV_ENTRIES */
-#define RESOLV_ENTRIES UIP_CONF_RESOLV_ENTRIES
-#endif /* UIP_CONF_RESOLV_ENTRIES */
+static struct namemap names[RESOLV_ENTRIES];
 
+#if RESOLV_HASH
+/* The first entry of each hash chain, plus one. */
+static u8_t hash[RESOLV_HASH];
+#endif /* RESOLV_HASH */
 
-static struct namemap names[RESOLV_ENTRIES];
+static u16_t seqno;
 
-static u8_t seqno;
+/* The time in seconds, advanced from clock_time() by update_time(). */
+static unsigned long now;
+static clock_time_t lastclock;
+
+#if UIP_STATISTICS == 1
+static struct resolv_stats stats;
+#define RESOLV_STAT(s) s
+#else /* UIP_STATISTICS == 1 */
+#define RESOLV_STAT(s)
+#endif /* UIP_STATISTICS == 1 */
 
 static struct uip_udp_conn *resolv_conn = NULL;
 
@@ -147,6 +214,128 @@ enum {
   EVENT_NEW_SERVER=0
 };
 
+/*-----------------------------------------------------------------------------------*/
+/** \internal
+ * Advance the time in seconds by the seconds that have passed since
+ * the last call.
+ */
+/*-----------------------------------------------------------------------------------*/
+static void
+update_time(void)
+{
+  clock_time_t t;
+
+  t = clock_time() - lastclock;
+  if(t >= CLOCK_SECOND) {
+    t /= CLOCK_SECOND;
+    now += t;
+    lastclock += t * CLOCK_SECOND;
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/** \internal
+ * Check if the answer in an entry has timed out.
+ */
+/*-----------------------------------------------------------------------------------*/
+static u8_t
+expired(struct namemap *nameptr)
+{
+  return (long)(nameptr->expires - now) <= 0;
+}
+/*-----------------------------------------------------------------------------------*/
+#if RESOLV_HASH
+/** \internal
+ * Compute the hash chain of a hostname, from as much of the name as
+ * fits in an entry.
+ */
+/*-----------------------------------------------------------------------------------*/
+static u8_t
+hashname(char *name)
+{
+  u8_t h, n;
+
+  h = 0;
+  for(n = 0; n < sizeof(names[0].name) - 1 && name[n] != 0; ++n) {
+    h = (h << 3) + (h >> 5) + name[n];
+  }
+  return h & (RESOLV_HASH - 1);
+}
+#endif /* RESOLV_HASH */
+/*-----------------------------------------------------------------------------------*/
+/** \internal
+ * Find the entry of a hostname.
+ *
+ * \return The entry, or NULL if the hostname is not in the cache.
+ */
+/*-----------------------------------------------------------------------------------*/
+static struct namemap *
+find(char *name)
+{
+  u8_t i;
+  struct namemap *nameptr;
+
+#if RESOLV_HASH
+  for(i = hash[hashname(name)]; i != 0; i = nameptr->next) {
+    nameptr = &names[i - 1];
+    if(strncmp(name, nameptr->name, sizeof(nameptr->name) - 1) == 0) {
+      return nameptr;
+    }
+  }
+#else /* RESOLV_HASH */
+  for(i = 0; i < RESOLV_ENTRIES; ++i) {
+    nameptr = &names[i];
+    if(nameptr->state != STATE_UNUSED &&
+       strncmp(name, nameptr->name, sizeof(nameptr->name) - 1) == 0) {
+      return nameptr;
+    }
+  }
+#endif /* RESOLV_HASH */
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+#if RESOLV_HASH
+/** \internal
+ * Remove an entry from its hash chain.
+ */
+/*-----------------------------------------------------------------------------------*/
+static void
+unhash(struct namemap *nameptr)
+{
+  u8_t *ptr;
+
+  for(ptr = &hash[hashname(nameptr->name)]; *ptr != 0;
+      ptr = &names[*ptr - 1].next) {
+    if(&names[*ptr - 1] == nameptr) {
+      *ptr = nameptr->next;
+      return;
+    }
+  }
+}
+#endif /* RESOLV_HASH */
+/*-----------------------------------------------------------------------------------*/
+/** \internal
+ * Mark an entry as used, so that it is the last one to be replaced.
+ */
+/*-----------------------------------------------------------------------------------*/
+static void
+touch(struct namemap *nameptr)
+{
+  nameptr->seqno = seqno;
+  ++seqno;
+}
+/*-----------------------------------------------------------------------------------*/
+/** \internal
+ * Finish a lookup that did not give an address. The result is
+ * remembered for ttl seconds.
+ */
+/*-----------------------------------------------------------------------------------*/
+static void
+notfound(struct namemap *nameptr, u16_t ttl)
+{
+  nameptr->state = STATE_ERROR;
+  nameptr->expires = now + ttl;
+  resolv_found(nameptr->name, NULL);
+}
 /*-----------------------------------------------------------------------------------*/
 /** \internal
  * Walk through a compact encoded DNS name and return the end of it.
@@ -194,8 +383,7 @@ check_entries(void)
       if(namemapptr->state == STATE_ASKING) {
 	if(--namemapptr->tmr == 0) {
 	  if(++namemapptr->retries == MAX_RETRIES) {
-	    namemapptr->state = STATE_ERROR;
-	    resolv_found(namemapptr->name, NULL);
+	    notfound(namemapptr, 0);
 	    continue;
 	  }
 	  namemapptr->tmr = namemapptr->retries;	  
@@ -254,6 +442,7 @@ newdata(void)
   static u8_t nquestions, nanswers;
   static u8_t i;
   register struct namemap *namemapptr;
+  unsigned long ttl;
   
   hdr = (struct dns_hdr *)uip_appdata;
   /*  printf("ID %d\n", htons(hdr->id));
@@ -273,14 +462,17 @@ newdata(void)
   if(i < RESOLV_ENTRIES &&
      namemapptr->state == STATE_ASKING) {
 
+    update_time();
+
     /* This entry is now finished. */
     namemapptr->state = STATE_DONE;
     namemapptr->err = hdr->flags2 & DNS_FLAG2_ERR_MASK;
 
-    /* Check for error. If so, call callback to inform. */
+    /* Check for error. If so, call callback to inform. A name that
+       does not exist is remembered, other errors are not. */
     if(namemapptr->err != 0) {
-      namemapptr->state = STATE_ERROR;
-      resolv_found(namemapptr->name, NULL);
+      notfound(namemapptr, namemapptr->err == DNS_FLAG2_ERR_NAME?
+	    RESOLV_NEG_TTL: 0);
       return;
     }
 
@@ -325,6 +517,14 @@ newdata(void)
 	   we want. */
 	namemapptr->ipaddr[0] = ans->ipaddr[0];
 	namemapptr->ipaddr[1] = ans->ipaddr[1];
+
+	ttl = ((unsigned long)htons(ans->ttl[0]) << 16) | htons(ans->ttl[1]);
+	if(ttl < RESOLV_MIN_TTL) {
+	  ttl = RESOLV_MIN_TTL;
+	} else if(ttl > RESOLV_MAX_TTL) {
+	  ttl = RESOLV_MAX_TTL;
+	}
+	namemapptr->expires = now + ttl;
 	
 	resolv_found(namemapptr->name, namemapptr->ipaddr);
 	return;
@@ -333,6 +533,9 @@ newdata(void)
       }
       --nanswers;
     }
+
+    /* The name exists, but has no address. */
+    notfound(namemapptr, RESOLV_NEG_TTL);
   }
 
 }
@@ -354,6 +557,7 @@ EK_EVENTHANDLER(resolv_eventhandler, ev, data)
   } else if(ev == tcpip_event) {
     if(uip_udp_conn->rport == HTONS(53)) {
       if(uip_poll()) {
+	update_time();
 	check_entries();
       }
       if(uip_newdata()) {
@@ -366,6 +570,10 @@ EK_EVENTHANDLER(resolv_eventhandler, ev, data)
 /**
  * Queues a name so that a question for the name will be sent out.
  *
+ * If the name is already in the cache with an answer that has not
+ * timed out, no question is sent, and the resolv_event_found event is
+ * posted at once.
+ *
  * \param name The hostname that is to be queried.
  */
 /*-----------------------------------------------------------------------------------*/
@@ -373,31 +581,83 @@ void
 resolv_query(char *name)
 {
   static u8_t i;
-  static u8_t lseq, lseqi;
+  static u16_t lseq;
+  static u8_t lseqi;
   register struct namemap *nameptr;
-      
-  lseq = lseqi = 0;
-  
-  for(i = 0; i < RESOLV_ENTRIES; ++i) {
-    nameptr = &names[i];
-    if(nameptr->state == STATE_UNUSED) {
-      break;
+
+  update_time();
+
+  nameptr = find(name);
+  if(nameptr != NULL) {
+    touch(nameptr);
+    if(nameptr->state == STATE_NEW ||
+       nameptr->state == STATE_ASKING) {
+      /* The question has already been sent. */
+      return;
+    }
+    if(!expired(nameptr)) {
+      if(nameptr->state == STATE_ERROR) {
+	RESOLV_STAT(++stats.negative);
+	resolv_found(nameptr->name, NULL);
+      } else {
+	resolv_found(nameptr->name, nameptr->ipaddr);
+      }
+      return;
     }
-    if(seqno - nameptr->seqno > lseq) {
-      lseq = seqno - nameptr->seqno;
-      lseqi = i;
+    /* Ask again for the name that has timed out. */
+  } else {
+    /* Use an unused entry, or one that has timed out, or else the one
+       that was used the longest time ago. Entries that wait for an
+       answer are replaced only if all entries do. */
+    lseq = 0;
+    lseqi = RESOLV_ENTRIES;
+    for(i = 0; i < RESOLV_ENTRIES; ++i) {
+      nameptr = &names[i];
+      if(nameptr->state == STATE_UNUSED) {
+	break;
+      }
+      if(nameptr->state == STATE_NEW ||
+	 nameptr->state == STATE_ASKING) {
+	continue;
+      }
+      if(expired(nameptr)) {
+	break;
+      }
+      if((u16_t)(seqno - nameptr->seqno) >= lseq) {
+	lseq = seqno - nameptr->seqno;
+	lseqi = i;
+      }
     }
-  }
 
-  if(i == RESOLV_ENTRIES) {
-    i = lseqi;
-    nameptr = &names[i];
+    if(i == RESOLV_ENTRIES) {
+      if(lseqi == RESOLV_ENTRIES) {
+	for(i = 0; i < RESOLV_ENTRIES; ++i) {
+	  if((u16_t)(seqno - names[i].seqno) >= lseq) {
+	    lseq = seqno - names[i].seqno;
+	    lseqi = i;
+	  }
+	}
+      }
+      i = lseqi;
+      nameptr = &names[i];
+      RESOLV_STAT(++stats.replaced);
+    }
+
+#if RESOLV_HASH
+    if(nameptr->state != STATE_UNUSED) {
+      unhash(nameptr);
+    }
+#endif /* RESOLV_HASH */
+    strncpy(nameptr->name, name, sizeof(nameptr->name) - 1);
+    nameptr->name[sizeof(nameptr->name) - 1] = 0;
+#if RESOLV_HASH
+    nameptr->next = hash[hashname(nameptr->name)];
+    hash[hashname(nameptr->name)] = i + 1;
+#endif /* RESOLV_HASH */
+    touch(nameptr);
   }
 
-  strncpy(nameptr->name, name, sizeof(nameptr->name));
   nameptr->state = STATE_NEW;
-  nameptr->seqno = seqno;
-  ++seqno;
 
   if(resolv_conn != NULL) {
     tcpip_poll_udp(resolv_conn);
@@ -415,27 +675,40 @@ resolv_query(char *name)
  *
  * \return A pointer to a 4-byte representation of the hostname's IP
  * address, or NULL if the hostname was not found in the array of
- * hostnames.
+ * hostnames or its answer has timed out.
  */
 /*-----------------------------------------------------------------------------------*/
 u16_t *
 resolv_lookup(char *name)
 {
-  static u8_t i;
   struct namemap *nameptr;
-  
-  /* Walk through the list to see if the name is in there. If it is
-     not, we return NULL. */
-  for(i = 0; i < RESOLV_ENTRIES; ++i) {
-    nameptr = &names[i];
-    if(nameptr->state == STATE_DONE &&
-       strcmp(name, nameptr->name) == 0) {            
-      return nameptr->ipaddr;
-    }
+
+  update_time();
+
+  nameptr = find(name);
+  if(nameptr != NULL &&
+     nameptr->state == STATE_DONE &&
+     !expired(nameptr)) {
+    touch(nameptr);
+    RESOLV_STAT(++stats.hits);
+    return nameptr->ipaddr;
   }
+  RESOLV_STAT(++stats.misses);
   return NULL;
 }  
 /*-----------------------------------------------------------------------------------*/
+#if UIP_STATISTICS == 1
+/**
+ * Get the counters of the lookups in the cache of hostnames.
+ */
+/*-----------------------------------------------------------------------------------*/
+struct resolv_stats *
+resolv_stats(void)
+{
+  return &stats;
+}
+/*-----------------------------------------------------------------------------------*/
+#endif /* UIP_STATISTICS == 1 */
 /**
  * Obtain the currently configured DNS server.
  *
@@ -490,6 +763,12 @@ resolv_init(char *arg)
   for(i = 0; i < RESOLV_ENTRIES; ++i) {
     names[i].state = STATE_UNUSED;
   }
+#if RESOLV_HASH
+  for(i = 0; i < RESOLV_HASH; ++i) {
+    hash[i] = 0;
+  }
+#endif /* RESOLV_HASH */
+  lastclock = clock_time();
   resolv_conn = NULL;
   resolv_event_found = ek_alloc_event();    
 }
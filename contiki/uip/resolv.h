@@ -50,6 +50,21 @@ extern ek_event_t resolv_event_found;
 /* Callbacks. */
 void resolv_found(char *name, u16_t *ipaddr);
 
+/**
+ * The counters of the lookups in the cache of hostnames.
+ */
+struct resolv_stats {
+  uip_stats_t hits;           /**< Lookups that found an address. */
+  uip_stats_t misses;         /**< Lookups that found no address, or
+				 one that had timed out. */
+  uip_stats_t negative;       /**< Queries that were answered from the
+				 cache with a name that does not
+				 exist. */
+  uip_stats_t replaced;       /**< Entries that were replaced while
+				 still valid to make room for a new
+				 name. */
+};
+
 /* Functions. */
 void resolv_conf(u16_t *dnsserver);
 u16_t *resolv_getserver(void);
@@ -57,5 +72,8 @@ u16_t *resolv_getserver(void);
 void resolv_init(char *arg);
 u16_t *resolv_lookup(char *name);
 void resolv_query(char *name);
+#if UIP_STATISTICS == 1
+struct resolv_stats *resolv_stats(void);
+#endif /* UIP_STATISTICS == 1 */
 
 #endif /* __RESOLV_H__ */
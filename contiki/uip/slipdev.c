@@ -76,11 +76,133 @@
 #define SLIP_ESC_END 0334
 #define SLIP_ESC_ESC 0335
 
-static u8_t slip_buf[UIP_BUFSIZE];
+#if SLIPDEV_CONF_BLOCK_IO
+/* The number of bytes that are written to the serial device at a
+   time. */
+#ifdef SLIPDEV_CONF_TXBUF
+#define TXBUF SLIPDEV_CONF_TXBUF
+#else /* SLIPDEV_CONF_TXBUF */
+#define TXBUF 32
+#endif /* SLIPDEV_CONF_TXBUF */
 
+/* The number of bytes that are read from the serial device at a
+   time. */
+#ifdef SLIPDEV_CONF_RXBUF
+#define RXBUF SLIPDEV_CONF_RXBUF
+#else /* SLIPDEV_CONF_RXBUF */
+#define RXBUF 32
+#endif /* SLIPDEV_CONF_RXBUF */
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+
+/* The largest packet that fits in uip_buf. */
+#define MAXLEN (UIP_BUFSIZE - UIP_LLH_LEN)
+
+/* The second byte of the escape sequence of each byte that must be
+   escaped, and zero for all other bytes. The encoder and the decoder
+   look bytes up in this table to find the runs of bytes that need no
+   escaping, and copy the runs as blocks. */
+static const u8_t escape[256] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  SLIP_ESC_END, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, SLIP_ESC_ESC, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+static u8_t slip_buf[MAXLEN];
 static u16_t len, tmplen;
-static u8_t lastc;
+static u8_t esc, overflow;
+
+#if SLIPDEV_CONF_BLOCK_IO
+static u8_t txbuf[TXBUF];
+static u16_t txlen;
+
+static u8_t rxbuf[RXBUF];
+static u16_t rxpos, rxlen;
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+
+#if SLIPDEV_CONF_CSLIP
+/* The first byte of a CSLIP packet holds the type of the packet. */
+#define TYPE_UNCOMPRESSED_TCP 0x70
+#define TYPE_COMPRESSED_TCP   0x80
+
+struct vjhc slipdev_vjhc;
+#endif /* SLIPDEV_CONF_CSLIP */
+
+#if SLIPDEV_CONF_BLOCK_IO
+/*-----------------------------------------------------------------------------------*/
+static void
+flush(void)
+{
+  if(txlen > 0) {
+    slipdev_write(txbuf, txlen);
+    txlen = 0;
+  }
+}
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+/*-----------------------------------------------------------------------------------*/
+/* Put bytes in the output buffer. Without a block interface to the
+   serial device, the bytes are put on the device one at a time. */
+static void
+put(u8_t *ptr, u16_t n)
+{
+#if SLIPDEV_CONF_BLOCK_IO
+  u16_t chunk;
 
+  while(n > 0) {
+    if(txlen == TXBUF) {
+      flush();
+    }
+    chunk = TXBUF - txlen;
+    if(chunk > n) {
+      chunk = n;
+    }
+    memcpy(&txbuf[txlen], ptr, chunk);
+    txlen += chunk;
+    ptr += chunk;
+    n -= chunk;
+  }
+#else /* SLIPDEV_CONF_BLOCK_IO */
+  while(n > 0) {
+    slipdev_char_put(*ptr++);
+    --n;
+  }
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+}
+/*-----------------------------------------------------------------------------------*/
+/* Put a part of a packet, escaped, in the output buffer. */
+static void
+encode(u8_t *ptr, u16_t n)
+{
+  u8_t *run;
+  u8_t seq[2];
+
+  while(n > 0) {
+    for(run = ptr; n > 0 && escape[*ptr] == 0; ++ptr, --n);
+
+    /* Copy the bytes that need no escaping. */
+    put(run, ptr - run);
+
+    if(n > 0) {
+      seq[0] = SLIP_ESC;
+      seq[1] = escape[*ptr];
+      put(seq, 2);
+      ++ptr;
+      --n;
+    }
+  }
+}
 /*-----------------------------------------------------------------------------------*/
 /**
  * Send the packet in the uip_buf and uip_appdata buffers using the
@@ -96,45 +218,92 @@ static u8_t lastc;
 u8_t
 slipdev_send(void)
 {
-  u16_t i;
-  u8_t *ptr;
-  u8_t c;
+  u16_t hdrlen;
+#if SLIPDEV_CONF_CSLIP
+  u8_t hdr[UIP_TCPIP_HLEN];
+  u8_t vjlen, type;
+#endif /* SLIPDEV_CONF_CSLIP */
+  u8_t end;
 
-  slipdev_char_put(SLIP_END);
+  end = SLIP_END;
+  put(&end, 1);
 
-  ptr = &uip_buf[UIP_LLH_LEN];
-  for(i = 0; i < uip_len; ++i) {
-    if(i == UIP_TCPIP_HLEN) {
-      ptr = (char *)uip_appdata;
-    }
-    c = *ptr++;
-    switch(c) {
-    case SLIP_END:
-      slipdev_char_put(SLIP_ESC);
-      slipdev_char_put(SLIP_ESC_END);
-      break;
-    case SLIP_ESC:
-      slipdev_char_put(SLIP_ESC);
-      slipdev_char_put(SLIP_ESC_ESC);
-      break;
-    default:
-      slipdev_char_put(c);
-      break;
-    }
+  hdrlen = UIP_TCPIP_HLEN;
+  if(uip_len < hdrlen) {
+    hdrlen = uip_len;
+  }
+#if SLIPDEV_CONF_CSLIP
+  /* A compressed header takes the place of the 40 bytes of TCP/IP
+     header. */
+  type = vjhc_compress(&slipdev_vjhc, &uip_buf[UIP_LLH_LEN], uip_len,
+		       hdr, &vjlen);
+  if(type == VJHC_TYPE_IP) {
+    encode(&uip_buf[UIP_LLH_LEN], hdrlen);
+  } else {
+    hdr[0] |= type == VJHC_TYPE_COMPRESSED_TCP?
+      TYPE_COMPRESSED_TCP: TYPE_UNCOMPRESSED_TCP;
+    encode(hdr, vjlen);
   }
-  slipdev_char_put(SLIP_END);
+#else /* SLIPDEV_CONF_CSLIP */
+  encode(&uip_buf[UIP_LLH_LEN], hdrlen);
+#endif /* SLIPDEV_CONF_CSLIP */
+  encode((u8_t *)uip_appdata, uip_len - hdrlen);
+
+  put(&end, 1);
+#if SLIPDEV_CONF_BLOCK_IO
+  flush();
+#endif /* SLIPDEV_CONF_BLOCK_IO */
 
   return UIP_FW_OK;
 }
 /*-----------------------------------------------------------------------------------*/
+/* Add a part of a packet, unescaped, to the input buffer. A packet
+   that does not fit is dropped when its end marker arrives. */
+static void
+append(u8_t *ptr, u16_t n)
+{
+  if(overflow || len + n > MAXLEN) {
+    overflow = 1;
+    return;
+  }
+  memcpy(&slip_buf[len], ptr, n);
+  len += n;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Copy the packet in the input buffer to the uip_buf buffer, and
+   return its length or zero if it is dropped. */
+static u16_t
+input(u16_t n)
+{
+#if SLIPDEV_CONF_CSLIP
+  u8_t type;
+
+  if(slip_buf[0] & TYPE_COMPRESSED_TCP) {
+    type = VJHC_TYPE_COMPRESSED_TCP;
+  } else if((slip_buf[0] & 0xf0) == TYPE_UNCOMPRESSED_TCP) {
+    type = VJHC_TYPE_UNCOMPRESSED_TCP;
+    slip_buf[0] &= 0x4f;
+  } else {
+    type = VJHC_TYPE_IP;
+  }
+  return vjhc_uncompress(&slipdev_vjhc, type, slip_buf, n,
+			 &uip_buf[UIP_LLH_LEN], MAXLEN);
+#else /* SLIPDEV_CONF_CSLIP */
+  memcpy(&uip_buf[UIP_LLH_LEN], slip_buf, n);
+  return n;
+#endif /* SLIPDEV_CONF_CSLIP */
+}
+/*-----------------------------------------------------------------------------------*/
 /** 
  * Poll the SLIP device for an available packet.
  *
  * This function will poll the SLIP device to see if a packet is
- * available. It uses a buffer in which all avaliable bytes from the
- * RS232 interface are read into. When a full packet has been read
- * into the buffer, the packet is copied into the uip_buf buffer and
- * the length of the packet is returned.
+ * available. It reads the avaliable bytes from the serial device, in
+ * blocks if SLIPDEV_CONF_BLOCK_IO is set, and decodes them into a
+ * buffer. When a full packet has been
+ * read into the buffer, the packet is copied into the uip_buf buffer
+ * and the length of the packet is returned. The bytes that follow the
+ * packet are kept until the next call.
  *
  * \return The length of the packet placed in the uip_buf buffer, or
  * zero if no packet is available.
@@ -143,51 +312,85 @@ slipdev_send(void)
 u16_t
 slipdev_poll(void)
 {
+  u8_t *ptr, *end, *run;
   u8_t c;
-  
-  while(slipdev_char_poll(&c)) {
-    switch(c) {
-    case SLIP_ESC:
-      lastc = c;
-      break;
-      
-    case SLIP_END:
-      lastc = c;
-      /* End marker found, we copy our input buffer to the uip_buf
-	 buffer and return the size of the packet we copied. */
-      memcpy(&uip_buf[UIP_LLH_LEN], slip_buf, len);
-      tmplen = len;
-      len = 0;
-      return tmplen;
-      
-    default:     
-      if(lastc == SLIP_ESC) {
-	lastc = c;
-	/* Previous read byte was an escape byte, so this byte will be
-	   interpreted differently from others. */
-	switch(c) {
-	case SLIP_ESC_END:
+#if !SLIPDEV_CONF_BLOCK_IO
+  u8_t in;
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+
+  while(1) {
+#if SLIPDEV_CONF_BLOCK_IO
+    if(rxpos == rxlen) {
+      rxpos = 0;
+      rxlen = slipdev_read(rxbuf, RXBUF);
+      if(rxlen == 0) {
+	return 0;
+      }
+    }
+    ptr = &rxbuf[rxpos];
+    end = &rxbuf[rxlen];
+#else /* SLIPDEV_CONF_BLOCK_IO */
+    /* Without a block interface to the serial device, the bytes are
+       decoded one at a time. */
+    if(!slipdev_char_poll(&in)) {
+      return 0;
+    }
+    ptr = &in;
+    end = ptr + 1;
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+
+    while(ptr < end) {
+      c = *ptr;
+      if(esc && c != SLIP_END) {
+	/* The byte after an escape byte is interpreted differently
+	   from others. */
+	esc = 0;
+	++ptr;
+	if(c == SLIP_ESC_END) {
 	  c = SLIP_END;
-	  break;
-	case SLIP_ESC_ESC:
+	} else if(c == SLIP_ESC_ESC) {
 	  c = SLIP_ESC;
-	  break;
 	}
-      } else {
-	lastc = c;
+	append(&c, 1);
+	continue;
       }
-      
-      slip_buf[len] = c;
-      ++len;
-      
-      if(len > UIP_BUFSIZE) {
+
+      for(run = ptr; ptr < end && escape[*ptr] == 0; ++ptr);
+      append(run, ptr - run);
+      if(ptr == end) {
+	break;
+      }
+
+      if(*ptr++ == SLIP_ESC) {
+	esc = 1;
+      } else {
+	/* End marker found, we copy our input buffer to the uip_buf
+	   buffer and return the size of the packet we copied. Empty
+	   packets and packets that did not fit are skipped. */
+	esc = 0;
+	tmplen = overflow? 0: len;
+#if SLIPDEV_CONF_CSLIP
+	if(overflow) {
+	  vjhc_error(&slipdev_vjhc);
+	}
+#endif /* SLIPDEV_CONF_CSLIP */
 	len = 0;
+	overflow = 0;
+	if(tmplen > 0) {
+#if SLIPDEV_CONF_BLOCK_IO
+	  rxpos = ptr - rxbuf;
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+	  tmplen = input(tmplen);
+	  if(tmplen > 0) {
+	    return tmplen;
+	  }
+	}
       }
-    
-      break;
     }
+#if SLIPDEV_CONF_BLOCK_IO
+    rxpos = rxlen;
+#endif /* SLIPDEV_CONF_BLOCK_IO */
   }
-  return 0;
 }
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -200,7 +403,15 @@ slipdev_poll(void)
 void
 slipdev_init(void)
 {
-  lastc = len = 0;
+  len = 0;
+  esc = overflow = 0;
+#if SLIPDEV_CONF_BLOCK_IO
+  txlen = 0;
+  rxpos = rxlen = 0;
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+#if SLIPDEV_CONF_CSLIP
+  vjhc_init(&slipdev_vjhc);
+#endif /* SLIPDEV_CONF_CSLIP */
 }
 /*-----------------------------------------------------------------------------------*/
 
@@ -48,12 +48,57 @@
 
 #include "uip.h"
 
+/*
+ * If SLIPDEV_CONF_BLOCK_IO is set, the SLIP implementation moves the
+ * bytes to and from the serial device in blocks, and the system on
+ * which the SLIP implementation is to be run implements
+ * slipdev_write() and slipdev_read(). The sizes of the blocks are
+ * set with SLIPDEV_CONF_TXBUF and SLIPDEV_CONF_RXBUF. Otherwise, the
+ * system implements slipdev_char_put() and slipdev_char_poll(), and
+ * the bytes are moved one character at a time without any buffers.
+ */
+
+#if SLIPDEV_CONF_BLOCK_IO
+/**
+ * Write a block of bytes to the serial device.
+ *
+ * This function is used by the SLIP implementation to write to the
+ * serial device if SLIPDEV_CONF_BLOCK_IO is set. It must be
+ * implemented specifically for the system on which the SLIP
+ * implementation is to be run, and must not return until all bytes
+ * have been written.
+ *
+ * \param buf A pointer to the bytes.
+ *
+ * \param len The number of bytes.
+ */
+void slipdev_write(u8_t *buf, u16_t len);
+
+/**
+ * Read the available bytes from the serial device.
+ *
+ * This function is used by the SLIP implementation to read from the
+ * serial device if SLIPDEV_CONF_BLOCK_IO is set. It must be
+ * implemented specifically for the system on which the SLIP
+ * implementation is to be run, and should return immediately
+ * regardless if any bytes are available or not.
+ *
+ * \param buf A pointer to the buffer that the bytes are read into.
+ *
+ * \param len The size of the buffer.
+ *
+ * \return The number of bytes read.
+ */
+u16_t slipdev_read(u8_t *buf, u16_t len);
+#endif /* SLIPDEV_CONF_BLOCK_IO */
+
 /**
  * Put a character on the serial device.
  *
  * This function is used by the SLIP implementation to put a character
- * on the serial device. It must be implemented specifically for the
- * system on which the SLIP implementation is to be run.
+ * on the serial device if SLIPDEV_CONF_BLOCK_IO is not set. It must
+ * be implemented specifically for the system on which the SLIP
+ * implementation is to be run.
  *
  * \param c The character to be put on the serial device.
  */
@@ -63,8 +108,9 @@ void slipdev_char_put(u8_t c);
  * Poll the serial device for a character.
  *
  * This function is used by the SLIP implementation to poll the serial
- * device for a character. It must be implemented specifically for the
- * system on which the SLIP implementation is to be run.
+ * device for a character if SLIPDEV_CONF_BLOCK_IO is not set. It must
+ * be implemented specifically for the system on which the SLIP
+ * implementation is to be run.
  *
  * The function should return immediately regardless if a character is
  * available or not. If a character is available it should be placed
@@ -83,6 +129,21 @@ void slipdev_init(void);
 u8_t slipdev_send(void);
 u16_t slipdev_poll(void);
 
+/*
+ * If SLIPDEV_CONF_CSLIP is set, the SLIP implementation compresses
+ * the TCP/IP headers with Van Jacobson header compression (see
+ * vjhc.h), as CSLIP. The type of each packet is sent in its first
+ * byte. Both ends of the link must use CSLIP.
+ */
+#if SLIPDEV_CONF_CSLIP
+#include "vjhc.h"
+
+/**
+ * The header compression state of the SLIP link.
+ */
+extern struct vjhc slipdev_vjhc;
+#endif /* SLIPDEV_CONF_CSLIP */
+
 #endif /* __SLIPDEV_H__ */
 
 /** @} */
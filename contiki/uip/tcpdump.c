@@ -1,6 +1,7 @@
 
 #include "cc.h"
 #include "uip.h"
+#include "tcpdump.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -252,3 +253,215 @@ tcpdump_print(char *buf, u16_t buflen)
   }
 }
 /*---------------------------------------------------------------------------*/
+#if TCPDUMP_CAPTURE > 0
+
+#include "clock.h"
+
+/* The largest number of bytes of a packet that are kept. */
+#ifdef TCPDUMP_CONF_SNAPLEN
+#define SNAPLEN TCPDUMP_CONF_SNAPLEN
+#else /* TCPDUMP_CONF_SNAPLEN */
+#define SNAPLEN (UIP_BUFSIZE - UIP_LLH_LEN)
+#endif /* TCPDUMP_CONF_SNAPLEN */
+
+/* The pcap link type of packets that begin with the IP header. */
+#define LINKTYPE_RAW 101
+
+/* Only the stack writes head and only tcpdump_capture_flush() writes
+   tail. A record is filled in before head is moved past it, and is
+   written out before tail is moved past it. */
+#ifdef __GNUC__
+#define LOAD(x)     __atomic_load_n(&(x), __ATOMIC_ACQUIRE)
+#define STORE(x, v) __atomic_store_n(&(x), (v), __ATOMIC_RELEASE)
+#else /* __GNUC__ */
+#define LOAD(x)     (x)
+#define STORE(x, v) ((x) = (v))
+#endif /* __GNUC__ */
+
+struct record {
+  clock_time_t time;
+  u16_t len, caplen;
+  u8_t buf[SNAPLEN];
+};
+
+struct ring {
+  struct record records[TCPDUMP_CAPTURE];
+  unsigned int head, tail;
+  unsigned long drops;
+};
+
+#if UIP_CONTEXTS > 0
+#define RINGS UIP_CONTEXTS
+#define RING  (&rings[uip_context])
+#else /* UIP_CONTEXTS > 0 */
+#define RINGS 1
+#define RING  (&rings[0])
+#endif /* UIP_CONTEXTS > 0 */
+
+#define OLDEST(r) (&(r)->records[(r)->tail & (TCPDUMP_CAPTURE - 1)])
+
+static struct ring rings[RINGS];
+static struct tcpdump_filter filter;
+static u8_t header;
+
+volatile u8_t tcpdump_capturing;
+
+/*---------------------------------------------------------------------------*/
+void
+tcpdump_capture_start(struct tcpdump_filter *f)
+{
+  if(f != NULL) {
+    memcpy(&filter, f, sizeof(filter));
+  } else {
+    memset(&filter, 0, sizeof(filter));
+  }
+  header = 0;
+  tcpdump_capturing = 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tcpdump_capture_stop(void)
+{
+  tcpdump_capturing = 0;
+}
+/*---------------------------------------------------------------------------*/
+static u8_t
+match(u8_t dir, u8_t *hdr, u16_t hdrlen)
+{
+  uip_tcpip_hdr *ip;
+
+  ip = (uip_tcpip_hdr *)hdr;
+  if((filter.dir != 0 && (filter.dir & dir) == 0) ||
+     hdrlen < UIP_IPH_LEN) {
+    return 0;
+  }
+  if(filter.proto != 0 && ip->proto != filter.proto) {
+    return 0;
+  }
+  if(!uip_ipaddr_maskcmp(ip->srcipaddr, filter.ipaddr, filter.netmask) &&
+     !uip_ipaddr_maskcmp(ip->destipaddr, filter.ipaddr, filter.netmask)) {
+    return 0;
+  }
+  if(filter.port != 0) {
+    /* The TCP and UDP port numbers are at the same place in the
+       header, but only in the first fragment. */
+    if((ip->proto != UIP_PROTO_TCP && ip->proto != UIP_PROTO_UDP) ||
+       ip->vhl != 0x45 || hdrlen < UIP_IPH_LEN + 4 ||
+       (ip->ipoffset[0] & 0x1f) != 0 || ip->ipoffset[1] != 0) {
+      return 0;
+    }
+    if(ip->srcport != filter.port && ip->destport != filter.port) {
+      return 0;
+    }
+  }
+  return 1;
+}
+/*---------------------------------------------------------------------------*/
+void
+tcpdump_capture(u8_t dir, u8_t *hdr, u16_t hdrlen, u8_t *data, u16_t datalen)
+{
+  struct ring *r;
+  struct record *rec;
+
+  if(!match(dir, hdr, hdrlen)) {
+    return;
+  }
+
+  r = RING;
+  if(r->head - LOAD(r->tail) == TCPDUMP_CAPTURE) {
+    ++r->drops;
+    return;
+  }
+  rec = &r->records[r->head & (TCPDUMP_CAPTURE - 1)];
+  rec->time = clock_time();
+  rec->len = hdrlen + datalen;
+  if(hdrlen > SNAPLEN) {
+    hdrlen = SNAPLEN;
+  }
+  if(datalen > SNAPLEN - hdrlen) {
+    datalen = SNAPLEN - hdrlen;
+  }
+  memcpy(rec->buf, hdr, hdrlen);
+  if(datalen > 0) {
+    memcpy(&rec->buf[hdrlen], data, datalen);
+  }
+  rec->caplen = hdrlen + datalen;
+  STORE(r->head, r->head + 1);
+}
+/*---------------------------------------------------------------------------*/
+/* The pcap headers are written in little endian byte order, which the
+   magic number in the file header tells the readers. */
+static void
+put32(u8_t *ptr, unsigned long v)
+{
+  ptr[0] = v;
+  ptr[1] = v >> 8;
+  ptr[2] = v >> 16;
+  ptr[3] = v >> 24;
+}
+/*---------------------------------------------------------------------------*/
+int
+tcpdump_capture_flush(int (* write)(int fd, char *buf, unsigned int len),
+		      int fd)
+{
+  static u8_t buf[24];
+  struct ring *r, *oldest;
+  struct record *rec;
+  u8_t i;
+  int n;
+
+  if(!header) {
+    put32(&buf[0], 0xa1b2c3d4);
+    put32(&buf[4], 2 | (4L << 16));      /* Version 2.4. */
+    put32(&buf[8], 0);                   /* Time zone. */
+    put32(&buf[12], 0);                  /* Timestamp accuracy. */
+    put32(&buf[16], SNAPLEN);
+    put32(&buf[20], LINKTYPE_RAW);
+    if(write(fd, (char *)buf, 24) != 24) {
+      return -1;
+    }
+    header = 1;
+  }
+
+  for(n = 0;; ++n) {
+    /* Write the oldest packet of all rings. */
+    oldest = NULL;
+    for(i = 0; i < RINGS; ++i) {
+      r = &rings[i];
+      if(r->tail != LOAD(r->head) &&
+	 (oldest == NULL ||
+	  (long)(OLDEST(r)->time - OLDEST(oldest)->time) < 0)) {
+	oldest = r;
+      }
+    }
+    if(oldest == NULL) {
+      return n;
+    }
+
+    rec = OLDEST(oldest);
+    put32(&buf[0], rec->time / CLOCK_SECOND);
+    put32(&buf[4], (rec->time % CLOCK_SECOND) * (1000000L / CLOCK_SECOND));
+    put32(&buf[8], rec->caplen);
+    put32(&buf[12], rec->len);
+    if(write(fd, (char *)buf, 16) != 16 ||
+       write(fd, (char *)rec->buf, rec->caplen) != rec->caplen) {
+      return -1;
+    }
+    STORE(oldest->tail, oldest->tail + 1);
+  }
+}
+/*---------------------------------------------------------------------------*/
+unsigned long
+tcpdump_capture_drops(void)
+{
+  unsigned long drops;
+  u8_t i;
+
+  drops = 0;
+  for(i = 0; i < RINGS; ++i) {
+    drops += rings[i].drops;
+  }
+  return drops;
+}
+/*---------------------------------------------------------------------------*/
+#endif /* TCPDUMP_CAPTURE > 0 */
@@ -5,4 +5,123 @@
 
 int tcpdump_print(char *buf, u16_t buflen);
 
+/*
+ * Packet capture.
+ *
+ * If TCPDUMP_CONF_CAPTURE is set, the packets that tcpip_input() and
+ * tcpip_output() see are copied into a ring of TCPDUMP_CONF_CAPTURE
+ * records (a power of two) while a capture is running, and
+ * tcpdump_capture_flush() writes them out in the pcap file format
+ * with the raw IP link type. Each stack of a multi-stack build
+ * (UIP_CONTEXTS) has a ring of its own, so the stacks can add packets
+ * from different threads while another thread writes them out. A
+ * ring that is full drops the new packets.
+ *
+ * Only the first TCPDUMP_CONF_SNAPLEN bytes of each packet are kept,
+ * which is the whole packet by default. Setting it to UIP_TCPIP_HLEN
+ * captures only the headers.
+ *
+ * If TCPDUMP_CONF_CAPTURE is not set, the capture hooks in tcpip.c
+ * are compiled away, and when no capture is running they cost one
+ * test of a variable.
+ *
+ * Example:
+ \code
+ static struct tcpdump_filter f;
+
+ f.proto = UIP_PROTO_TCP;
+ f.port = HTONS(80);
+ tcpdump_capture_start(&f);
+ ...
+ tcpdump_capture_flush(cfs_find_service()->write, fd);
+ \endcode
+ */
+#ifdef TCPDUMP_CONF_CAPTURE
+#define TCPDUMP_CAPTURE TCPDUMP_CONF_CAPTURE
+#else /* TCPDUMP_CONF_CAPTURE */
+#define TCPDUMP_CAPTURE 0
+#endif /* TCPDUMP_CONF_CAPTURE */
+
+#define TCPDUMP_IN  1
+#define TCPDUMP_OUT 2
+
+/**
+ * The packets that are captured.
+ *
+ * A field that is zero matches all packets.
+ */
+struct tcpdump_filter {
+  u8_t dir;          /**< TCPDUMP_IN, TCPDUMP_OUT or both. */
+  u8_t proto;        /**< The IP protocol number. */
+  u16_t ipaddr[2];   /**< The source or destination address, compared
+			under netmask. */
+  u16_t netmask[2];  /**< The netmask; zero matches all addresses. */
+  u16_t port;        /**< The TCP or UDP source or destination port, in
+			network byte order. */
+};
+
+#if TCPDUMP_CAPTURE > 0
+extern volatile u8_t tcpdump_capturing;
+
+/**
+ * Start capturing packets.
+ *
+ * The next call to tcpdump_capture_flush() writes the pcap file
+ * header, so that a new file can be started.
+ *
+ * \param filter The packets to capture, or NULL for all packets. The
+ * filter is copied.
+ */
+void tcpdump_capture_start(struct tcpdump_filter *filter);
+
+/**
+ * Stop capturing packets.
+ *
+ * The packets that have already been captured can still be written
+ * out with tcpdump_capture_flush().
+ */
+void tcpdump_capture_stop(void);
+
+/**
+ * Write out the captured packets.
+ *
+ * The packets of all stacks are written in the order they were
+ * captured in, and are then removed from the rings.
+ *
+ * \param write The function that writes to the file, such as the
+ * write function of the CFS service.
+ *
+ * \param fd The file descriptor that is given to the write function.
+ *
+ * \return The number of packets written, or -1 if the write function
+ * did not write all data.
+ */
+int tcpdump_capture_flush(int (* write)(int fd, char *buf, unsigned int len),
+			  int fd);
+
+/**
+ * Get the number of packets that were dropped because a ring was
+ * full.
+ */
+unsigned long tcpdump_capture_drops(void);
+
+void tcpdump_capture(u8_t dir, u8_t *hdr, u16_t hdrlen,
+		     u8_t *data, u16_t datalen);
+
+/**
+ * Capture the packet that is given in two parts, as to the output
+ * function of a packet service.
+ *
+ * \hideinitializer
+ */
+#define TCPDUMP_CAPTURE_PACKET(dir, hdr, hdrlen, data, datalen)	\
+  do {								\
+    if(tcpdump_capturing) {					\
+      tcpdump_capture(dir, hdr, hdrlen, data, datalen);		\
+    }								\
+  } while(0)
+#else /* TCPDUMP_CAPTURE > 0 */
+#define TCPDUMP_CAPTURE_PACKET(dir, hdr, hdrlen, data, datalen)
+#endif /* TCPDUMP_CAPTURE > 0 */
+
 #endif /* __TCPDUMP_H__ */
@@ -47,9 +47,11 @@
 
 #include "uip-split.h"
 
+#include "tcpdump.h"
+
 #include <string.h>
 
-ek_event_t tcpip_event;
+CC_THREAD_LOCAL ek_event_t tcpip_event;
 
 EK_SERVICE(packetservice, PACKET_SERVICE_NAME);
 
@@ -63,20 +65,89 @@ struct listenport {
 
 /*static struct tcpip_event_args ev_args;*/
 
-static struct timer periodic;
+static CC_THREAD_LOCAL struct timer periodic;
 
-static struct internal_state {
+static CC_THREAD_LOCAL struct internal_state {
+#if UIP_CONTEXTS == 0
   struct listenport listenports[UIP_LISTENPORTS];
+#endif /* UIP_CONTEXTS == 0 */
   ek_event_t event;
   ek_id_t id;
 } s;
 
+#if UIP_CONTEXTS > 0
+/* The listening ports of all stacks do not fit in the state that is
+   handed over when the process is replaced, so they are kept
+   outside of it. */
+static struct listenport UIP_CONTEXT_DECL(listenports)[UIP_LISTENPORTS];
+#define LISTENPORTS UIP_CONTEXT_REF(listenports)
+#else /* UIP_CONTEXTS > 0 */
+#define LISTENPORTS s.listenports
+#endif /* UIP_CONTEXTS > 0 */
+
 enum {
   TCP_POLL,
   UDP_POLL
 };
 
-static unsigned char forwarding = 0;
+static unsigned char UIP_CONTEXT_DECL(forwarding);
+
+#if UIP_INPUT_RING > 0
+/**
+ * \internal Structure for holding a frame in the input ring.
+ */
+struct ringbuf {
+  u16_t len;
+  u8_t buf[UIP_BUFSIZE];
+};
+
+static struct ringbuf UIP_CONTEXT_DECL(ring)[UIP_INPUT_RING];
+static unsigned char UIP_CONTEXT_DECL(ring_head),
+  UIP_CONTEXT_DECL(ring_tail), UIP_CONTEXT_DECL(ring_count);
+#endif /* UIP_INPUT_RING > 0 */
+
+#if UIP_CONTEXTS > 0
+/* Make the state of each stack refer to the current stack. */
+#define forwarding  UIP_CONTEXT_REF(forwarding)
+#define ring        UIP_CONTEXT_REF(ring)
+#define ring_head   UIP_CONTEXT_REF(ring_head)
+#define ring_tail   UIP_CONTEXT_REF(ring_tail)
+#define ring_count  UIP_CONTEXT_REF(ring_count)
+
+#if UIP_CONTEXT_THREADS
+/* Each thread only handles its own stack, and all its connections
+   belong to that stack. */
+#define CONTEXTS_BEGIN()
+#define CONTEXTS_END()
+#define CONTEXT_OF_CONN(c)
+#define CONTEXT_OF_UDP_CONN(c)
+#define CONTEXT_RESTORE()
+#else /* UIP_CONTEXT_THREADS */
+static u8_t saved_context;
+
+/* Run the code between CONTEXTS_BEGIN() and CONTEXTS_END() once for
+   every stack, with the stack selected. */
+#define CONTEXTS_BEGIN() saved_context = uip_context;			\
+  for(uip_context = 0; uip_context < UIP_CONTEXTS; ++uip_context) {
+#define CONTEXTS_END()   } uip_context = saved_context
+
+/* Select the stack that owns a connection, until CONTEXT_RESTORE()
+   goes back to the previous stack. */
+#define CONTEXT_OF_CONN(c) saved_context = uip_context;			\
+  uip_context = ((struct uip_conn *)(c) - uip_conns_contexts[0]) /	\
+                UIP_CONNS
+#define CONTEXT_OF_UDP_CONN(c) saved_context = uip_context;		\
+  uip_context = ((struct uip_udp_conn *)(c) - uip_udp_conns_contexts[0]) / \
+                UIP_UDP_CONNS
+#define CONTEXT_RESTORE()  uip_context = saved_context
+#endif /* UIP_CONTEXT_THREADS */
+#else /* UIP_CONTEXTS > 0 */
+#define CONTEXTS_BEGIN()
+#define CONTEXTS_END()
+#define CONTEXT_OF_CONN(c)
+#define CONTEXT_OF_UDP_CONN(c)
+#define CONTEXT_RESTORE()
+#endif /* UIP_CONTEXTS > 0 */
 
 EK_EVENTHANDLER(eventhandler, ev, data);
 EK_POLLHANDLER(pollhandler);
@@ -85,9 +156,11 @@ EK_PROCESS(proc, "TCP/IP stack", EK_PRIO_NORMAL,
 /*---------------------------------------------------------------------------*/
 EK_PROCESS_INIT(tcpip_init, arg)
 {
+  CONTEXTS_BEGIN();
   uip_init();
-  ek_start(&proc);
   forwarding = 0;
+  CONTEXTS_END();
+  ek_start(&proc);
 }
 /*---------------------------------------------------------------------------*/
 void
@@ -96,10 +169,34 @@ tcpip_set_forwarding(unsigned char f)
   forwarding = f;
 }
 /*---------------------------------------------------------------------------*/
-void
-tcpip_input(void)
+#if UIP_TCP_WINDOW_SEGS > 1
+/* Keep polling the application of a connection for as long as it
+   puts new segments into the send window. */
+static void
+fill_window(struct uip_conn *conn)
+{
+  while(conn != NULL && uip_window_fill(conn)) {
+    uip_poll_conn(conn);
+    if(uip_len == 0) {
+      break;
+    }
+#if UIP_CONF_TCP_SPLIT
+    uip_split_output();
+#else
+    tcpip_output();
+#endif
+  }
+}
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
+#define fill_window(conn)
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+/*---------------------------------------------------------------------------*/
+static void
+input(void)
 {
   if(uip_len > 0) {
+    TCPDUMP_CAPTURE_PACKET(TCPDUMP_IN, &uip_buf[UIP_LLH_LEN], uip_len,
+			   NULL, 0);
     if(forwarding) {
       if(uip_fw_forward() == 0) {
 	uip_input();
@@ -110,6 +207,7 @@ tcpip_input(void)
 	  tcpip_output();
 #endif
 	}
+	fill_window(uip_conn);
       }
     } else {
       uip_input();
@@ -120,10 +218,77 @@ tcpip_input(void)
 	tcpip_output();
 #endif
       }
+      fill_window(uip_conn);
     }
   }
 }
 /*---------------------------------------------------------------------------*/
+#if UIP_INPUT_RING > 0
+/* Move up to UIP_INPUT_BURST frames from the input ring through the
+   stack, one at a time through uip_buf.
+
+   Each frame is copied from its slot into uip_buf, since uip_buf is
+   a fixed array that the stack, the drivers and the assembly code of
+   some ports address directly, and cannot be swapped with the slot.
+   The copy is one pass over the link level header and the packet,
+   which costs about as much as the checksum that uip_process()
+   computes over each TCP segment. Only the length of the frame is
+   copied, not the whole slot. */
+static void
+input_burst(void)
+{
+  static CC_THREAD_LOCAL unsigned char n;
+  register struct ringbuf *r;
+
+  for(n = 0; n < UIP_INPUT_BURST && ring_count > 0; ++n) {
+    r = &ring[ring_tail];
+    memcpy(uip_buf, r->buf, r->len + UIP_LLH_LEN);
+    uip_len = r->len;
+    if(++ring_tail == UIP_INPUT_RING) {
+      ring_tail = 0;
+    }
+    --ring_count;
+    input();
+  }
+
+  /* The frames that did not fit in the burst are processed when the
+     TCP/IP process is polled next. A poll is requested so that they
+     do not wait for the next timer, and fill up the ring, with an
+     event loop that sleeps between polls. */
+  if(ring_count > 0) {
+    EK_REQUEST_POLL();
+  }
+}
+/*---------------------------------------------------------------------------*/
+u8_t *
+tcpip_input_slot(void)
+{
+  if(ring_count == UIP_INPUT_RING) {
+    return NULL;
+  }
+  return ring[ring_head].buf;
+}
+/*---------------------------------------------------------------------------*/
+void
+tcpip_input_put(u16_t len)
+{
+  ring[ring_head].len = len;
+  if(++ring_head == UIP_INPUT_RING) {
+    ring_head = 0;
+  }
+  ++ring_count;
+}
+#endif /* UIP_INPUT_RING > 0 */
+/*---------------------------------------------------------------------------*/
+void
+tcpip_input(void)
+{
+  input();
+#if UIP_INPUT_RING > 0
+  input_burst();
+#endif /* UIP_INPUT_RING > 0 */
+}
+/*---------------------------------------------------------------------------*/
 void
 tcpip_output(void)
 {
@@ -142,7 +307,9 @@ tcpip_output(void)
     } else {
       datalen = uip_len - UIP_TCPIP_HLEN;
     }
-    
+
+    TCPDUMP_CAPTURE_PACKET(TCPDUMP_OUT, &uip_buf[UIP_LLH_LEN], hdrlen,
+			   uip_appdata, datalen);
     state->output(&uip_buf[UIP_LLH_LEN], hdrlen, uip_appdata, datalen);
   }
 }
@@ -168,10 +335,10 @@ tcp_connect(u16_t *ripaddr, u16_t port, void *appstate)
 void
 tcp_unlisten(u16_t port)
 {
-  static unsigned char i;
+  static CC_THREAD_LOCAL unsigned char i;
   struct listenport *l;
 
-  l = s.listenports;
+  l = LISTENPORTS;
   for(i = 0; i < UIP_LISTENPORTS; ++i) {
     if(l->port == port &&
        l->id == EK_PROC_ID(EK_CURRENT())) {
@@ -186,10 +353,10 @@ tcp_unlisten(u16_t port)
 void
 tcp_listen(u16_t port)
 {
-  static unsigned char i;
+  static CC_THREAD_LOCAL unsigned char i;
   struct listenport *l;
 
-  l = s.listenports;
+  l = LISTENPORTS;
   for(i = 0; i < UIP_LISTENPORTS; ++i) {
     if(l->port == 0) {
       l->port = port;
@@ -232,19 +399,21 @@ udp_new(u16_t *ripaddr, u16_t port, void *appstate)
 /*---------------------------------------------------------------------------*/
 EK_EVENTHANDLER(eventhandler, ev, data)
 {
-  static unsigned char i;
+  static CC_THREAD_LOCAL unsigned char i;
   register struct listenport *l;
   ek_id_t id;
   struct internal_state *state;
   
   switch(ev) {
   case EK_EVENT_INIT:       
+    CONTEXTS_BEGIN();
     for(i = 0; i < UIP_LISTENPORTS; ++i) {
-      s.listenports[i].port = 0;
+      LISTENPORTS[i].port = 0;
     }
+    CONTEXTS_END();
     s.id = EK_PROC_ID(EK_CURRENT());
     tcpip_event = s.event = ek_alloc_event();
-    timer_set(&periodic, CLOCK_SECOND/2);  
+    timer_set(&periodic, CLOCK_SECOND/UIP_TCP_TIMER_HZ);  
     break;
   case EK_EVENT_REPLACE:
     memcpy(&s, data, sizeof(s));
@@ -259,7 +428,8 @@ EK_EVENTHANDLER(eventhandler, ev, data)
     
   case EK_EVENT_EXITED:
     id = (ek_id_t)data;
-    l = s.listenports;
+    CONTEXTS_BEGIN();
+    l = LISTENPORTS;
     for(i = 0; i < UIP_LISTENPORTS; ++i) {
       if(l->id == id) {
 	uip_unlisten(l->port);
@@ -281,6 +451,7 @@ EK_EVENTHANDLER(eventhandler, ev, data)
 	if(((struct tcpip_uipstate *)cptr->appstate)->id == id) {
 	  ((struct tcpip_uipstate *)cptr->appstate)->id = EK_ID_NONE;
 	  cptr->tcpstateflags = CLOSED;
+	  uip_conn_release(cptr);
 	}
       
       }
@@ -292,7 +463,7 @@ EK_EVENTHANDLER(eventhandler, ev, data)
       for(cptr = &uip_udp_conns[0];
 	  cptr < &uip_udp_conns[UIP_UDP_CONNS]; ++cptr) {
 	if(((struct tcpip_uipstate *)cptr->appstate)->id == id) {
-	  cptr->lport = 0;
+	  uip_udp_remove(cptr);
 	}
       }
       
@@ -303,21 +474,27 @@ EK_EVENTHANDLER(eventhandler, ev, data)
       }
       }*/
 #endif /* UIP_UDP */
+    CONTEXTS_END();
     break;
   case TCP_POLL:
     if(data != NULL) {
+      CONTEXT_OF_CONN(data);
       uip_poll_conn(data);
       if(uip_len > 0) {
 	tcpip_output();
       }
+      fill_window((struct uip_conn *)data);
+      CONTEXT_RESTORE();
     }
     break;
   case UDP_POLL:
     if(data != NULL) {
+      CONTEXT_OF_UDP_CONN(data);
       uip_udp_periodic_conn(data);
       if(uip_len > 0) {
 	tcpip_output();
       }
+      CONTEXT_RESTORE();
     }
     break;
   };
@@ -339,7 +516,7 @@ void
 tcpip_uipcall(void)     
 {
   register struct tcpip_uipstate *ts;
-  static unsigned char i;
+  static CC_THREAD_LOCAL unsigned char i;
   register struct listenport *l;
 
   if(uip_conn != NULL) {
@@ -351,7 +528,7 @@ tcpip_uipcall(void)
   /* If this is a connection request for a listening port, we must
      mark the connection with the right process ID. */
   if(uip_connected()) {
-    l = &s.listenports[0];
+    l = &LISTENPORTS[0];
     for(i = 0; i < UIP_LISTENPORTS; ++i) {
       if(l->port == uip_conn->lport &&
 	 l->id != EK_ID_NONE) {
@@ -368,19 +545,43 @@ tcpip_uipcall(void)
 /*---------------------------------------------------------------------------*/
 EK_POLLHANDLER(pollhandler)
 {
-  static unsigned char i;
+  static CC_THREAD_LOCAL u16_t i;
+#if UIP_TCP_TIMER_WHEEL
+  struct uip_conn *conn;
+#endif /* UIP_TCP_TIMER_WHEEL */
   
+#if UIP_INPUT_RING > 0
+  /* Process the frames that did not fit in the last burst. */
+  CONTEXTS_BEGIN();
+  input_burst();
+  CONTEXTS_END();
+#endif /* UIP_INPUT_RING > 0 */
+
   /* Check the clock so see if we should call the periodic uIP
      processing. */
   if(timer_expired(&periodic)) {
     timer_restart(&periodic);
+    CONTEXTS_BEGIN();
+#if UIP_TCP_TIMER_WHEEL
+    /* Only the connections with expired timers are processed. */
+    uip_wheel_tick();
+    while((conn = uip_wheel_due()) != NULL) {
+      uip_periodic_conn(conn);
+      if(uip_len > 0) {
+	tcpip_output();
+      }
+      fill_window(conn);
+    }
+#else /* UIP_TCP_TIMER_WHEEL */
     for(i = 0; i < UIP_CONNS; ++i) {
       uip_periodic(i);
       if(uip_len > 0) {
 	tcpip_output();
 	/*	uip_fw_output();*/
       }
+      fill_window(&uip_conns[i]);
     }
+#endif /* UIP_TCP_TIMER_WHEEL */
     
     for(i = 0; i < UIP_UDP_CONNS; i++) {
       uip_udp_periodic(i);
@@ -390,6 +591,7 @@ EK_POLLHANDLER(pollhandler)
       }
     }
     uip_fw_periodic();
+    CONTEXTS_END();
   }
 }
 /*---------------------------------------------------------------------------*/
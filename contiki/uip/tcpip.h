@@ -244,7 +244,7 @@ struct uip_udp_conn *udp_new(u16_t *ripaddr, u16_t port,
  *
  * This event is posted to a process whenever a uIP event has occured.
  */
-extern ek_event_t tcpip_event;
+extern CC_THREAD_LOCAL ek_event_t tcpip_event;
 
 
 
@@ -252,6 +252,29 @@ void tcpip_set_forwarding(unsigned char f);
 void tcpip_input(void);
 void tcpip_output(void);
 
+/**
+ * Get a free buffer in the input ring.
+ *
+ * This function is used by device drivers that read several frames
+ * before handing them to the stack, and is only available if
+ * UIP_INPUT_RING is set. The frame should be read into
+ * the returned buffer, which is UIP_BUFSIZE bytes large and laid out
+ * like uip_buf, and then be queued with tcpip_input_put(). The
+ * queued frames are processed by the next call to tcpip_input(),
+ * after any packet in uip_buf.
+ *
+ * \return A pointer to the buffer, or NULL if the ring is full.
+ */
+u8_t *tcpip_input_slot(void);
+
+/**
+ * Queue the frame in the buffer returned by tcpip_input_slot().
+ *
+ * \param len The length of the packet, not including the link level
+ * header, as it would have been put in uip_len.
+ */
+void tcpip_input_put(u16_t len);
+
 
 /**
  * Cause a specified TCP connection to be polled.
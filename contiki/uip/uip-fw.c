@@ -51,6 +51,16 @@
  * This file implements a number of simple functions which do packet
  * forwarding over multiple network interfaces with uIP.
  *
+ * The routes are kept in a path-compressed binary trie that is keyed
+ * on the bits of the destination prefix, so that the longest matching
+ * prefix is found in as many steps as there are bits in the prefix
+ * rather than in as many steps as there are routes.
+ *
+ * Packets that are not for this host are forwarded by
+ * uip_fw_forward() without going through uip_input(). Only the
+ * fields of the IP header that forwarding depends on are checked, and
+ * only the TTL and the checksum of the header are changed.
+ *
  */
 
 #include "uip.h"
@@ -64,13 +74,13 @@
  * \internal
  * The list of registered network interfaces.
  */
-static struct uip_fw_netif *netifs = NULL;
+static struct uip_fw_netif *UIP_CONTEXT_DECL(netifs);
 
 /**
  * \internal
  * A pointer to the default network interface.
  */
-static struct uip_fw_netif *defaultnetif = NULL;
+static struct uip_fw_netif *UIP_CONTEXT_DECL(defaultnetif);
 
 struct tcpip_hdr {
   /* IP header. */
@@ -159,6 +169,9 @@ struct fwcache_entry {
 /**
  * \internal
  * The number of packets to remember when looking for duplicates.
+ *
+ * A packet is remembered in the entry that its header fields hash
+ * to, so a packet is only looked for in a single entry.
  */
 #ifdef UIP_CONF_FWCACHE_SIZE
 #define FWCACHE_SIZE UIP_CONF_FWCACHE_SIZE
@@ -172,7 +185,97 @@ struct fwcache_entry {
  * A cache of packet header fields which are used for
  * identifying duplicate packets.
  */
-static struct fwcache_entry fwcache[FWCACHE_SIZE];
+static struct fwcache_entry UIP_CONTEXT_DECL(fwcache)[FWCACHE_SIZE];
+
+/**
+ * \internal
+ * The number of routes that can be held in the route table of each
+ * stack, including the routes of the registered network interfaces.
+ */
+#ifdef UIP_CONF_FW_ROUTES
+#define FW_ROUTES UIP_CONF_FW_ROUTES
+#else
+#define FW_ROUTES 8
+#endif
+
+/**
+ * \internal
+ * A node in the route trie.
+ *
+ * A node holds a prefix of a destination address, in host byte
+ * order, and the route to that prefix. The children of a node have
+ * longer prefixes that begin with the prefix of the node, and the
+ * bit that follows the prefix of the node selects the child. A node
+ * without a route is only there to join two subtrees, so the trie
+ * never needs more than two nodes per route.
+ */
+struct route {
+  unsigned long prefix;
+  u8_t len;
+  u8_t metric;
+  struct uip_fw_netif *netif;  /* NULL if the node has no route. */
+  struct route *child[2];
+};
+
+/**
+ * \internal
+ * The length given to a node that is not in use.
+ */
+#define FREE 0xff
+
+static struct route UIP_CONTEXT_DECL(routes)[2 * FW_ROUTES];
+static struct route *UIP_CONTEXT_DECL(root);
+
+/**
+ * \internal
+ * The interface that the last packet was sent out on.
+ *
+ * Packets tend to come in bursts to the same destination, so the
+ * route lookup is skipped if a packet has the same destination as the
+ * packet before it. The entry is cleared whenever the routes change.
+ */
+struct lastroute {
+  u16_t destipaddr[2];
+  struct uip_fw_netif *netif;
+  u8_t valid;
+};
+
+static struct lastroute UIP_CONTEXT_DECL(lastroute);
+
+#if UIP_STATISTICS == 1
+/**
+ * \internal
+ * The forwarding statistics of the stack.
+ */
+static struct uip_fw_stats UIP_CONTEXT_DECL(fwstats);
+#define UIP_STAT(s) s
+#else
+#define UIP_STAT(s)
+#endif /* UIP_STATISTICS == 1 */
+
+#if UIP_CONTEXTS > 0
+/* Make the forwarding state of each stack refer to the current
+   stack. */
+#define netifs       UIP_CONTEXT_REF(netifs)
+#define defaultnetif UIP_CONTEXT_REF(defaultnetif)
+#define fwcache      UIP_CONTEXT_REF(fwcache)
+#define routes       UIP_CONTEXT_REF(routes)
+#define root         UIP_CONTEXT_REF(root)
+#define lastroute    UIP_CONTEXT_REF(lastroute)
+#define fwstats      UIP_CONTEXT_REF(fwstats)
+#endif /* UIP_CONTEXTS > 0 */
+
+/**
+ * \internal
+ * An IP address, or a netmask, as a number in host byte order.
+ */
+#define KEY(addr) (((unsigned long)htons((addr)[0]) << 16) | htons((addr)[1]))
+
+/**
+ * \internal
+ * The bit of a key that follows a prefix of length len.
+ */
+#define BIT(key, len) ((u8_t)(((key) >> (31 - (len))) & 1))
 
 /**
  * \internal
@@ -188,26 +291,233 @@ static struct fwcache_entry fwcache[FWCACHE_SIZE];
 void
 uip_fw_init(void)
 {
+  struct route *r;
+
   defaultnetif = netifs = NULL;
+  root = NULL;
+  lastroute.valid = 0;
+  for(r = routes; r < &routes[2 * FW_ROUTES]; ++r) {
+    r->len = FREE;
+  }
+}
+/*------------------------------------------------------------------------------*/
+/**
+ * \internal
+ * The netmask of a prefix length, as a number in host byte order.
+ */
+/*------------------------------------------------------------------------------*/
+static unsigned long
+mask(u8_t len)
+{
+  if(len == 0) {
+    return 0;
+  }
+  return (0xffffffffUL << (32 - len)) & 0xffffffffUL;
+}
+/*------------------------------------------------------------------------------*/
+/**
+ * \internal
+ * Take a node of the route trie into use.
+ */
+/*------------------------------------------------------------------------------*/
+static struct route *
+route_alloc(unsigned long prefix, u8_t len)
+{
+  struct route *r;
+
+  for(r = routes; r < &routes[2 * FW_ROUTES]; ++r) {
+    if(r->len == FREE) {
+      r->prefix = prefix & mask(len);
+      r->len = len;
+      r->metric = 0;
+      r->netif = NULL;
+      r->child[0] = r->child[1] = NULL;
+      return r;
+    }
+  }
+  return NULL;
+}
+/*------------------------------------------------------------------------------*/
+/**
+ * \internal
+ * Count the free nodes of the route trie, up to a limit.
+ */
+/*------------------------------------------------------------------------------*/
+static u8_t
+route_free(u8_t limit)
+{
+  struct route *r;
+  u8_t n;
+
+  n = 0;
+  for(r = routes; r < &routes[2 * FW_ROUTES] && n < limit; ++r) {
+    if(r->len == FREE) {
+      ++n;
+    }
+  }
+  return n;
 }
 /*------------------------------------------------------------------------------*/
 /**
  * \internal
- * Check if an IP address is within the network defined by an IP
- * address and a netmask.
+ * Remove a node without a route from the route trie, if it has less
+ * than two children.
+ *
+ * \param rp A pointer to the pointer to the node.
+ */
+/*------------------------------------------------------------------------------*/
+static void
+route_compress(struct route **rp)
+{
+  struct route *r;
+
+  r = *rp;
+  if(r != NULL && r->netif == NULL &&
+     (r->child[0] == NULL || r->child[1] == NULL)) {
+    *rp = r->child[0] != NULL? r->child[0]: r->child[1];
+    r->len = FREE;
+  }
+}
+/*------------------------------------------------------------------------------*/
+/**
+ * \internal
+ * Get the length of a netmask, counted as the number of leading one
+ * bits.
+ */
+/*------------------------------------------------------------------------------*/
+static u8_t
+prefixlen(u16_t *netmask)
+{
+  unsigned long m;
+  u8_t len;
+
+  m = KEY(netmask);
+  for(len = 0; len < 32 && BIT(m, len); ++len);
+  return len;
+}
+/*------------------------------------------------------------------------------*/
+/**
+ * Add a route to the route table.
+ *
+ * Packets to the network given by the IP address and the netmask are
+ * sent out on the network interface, unless there is a route to a
+ * longer prefix of their destination address. If there already is a
+ * route to the same network, it is replaced unless it has a lower
+ * metric than the new route.
+ *
+ * \param ipaddr A pointer to the IP address of the network.
  *
- * \param ipaddr The IP address to be checked.
- * \param netipaddr The IP address of the network.
- * \param netmask The netmask of the network.
+ * \param netmask A pointer to the netmask of the network. Only the
+ * leading one bits of the netmask are used.
  *
- * \return Non-zero if IP address is in network, zero otherwise.
+ * \param netif A pointer to the network interface.
+ *
+ * \param metric The metric of the route.
+ *
+ * \return UIP_FW_ROUTE_ADDED if the route was added,
+ * UIP_FW_ROUTE_KEPT if an existing route with a lower metric was kept
+ * instead, or UIP_FW_ROUTE_FULL if the route table was full.
  */
 /*------------------------------------------------------------------------------*/
-static unsigned char
-ipaddr_maskcmp(u16_t *ipaddr, u16_t *netipaddr, u16_t *netmask)
+u8_t
+uip_fw_route_add(u16_t *ipaddr, u16_t *netmask,
+		 struct uip_fw_netif *netif, u8_t metric)
 {
-  return (ipaddr[0] & netmask [0]) == (netipaddr[0] & netmask[0]) &&
-    (ipaddr[1] & netmask[1]) == (netipaddr[1] & netmask[1]);
+  struct route *r, *n, **rp;
+  unsigned long prefix;
+  u8_t len, common, need;
+
+  len = prefixlen(netmask);
+  prefix = KEY(ipaddr) & mask(len);
+  lastroute.valid = 0;
+
+  /* Walk down the trie along the prefix, until we find the node of
+     the prefix, or a node whose prefix the new prefix diverges
+     from. */
+  for(rp = &root; (n = *rp) != NULL; rp = &n->child[BIT(prefix, n->len)]) {
+    for(common = 0;
+	common < len && common < n->len &&
+	  BIT(prefix, common) == BIT(n->prefix, common);
+	++common);
+
+    if(common < n->len) {
+      /* The new prefix diverges from the prefix of the node, or is a
+	 part of it. The new route goes above the node, together with
+	 a node that joins them if the new prefix diverges. */
+      need = common < len? 2: 1;
+      if(route_free(need) < need) {
+	return UIP_FW_ROUTE_FULL;
+      }
+      r = route_alloc(prefix, len);
+      if(common < len) {
+	*rp = route_alloc(prefix, common);
+	(*rp)->child[BIT(prefix, common)] = r;
+	(*rp)->child[BIT(n->prefix, common)] = n;
+      } else {
+	r->child[BIT(n->prefix, len)] = n;
+	*rp = r;
+      }
+      break;
+    }
+
+    if(n->len == len) {
+      /* There already is a node for the prefix. */
+      if(n->netif != NULL && n->metric < metric) {
+	return UIP_FW_ROUTE_KEPT;
+      }
+      r = n;
+      break;
+    }
+  }
+
+  if(n == NULL) {
+    r = route_alloc(prefix, len);
+    if(r == NULL) {
+      return UIP_FW_ROUTE_FULL;
+    }
+    *rp = r;
+  }
+
+  r->netif = netif;
+  r->metric = metric;
+  return UIP_FW_ROUTE_ADDED;
+}
+/*------------------------------------------------------------------------------*/
+/**
+ * Remove a route from the route table.
+ *
+ * \param ipaddr A pointer to the IP address of the network.
+ *
+ * \param netmask A pointer to the netmask of the network.
+ */
+/*------------------------------------------------------------------------------*/
+void
+uip_fw_route_remove(u16_t *ipaddr, u16_t *netmask)
+{
+  struct route *n, **rp, **parent;
+  unsigned long prefix;
+  u8_t len;
+
+  len = prefixlen(netmask);
+  prefix = KEY(ipaddr) & mask(len);
+  lastroute.valid = 0;
+
+  parent = NULL;
+  for(rp = &root; (n = *rp) != NULL && n->len < len;
+      rp = &n->child[BIT(prefix, n->len)]) {
+    parent = rp;
+  }
+  if(n == NULL || n->len != len || n->prefix != prefix) {
+    return;
+  }
+
+  /* The node is removed if it has less than two children, and so is
+     its parent if that only joined the node to another subtree. */
+  n->netif = NULL;
+  route_compress(rp);
+  if(parent != NULL) {
+    route_compress(parent);
+  }
 }
 /*------------------------------------------------------------------------------*/
 /**
@@ -270,6 +580,23 @@ time_exceeded(void)
   ICMPBUF->ipchksum = ~(uip_ipchksum());
 
 
+}
+/*------------------------------------------------------------------------------*/
+/**
+ * \internal
+ * Find the entry of the forwarding cache for the packet in uip_buf.
+ */
+/*------------------------------------------------------------------------------*/
+static struct fwcache_entry *
+fwcache_lookup(void)
+{
+  u16_t h;
+
+  h = BUF->ipid ^ BUF->srcipaddr[0] ^ BUF->srcipaddr[1] ^
+    BUF->destipaddr[0] ^ BUF->destipaddr[1] ^
+    BUF->srcport ^ BUF->destport;
+  h ^= h >> 8;
+  return &fwcache[h % FWCACHE_SIZE];
 }
 /*------------------------------------------------------------------------------*/
 /**
@@ -282,22 +609,8 @@ static void
 fwcache_register(void)
 {
   struct fwcache_entry *fw;
-  int i, oldest;
-
-  oldest = FW_TIME;
-  fw = NULL;
-  
-  /* Find the oldest entry in the cache. */
-  for(i = 0; i < FWCACHE_SIZE; ++i) {
-    if(fwcache[i].timer == 0) {
-      fw = &fwcache[i];
-      break;
-    } else if(fwcache[i].timer <= oldest) {
-      fw = &fwcache[i];
-      oldest = fwcache[i].timer;
-    }
-  }
 
+  fw = fwcache_lookup();
   fw->timer = FW_TIME;
   fw->len = BUF->len;
   fw->offset = BUF->ipoffset;
@@ -319,19 +632,37 @@ fwcache_register(void)
 static struct uip_fw_netif *
 find_netif(void)
 {
-  struct uip_fw_netif *netif;
-  
-  /* Walk through every network interface to check for a match. */
-  for(netif = netifs; netif != NULL; netif = netif->next) {
-    if(ipaddr_maskcmp(BUF->destipaddr, netif->ipaddr,
-		      netif->netmask)) {
-      /* If there was a match, we break the loop. */
-      return netif;
+  struct route *r, *match;
+  unsigned long dest;
+
+  if(lastroute.valid &&
+     lastroute.destipaddr[0] == BUF->destipaddr[0] &&
+     lastroute.destipaddr[1] == BUF->destipaddr[1]) {
+    return lastroute.netif;
+  }
+  lastroute.destipaddr[0] = BUF->destipaddr[0];
+  lastroute.destipaddr[1] = BUF->destipaddr[1];
+  lastroute.valid = 1;
+
+  dest = KEY(BUF->destipaddr);
+
+  /* Walk down the route trie for as long as the prefixes match the
+     destination address, and remember the last route on the way. */
+  match = NULL;
+  for(r = root; r != NULL && (dest & mask(r->len)) == r->prefix;
+      r = r->len < 32? r->child[BIT(dest, r->len)]: NULL) {
+    if(r->netif != NULL) {
+      match = r;
     }
   }
-  
-  /* If no matching netif was found, we use default netif. */
-  return defaultnetif;  
+
+  if(match != NULL) {
+    lastroute.netif = match->netif;
+  } else {
+    /* If no matching route was found, we use default netif. */
+    lastroute.netif = defaultnetif;
+  }
+  return lastroute.netif;
 }    
 /*------------------------------------------------------------------------------*/
 /**
@@ -400,6 +731,14 @@ uip_fw_forward(void)
 {
   struct uip_fw_netif *netif;
   struct fwcache_entry *fw;
+  u16_t len;
+
+  /* Packets that are too short or that are not IPv4 are left to
+     uip_input(), which drops them. */
+  if(uip_len < UIP_IPH_LEN ||
+     (BUF->vhl & 0xf0) != 0x40 || (BUF->vhl & 0x0f) < 5) {
+    return UIP_FW_LOCAL;
+  }
 
   /* First check if the packet is destined for ourselves and return 0
      to indicate that the packet should be processed locally. */
@@ -426,52 +765,72 @@ uip_fw_forward(void)
   }
 #endif /* UIP_PINGADDRCONF */
 
+  /* The length of the IP packet must fit within the received
+     frame. Any padding that the link layer has added after the packet
+     is removed so that it is not sent out again. */
+  len = htons(BUF->len);
+  if(len < UIP_IPH_LEN || len > uip_len) {
+    UIP_STAT(++fwstats.dropped);
+    return UIP_FW_FORWARDED;
+  }
+  uip_len = len;
+
   /* Check if the packet is in the forwarding cache already, and if so
      we drop it. */
 
-  for(fw = fwcache; fw <= &fwcache[FWCACHE_SIZE]; ++fw) {
-    if(fw->timer != 0 &&
-       fw->len == BUF->len &&
-       fw->offset == BUF->ipoffset &&
-       fw->ipid == BUF->ipid &&      
-       fw->srcipaddr[0] == BUF->srcipaddr[0] &&
-       fw->srcipaddr[1] == BUF->srcipaddr[1] &&
-       fw->destipaddr[0] == BUF->destipaddr[0] &&
-       fw->destipaddr[1] == BUF->destipaddr[1] &&
-       fw->proto == BUF->proto &&
-       fw->payload[0] == BUF->srcport &&
-       fw->payload[1] == BUF->destport) {
-      /* Drop packet. */
-      return UIP_FW_FORWARDED;
-    }       
+  fw = fwcache_lookup();
+  if(fw->timer != 0 &&
+     fw->len == BUF->len &&
+     fw->offset == BUF->ipoffset &&
+     fw->ipid == BUF->ipid &&      
+     fw->srcipaddr[0] == BUF->srcipaddr[0] &&
+     fw->srcipaddr[1] == BUF->srcipaddr[1] &&
+     fw->destipaddr[0] == BUF->destipaddr[0] &&
+     fw->destipaddr[1] == BUF->destipaddr[1] &&
+     fw->proto == BUF->proto &&
+     fw->payload[0] == BUF->srcport &&
+     fw->payload[1] == BUF->destport) {
+    /* Drop packet. */
+    UIP_STAT(++fwstats.dropped);
+    return UIP_FW_FORWARDED;
   }
 
-  netif = find_netif();
-
-  /* Decrement the TTL (time-to-live) value in the IP header */
-  BUF->ttl = BUF->ttl - 1;
-  
-  /* Update the IP checksum. */
-  if(BUF->ipchksum >= HTONS(0xffff - 0x0100)) {
-    BUF->ipchksum = BUF->ipchksum + HTONS(0x0100) + 1;
+  /* If the TTL would reach zero we procude an ICMP time exceeded
+     message in the uip_buf buffer and forward that packet back to the
+     sender of the packet. */
+  if(BUF->ttl <= 1) {
+    UIP_STAT(++fwstats.dropped);
+    time_exceeded();
   } else {
-    BUF->ipchksum = BUF->ipchksum + HTONS(0x0100);
+    /* Decrement the TTL (time-to-live) value in the IP header */
+    BUF->ttl = BUF->ttl - 1;
+  
+    /* Update the IP checksum. Only the TTL has changed, so we adjust
+       the checksum instead of computing it over the header again. */
+    BUF->ipchksum = uip_chksum_update(BUF->ipchksum,
+				      HTONS((BUF->ttl + 1) << 8),
+				      HTONS(BUF->ttl << 8));
   }
   
-  /* If the TTL reaches zero we procude an ICMP time exceeded message
-     in the uip_buf buffer and forward that packet back to the sender
-     of the packet. */
-  if(BUF->ttl == 0) {    
-    time_exceeded();
-    netif = find_netif();
+  if(uip_len == 0) {
+    return UIP_FW_FORWARDED;
+  }
+
+  netif = find_netif();
+  if(netif == NULL) {
+    UIP_STAT(++fwstats.dropped);
+    return UIP_FW_FORWARDED;
   }
   
   /* If we now have found a suitable network interface, we call its
      output function to send out the packet. */
-  if(netif != NULL && uip_len > 0) {
-    uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
-    fwcache_register();
-    netif->output();
+  uip_appdata = &uip_buf[UIP_LLH_LEN + UIP_TCPIP_HLEN];
+  fwcache_register();
+  if(netif->output() == UIP_FW_OK) {
+    UIP_STAT(++netif->stats.forwarded);
+    UIP_STAT(++fwstats.forwarded);
+  } else {
+    UIP_STAT(++netif->stats.dropped);
   }
 
   /* Return non-zero to indicate that the packet was forwarded and that no
@@ -482,6 +841,11 @@ uip_fw_forward(void)
 /**
  * Register a network interface with the forwarding module.
  *
+ * A route with metric zero is added for the network given by the IP
+ * address and the netmask that the interface has when it is
+ * registered. If they are changed later, the route must be changed
+ * with uip_fw_route_remove() and uip_fw_route_add().
+ *
  * \param netif A pointer to the network interface that is to be
  * registered.  
  */
@@ -491,6 +855,7 @@ uip_fw_register(struct uip_fw_netif *netif)
 {
   netif->next = netifs;
   netifs = netif;
+  uip_fw_route_add(netif->ipaddr, netif->netmask, netif, 0);
 }
 /*------------------------------------------------------------------------------*/
 /**
@@ -507,6 +872,7 @@ void
 uip_fw_default(struct uip_fw_netif *netif)
 {
   defaultnetif = netif;
+  lastroute.valid = 0;
 }
 /*------------------------------------------------------------------------------*/
 /**
@@ -517,10 +883,40 @@ void
 uip_fw_periodic(void)
 {
   struct fwcache_entry *fw;
-  for(fw = fwcache; fw <= &fwcache[FWCACHE_SIZE]; ++fw) {
+  for(fw = fwcache; fw < &fwcache[FWCACHE_SIZE]; ++fw) {
     if(fw->timer > 0) {
       --fw->timer;
     }    
   }
 }
 /*------------------------------------------------------------------------------*/
+#if UIP_STATISTICS == 1
+/**
+ * Get the forwarding statistics of a network interface.
+ *
+ * The statistics of an interface count the packets that were
+ * forwarded out on the interface, and the packets that its output
+ * function did not send. The statistics of the stack count all
+ * forwarded packets, and the packets that were dropped before an
+ * interface was found for them because they were malformed,
+ * duplicates, had no route or had run out of TTL.
+ *
+ * \note This function is only available if UIP_STATISTICS is set to
+ * 1.
+ *
+ * \param netif A pointer to the network interface, or NULL for the
+ * statistics of the stack.
+ *
+ * \return A pointer to the statistics.
+ */
+/*------------------------------------------------------------------------------*/
+struct uip_fw_stats *
+uip_fw_stats(struct uip_fw_netif *netif)
+{
+  if(netif == NULL) {
+    return &fwstats;
+  }
+  return &netif->stats;
+}
+/*------------------------------------------------------------------------------*/
+#endif /* UIP_STATISTICS == 1 */
@@ -48,6 +48,14 @@
 
 #include "uip.h"
 
+/**
+ * The counters of the packets that have been forwarded.
+ */
+struct uip_fw_stats {
+  uip_stats_t forwarded;      /**< The number of packets forwarded. */
+  uip_stats_t dropped;        /**< The number of packets dropped. */
+};
+
 /**
  * Representation of a uIP network interface.
  */
@@ -59,6 +67,10 @@ struct uip_fw_netif {
   u8_t (* output)(void);
                               /**< A pointer to the function that
 				 sends a packet. */
+#if UIP_STATISTICS == 1
+  struct uip_fw_stats stats;  /**< The packets that have been
+				 forwarded out on this interface. */
+#endif /* UIP_STATISTICS == 1 */
 };
 
 /**
@@ -113,6 +125,12 @@ u8_t uip_fw_forward(void);
 u8_t uip_fw_output(void);
 void uip_fw_register(struct uip_fw_netif *netif);
 void uip_fw_default(struct uip_fw_netif *netif);
+u8_t uip_fw_route_add(u16_t *ipaddr, u16_t *netmask,
+		      struct uip_fw_netif *netif, u8_t metric);
+void uip_fw_route_remove(u16_t *ipaddr, u16_t *netmask);
+#if UIP_STATISTICS == 1
+struct uip_fw_stats *uip_fw_stats(struct uip_fw_netif *netif);
+#endif /* UIP_STATISTICS == 1 */
 void uip_fw_periodic(void);
 
 
@@ -170,6 +188,32 @@ void uip_fw_periodic(void);
  */
 #define UIP_FW_DROPPED   5
 
+/**
+ * A value returned by uip_fw_route_add() that indicates that the
+ * route table was full, and that the route was not added.
+ *
+ * \hideinitializer
+ */
+#define UIP_FW_ROUTE_FULL  0
+
+/**
+ * A value returned by uip_fw_route_add() that indicates that the
+ * route was added, or replaced an existing route to the same
+ * network.
+ *
+ * \hideinitializer
+ */
+#define UIP_FW_ROUTE_ADDED 1
+
+/**
+ * A value returned by uip_fw_route_add() that indicates that an
+ * existing route to the same network with a lower metric was kept,
+ * and that the new route was discarded.
+ *
+ * \hideinitializer
+ */
+#define UIP_FW_ROUTE_KEPT  2
+
 
 #endif /* __UIP_FW_H__ */
 
@@ -42,11 +42,22 @@
 
 #define BUF ((uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
+/*-----------------------------------------------------------------------------*/
+static u16_t
+chksum_add(u16_t sum, u16_t val)
+{
+  sum += val;
+  if(sum < val) {
+    ++sum;
+  }
+  return sum;
+}
 /*-----------------------------------------------------------------------------*/
 void
 uip_split_output(void)
 {
   u16_t tcplen, len1, len2;
+  u16_t tcpchksum, ipchksum, hsum, sum1, sum2, seqno[2];
 
   /* We only try to split maximum sized TCP segments. */
   if(BUF->proto == UIP_PROTO_TCP &&
@@ -60,19 +71,51 @@ uip_split_output(void)
       ++len2;
     }
 
+    /* Compute the sum of the TCP header and the pseudo-header,
+       without the length field, and the sum of the first half of
+       the data. The checksums of both packets are derived from
+       these and from the checksum of the original segment, so the
+       data only needs to be checksummed once. */
+    tcpchksum = BUF->tcpchksum;
+    ipchksum = BUF->ipchksum;
+    seqno[0] = HTONS((BUF->seqno[0] << 8) | BUF->seqno[1]);
+    seqno[1] = HTONS((BUF->seqno[2] << 8) | BUF->seqno[3]);
+    BUF->tcpchksum = 0;
+    hsum = uip_chksum((u16_t *)&uip_buf[UIP_LLH_LEN + UIP_IPH_LEN],
+		      UIP_TCPH_LEN);
+    hsum = chksum_add(hsum, BUF->srcipaddr[0]);
+    hsum = chksum_add(hsum, BUF->srcipaddr[1]);
+    hsum = chksum_add(hsum, BUF->destipaddr[0]);
+    hsum = chksum_add(hsum, BUF->destipaddr[1]);
+    hsum = chksum_add(hsum, HTONS(UIP_PROTO_TCP));
+    sum1 = uip_chksum((u16_t *)uip_appdata, len1);
+
+    /* The sum of the second half of the data is what remains of the
+       original checksum when the headers and the first half are
+       subtracted. If the first half has an odd length, the bytes of
+       the second half move from the low to the high byte of each
+       16-bit word (and vice versa) when they become the start of the
+       second packet, so the sum is byte swapped. */
+    sum2 = chksum_add(~tcpchksum, ~hsum);
+    sum2 = chksum_add(sum2, ~HTONS(tcplen + UIP_TCPH_LEN));
+    sum2 = chksum_add(sum2, ~sum1);
+    if(len1 & 1) {
+      sum2 = (sum2 << 8) | (sum2 >> 8);
+    }
+    
     /* Create the first packet. This is done by altering the length
        field of the IP header and updating the checksums. */
     uip_len = len1 + UIP_TCPIP_HLEN;
     BUF->len[0] = (uip_len >> 8);
     BUF->len[1] = (uip_len & 0xff);
     
-    /* Recalculate the TCP checksum. */
-    BUF->tcpchksum = 0;
-    BUF->tcpchksum = ~(uip_tcpchksum());
+    BUF->tcpchksum = ~chksum_add(chksum_add(hsum, HTONS(len1 + UIP_TCPH_LEN)),
+				 sum1);
     
-    /* Recalculate the IP checksum. */
-    BUF->ipchksum = 0;
-    BUF->ipchksum = ~(uip_ipchksum());
+    /* Only the length field of the IP header has changed. */
+    BUF->ipchksum = uip_chksum_update(ipchksum,
+				      HTONS(tcplen + UIP_TCPIP_HLEN),
+				      HTONS(uip_len));
 
     /* Transmit the first packet. */
     /*    uip_fw_output();*/
@@ -95,13 +138,18 @@ uip_split_output(void)
     BUF->seqno[2] = uip_acc32[2];
     BUF->seqno[3] = uip_acc32[3];
     
-    /* Recalculate the TCP checksum. */
-    BUF->tcpchksum = 0;
-    BUF->tcpchksum = ~(uip_tcpchksum());
+    /* The header sum was computed with the old sequence number, so
+       the checksum is adjusted for the new one. */
+    tcpchksum = ~chksum_add(chksum_add(hsum, HTONS(len2 + UIP_TCPH_LEN)),
+			    sum2);
+    tcpchksum = uip_chksum_update(tcpchksum, seqno[0],
+				  HTONS((BUF->seqno[0] << 8) | BUF->seqno[1]));
+    BUF->tcpchksum = uip_chksum_update(tcpchksum, seqno[1],
+				       HTONS((BUF->seqno[2] << 8) | BUF->seqno[3]));
     
-    /* Recalculate the IP checksum. */
-    BUF->ipchksum = 0;
-    BUF->ipchksum = ~(uip_ipchksum());
+    BUF->ipchksum = uip_chksum_update(ipchksum,
+				      HTONS(tcplen + UIP_TCPIP_HLEN),
+				      HTONS(uip_len));
 
     /* Transmit the second packet. */
     /*    uip_fw_output();*/
@@ -72,6 +72,8 @@ to the peer.
 #include "uipopt.h"
 #include "uip_arch.h"
 
+#include <string.h>
+
 /*-----------------------------------------------------------------------------------*/
 /* Variable definitions. */
 
@@ -88,8 +90,8 @@ const u16_t uip_netmask[2] =
   {HTONS((UIP_NETMASK0 << 8) | UIP_NETMASK1),
    HTONS((UIP_NETMASK2 << 8) | UIP_NETMASK3)};
 #else
-u16_t uip_hostaddr[2];       
-u16_t uip_draddr[2], uip_netmask[2];
+u16_t UIP_CONTEXT_DECL(uip_hostaddr)[2];       
+u16_t UIP_CONTEXT_DECL(uip_draddr)[2], UIP_CONTEXT_DECL(uip_netmask)[2];
 #endif /* UIP_FIXEDADDR */
 
 #if UIP_FIXEDETHADDR
@@ -100,64 +102,175 @@ const struct uip_eth_addr uip_ethaddr = {{UIP_ETHADDR0,
 					  UIP_ETHADDR4,
 					  UIP_ETHADDR5}};
 #else
-struct uip_eth_addr uip_ethaddr = {{0,0,0,0,0,0}};
+struct uip_eth_addr UIP_CONTEXT_DECL(uip_ethaddr);
 #endif
 
 #ifndef UIP_CONF_EXTERNAL_BUFFER
-u8_t uip_buf[UIP_BUFSIZE + 2];   /* The packet buffer that contains
+UIP_CONTEXT_TLS u8_t uip_buf[UIP_BUFSIZE + 2];
+                                 /* The packet buffer that contains
 				    incoming packets. */
 #endif /* UIP_CONF_EXTERNAL_BUFFER */
 
-u8_t *uip_appdata;               /* The uip_appdata pointer points to
+UIP_CONTEXT_TLS u8_t *uip_appdata;  /* The uip_appdata pointer points to
 				    application data. */
-u8_t *uip_sappdata;              /* The uip_appdata pointer points to
+UIP_CONTEXT_TLS u8_t *uip_sappdata; /* The uip_appdata pointer points to
 				    the application data which is to
 				    be sent. */
 #if UIP_URGDATA > 0
-u8_t *uip_urgdata;               /* The uip_urgdata pointer points to
+UIP_CONTEXT_TLS u8_t *uip_urgdata;  /* The uip_urgdata pointer points to
    				    urgent data (out-of-band data), if
    				    present. */
-u16_t uip_urglen, uip_surglen;
+UIP_CONTEXT_TLS u16_t uip_urglen, uip_surglen;
 #endif /* UIP_URGDATA > 0 */
 
-u16_t uip_len, uip_slen;
+UIP_CONTEXT_TLS u16_t uip_len, uip_slen;
                              /* The uip_len is either 8 or 16 bits,
 				depending on the maximum packet
 				size. */
 
-u8_t uip_flags;     /* The uip_flags variable is used for
+UIP_CONTEXT_TLS u8_t uip_flags;     /* The uip_flags variable is used for
 				communication between the TCP/IP stack
 				and the application program. */
-struct uip_conn *uip_conn;   /* uip_conn always points to the current
+UIP_CONTEXT_TLS struct uip_conn *uip_conn; /* uip_conn always points to the current
 				connection. */
 
-struct uip_conn uip_conns[UIP_CONNS];
+struct uip_conn UIP_CONTEXT_DECL(uip_conns)[UIP_CONNS];
                              /* The uip_conns array holds all TCP
 				connections. */
-u16_t uip_listenports[UIP_LISTENPORTS];
+u16_t UIP_CONTEXT_DECL(uip_listenports)[UIP_LISTENPORTS];
                              /* The uip_listenports list all currently
 				listning ports. */
 #if UIP_UDP
-struct uip_udp_conn *uip_udp_conn;
-struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
+UIP_CONTEXT_TLS struct uip_udp_conn *uip_udp_conn;
+struct uip_udp_conn UIP_CONTEXT_DECL(uip_udp_conns)[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 
-static u16_t ipid;           /* Ths ipid variable is an increasing
+#if UIP_TCP_HASHSIZE > 0
+static u16_t UIP_CONTEXT_DECL(connhash)[UIP_TCP_HASHSIZE];
+                             /* The connhash table holds the index +
+				1 of the first connection in each hash
+				chain, or 0 if the chain is empty. */
+static u16_t UIP_CONTEXT_DECL(connhash_next)[UIP_CONNS];
+                             /* The connhash_next array links the
+				connections within a hash chain. */
+#endif /* UIP_TCP_HASHSIZE > 0 */
+
+#if UIP_UDP && UIP_UDP_HASHSIZE > 0
+static u8_t UIP_CONTEXT_DECL(udphash)[UIP_UDP_HASHSIZE];
+                             /* The udphash table holds the index +
+				1 of the first UDP connection in each
+				hash chain, or 0 if the chain is
+				empty. */
+static u8_t UIP_CONTEXT_DECL(udphash_next)[UIP_UDP_CONNS];
+                             /* The udphash_next array links the UDP
+				connections within a hash chain, in
+				the order of the uip_udp_conns
+				array. */
+#endif /* UIP_UDP && UIP_UDP_HASHSIZE > 0 */
+
+#if UIP_TCP_WINDOW_SEGS > 1
+static struct uip_tcp_seg UIP_CONTEXT_DECL(segbufs)[UIP_TCP_REXMIT_SEGS];
+                             /* The segbufs array holds the
+				retransmission buffers of all
+				connections. */
+static struct uip_tcp_seg *UIP_CONTEXT_DECL(segs_free);
+                             /* The list of unused retransmission
+				buffers. */
+static UIP_CONTEXT_TLS u16_t seqoff; /* The offset from snd_nxt of the
+				sequence number of the segment that
+				is being sent. */
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+
+#if UIP_TCP_TIMER_WHEEL
+#define WHEEL_L0_BITS 4
+#define WHEEL_L0_SIZE (1 << WHEEL_L0_BITS)
+#define WHEEL_L1_SIZE 32
+static u16_t UIP_CONTEXT_DECL(wheel)[WHEEL_L0_SIZE + WHEEL_L1_SIZE];
+                             /* The wheel array holds the index + 1
+				of the first connection in each timer
+				wheel slot. The first WHEEL_L0_SIZE
+				slots are one pulse apart and the
+				rest are WHEEL_L0_SIZE pulses apart. */
+static u16_t UIP_CONTEXT_DECL(wheel_next)[UIP_CONNS];
+                             /* The wheel_next array links the
+				connections within a slot. */
+static u8_t UIP_CONTEXT_DECL(wheel_slot)[UIP_CONNS];
+                             /* The slot + 1 that each connection is
+				in, or 0 if it is not in the wheel. */
+static u16_t UIP_CONTEXT_DECL(wheel_expires)[UIP_CONNS];
+                             /* The pulse at which each connection is
+				due. */
+static u16_t UIP_CONTEXT_DECL(wheel_synced)[UIP_CONNS];
+                             /* The pulse up to which the timers of
+				each connection have been advanced. */
+static u16_t UIP_CONTEXT_DECL(wheel_now);
+                             /* The current periodic timer pulse. */
+#endif /* UIP_TCP_TIMER_WHEEL */
+
+#if UIP_TCP_SYN_BACKLOG > 0
+struct synq_entry {
+  u16_t ripaddr[2];
+  u16_t rport, lport;
+  u8_t seqno[4];
+  u16_t mss;
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  u8_t tcpopts;
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
+};
+static struct synq_entry UIP_CONTEXT_DECL(synq)[UIP_TCP_SYN_BACKLOG];
+                             /* The synq array holds the SYNs that
+				are waiting for a free connection,
+				oldest first. */
+static u8_t UIP_CONTEXT_DECL(synq_len);
+                             /* The number of SYNs in the synq
+				array. */
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
+
+static UIP_CONTEXT_TLS u16_t ipid;   /* Ths ipid variable is an increasing
 				number that is used for the IP ID
 				field. */
 
-static u8_t iss[4];          /* The iss variable is used for the TCP
+static UIP_CONTEXT_TLS u8_t iss[4];  /* The iss variable is used for the TCP
 				initial sequence number. */
 
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+static UIP_CONTEXT_TLS u8_t synopts; /* The window scale and SACK options of
+				the last parsed SYN, in the format of
+				the tcpopts field of uip_conn. */
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
+
 #if UIP_ACTIVE_OPEN
-static u16_t lastport;       /* Keeps track of the last port used for
+static UIP_CONTEXT_TLS u16_t lastport; /* Keeps track of the last port used for
 				a new connection. */
 #endif /* UIP_ACTIVE_OPEN */
 
 /* Temporary variables. */
-u8_t uip_acc32[4];
-static u8_t c, opt;
-static u16_t tmp16;
+UIP_CONTEXT_TLS u8_t uip_acc32[4];
+static UIP_CONTEXT_TLS u8_t c, opt;
+static UIP_CONTEXT_TLS u16_t tmp16;
+
+#if UIP_CONTEXTS > 0
+UIP_CONTEXT_TLS u8_t uip_context;
+                             /* The stack that is currently used. */
+
+/* Make the state of each stack refer to the current stack. */
+#define connhash         UIP_CONTEXT_REF(connhash)
+#define connhash_next    UIP_CONTEXT_REF(connhash_next)
+#define udphash          UIP_CONTEXT_REF(udphash)
+#define udphash_next     UIP_CONTEXT_REF(udphash_next)
+#define segbufs          UIP_CONTEXT_REF(segbufs)
+#define segs_free        UIP_CONTEXT_REF(segs_free)
+#define wheel            UIP_CONTEXT_REF(wheel)
+#define wheel_next       UIP_CONTEXT_REF(wheel_next)
+#define wheel_slot       UIP_CONTEXT_REF(wheel_slot)
+#define wheel_expires    UIP_CONTEXT_REF(wheel_expires)
+#define wheel_synced     UIP_CONTEXT_REF(wheel_synced)
+#define wheel_now        UIP_CONTEXT_REF(wheel_now)
+#define synq             UIP_CONTEXT_REF(synq)
+#define synq_len         UIP_CONTEXT_REF(synq_len)
+#define uip_reass_ctx    UIP_CONTEXT_REF(uip_reass_ctx)
+#define uip_reass_clock  UIP_CONTEXT_REF(uip_reass_clock)
+#endif /* UIP_CONTEXTS > 0 */
 
 /* Structures and definitions. */
 #define TCP_FIN 0x01
@@ -171,8 +284,22 @@ static u16_t tmp16;
 #define TCP_OPT_END     0   /* End of TCP options list */
 #define TCP_OPT_NOOP    1   /* "No-operation" TCP option */
 #define TCP_OPT_MSS     2   /* Maximum segment size TCP option */
+#define TCP_OPT_WSCALE  3   /* Window scale TCP option */
+#define TCP_OPT_SACK_PERM 4 /* SACK permitted TCP option */
+#define TCP_OPT_SACK    5   /* SACK TCP option */
 
 #define TCP_OPT_MSS_LEN 4   /* Length of TCP MSS option. */
+#define TCP_OPT_WSCALE_LEN 3 /* Length of TCP window scale option. */
+#define TCP_OPT_SACK_PERM_LEN 2 /* Length of TCP SACK permitted
+				   option. */
+
+/* The largest receive window that can be advertised without window
+   scaling. */
+#if UIP_RECEIVE_WINDOW > 0xffff
+#define TCP_RCV_WND_UNSCALED 0xffff
+#else /* UIP_RECEIVE_WINDOW > 0xffff */
+#define TCP_RCV_WND_UNSCALED (UIP_RECEIVE_WINDOW)
+#endif /* UIP_RECEIVE_WINDOW > 0xffff */
 
 #define ICMP_ECHO_REPLY 0
 #define ICMP_ECHO       8     
@@ -180,13 +307,13 @@ static u16_t tmp16;
 
 /* Macros. */
 #define BUF ((uip_tcpip_hdr *)&uip_buf[UIP_LLH_LEN])
-#define FBUF ((uip_tcpip_hdr *)&uip_reassbuf[0])
+#define FBUF(f) ((uip_tcpip_hdr *)&(f)->buf[0])
 #define ICMPBUF ((uip_icmpip_hdr *)&uip_buf[UIP_LLH_LEN])
 #define UDPBUF ((uip_udpip_hdr *)&uip_buf[UIP_LLH_LEN])
 
 
 #if UIP_STATISTICS == 1
-struct uip_stats uip_stat;
+struct uip_stats UIP_CONTEXT_DECL(uip_stat);
 #define UIP_STAT(s) s
 #else
 #define UIP_STAT(s)
@@ -200,6 +327,559 @@ void uip_log(char *msg);
 #define UIP_LOG(m)
 #endif /* UIP_LOGGING == 1 */
 
+#if UIP_TCP_HASHSIZE > 0
+#define CONNHASH_INSERT(conn) connhash_insert(conn)
+#else
+#define CONNHASH_INSERT(conn)
+#endif /* UIP_TCP_HASHSIZE > 0 */
+
+#if UIP_TCP_WINDOW_SEGS > 1
+#define CANSEND(conn) uip_window_open(conn)
+#else
+#define CANSEND(conn) (!uip_outstanding(conn))
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+
+/*-----------------------------------------------------------------------------------*/
+#if UIP_TCP_HASHSIZE > 0
+static u16_t
+connhash_key(u16_t lport, u16_t rport, u16_t *ripaddr)
+{
+  u16_t h;
+
+  h = lport ^ rport ^ ripaddr[0] ^ ripaddr[1];
+  return (h ^ (h >> 8)) & (UIP_TCP_HASHSIZE - 1);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Unlink a connection from the hash chain given by its current port
+   numbers and remote IP address. Nothing is done if the connection
+   is not in the chain, so this can safely be called for connections
+   that never were hashed. */
+static void
+connhash_remove(struct uip_conn *conn)
+{
+  u16_t *p, i;
+
+  i = (u16_t)(conn - uip_conns) + 1;
+  for(p = &connhash[connhash_key(conn->lport, conn->rport, conn->ripaddr)];
+      *p != 0; p = &connhash_next[*p - 1]) {
+    if(*p == i) {
+      *p = connhash_next[i - 1];
+      return;
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+connhash_insert(struct uip_conn *conn)
+{
+  u16_t *p, i;
+
+  i = (u16_t)(conn - uip_conns);
+  p = &connhash[connhash_key(conn->lport, conn->rport, conn->ripaddr)];
+  connhash_next[i] = *p;
+  *p = i + 1;
+}
+#endif /* UIP_TCP_HASHSIZE > 0 */
+/*-----------------------------------------------------------------------------------*/
+#if UIP_UDP && UIP_UDP_HASHSIZE > 0
+#define UDPHASH_KEY(lport) (((lport) ^ ((lport) >> 8)) & (UIP_UDP_HASHSIZE - 1))
+
+void
+uip_udp_setlport(struct uip_udp_conn *conn, u16_t port)
+{
+  u8_t *p, i;
+
+  i = (u8_t)(conn - uip_udp_conns) + 1;
+
+  /* Unlink the connection from the chain for its old port. */
+  if(conn->lport != 0) {
+    for(p = &udphash[UDPHASH_KEY(conn->lport)];
+	*p != 0; p = &udphash_next[*p - 1]) {
+      if(*p == i) {
+	*p = udphash_next[i - 1];
+	break;
+      }
+    }
+  }
+
+  conn->lport = port;
+
+  /* The chains are kept sorted on the connection index, so that the
+     demultiplexing finds the same connection as a search through the
+     whole table would. */
+  if(port != 0) {
+    for(p = &udphash[UDPHASH_KEY(port)];
+	*p != 0 && *p < i; p = &udphash_next[*p - 1]);
+    udphash_next[i - 1] = *p;
+    *p = i;
+  }
+}
+#endif /* UIP_UDP && UIP_UDP_HASHSIZE > 0 */
+/*-----------------------------------------------------------------------------------*/
+#if UIP_TCP_TIMER_WHEEL
+static void
+wheel_remove(struct uip_conn *conn)
+{
+  u16_t *p, i;
+
+  i = (u16_t)(conn - uip_conns);
+  if(wheel_slot[i] == 0) {
+    return;
+  }
+  for(p = &wheel[wheel_slot[i] - 1]; *p != 0; p = &wheel_next[*p - 1]) {
+    if(*p == i + 1) {
+      *p = wheel_next[i];
+      break;
+    }
+  }
+  wheel_slot[i] = 0;
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+wheel_insert(u16_t i)
+{
+  u16_t expires;
+  u8_t slot;
+
+  expires = wheel_expires[i];
+  if((u16_t)(expires - wheel_now) < WHEEL_L0_SIZE) {
+    slot = expires & (WHEEL_L0_SIZE - 1);
+  } else {
+    slot = WHEEL_L0_SIZE +
+      ((expires >> WHEEL_L0_BITS) & (WHEEL_L1_SIZE - 1));
+  }
+  wheel_next[i] = wheel[slot];
+  wheel[slot] = i + 1;
+  wheel_slot[i] = slot + 1;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Advance the timers of a connection by a number of periodic timer
+   pulses, in the same way as that many calls to uip_periodic() would
+   have done, had the connection not been due at any of them. */
+static void
+wheel_elapse(struct uip_conn *conn, u16_t ticks)
+{
+  if(ticks == 0) {
+    return;
+  }
+  if(conn->tcpstateflags == TIME_WAIT ||
+     conn->tcpstateflags == FIN_WAIT_2) {
+    conn->timer += ticks;
+  } else if(conn->tcpstateflags != CLOSED &&
+	    uip_outstanding(conn)) {
+    conn->timer = conn->timer > ticks? conn->timer - ticks: 0;
+  }
+#if UIP_TCP_DELAYED_ACK > 0
+  if(conn->tcpstateflags & UIP_ACKDELAYED) {
+    conn->acktimer = conn->acktimer > ticks? conn->acktimer - ticks: 1;
+  }
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
+}
+/*-----------------------------------------------------------------------------------*/
+/* Bring the timers of a connection up to date with the current
+   periodic timer pulse. */
+static void
+wheel_sync(struct uip_conn *conn)
+{
+  u16_t i;
+
+  i = (u16_t)(conn - uip_conns);
+  wheel_elapse(conn, wheel_now - wheel_synced[i]);
+  wheel_synced[i] = wheel_now;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Put a connection in the timer wheel slot of the first pulse at
+   which it needs to be processed by uip_periodic(), if any. */
+static void
+wheel_schedule(struct uip_conn *conn)
+{
+  u16_t i, due;
+
+  i = (u16_t)(conn - uip_conns);
+  due = 0;
+  if(conn->tcpstateflags == TIME_WAIT ||
+     conn->tcpstateflags == FIN_WAIT_2) {
+    due = UIP_TIME_WAIT_TIMEOUT - conn->timer;
+  } else if(conn->tcpstateflags != CLOSED) {
+    if(uip_outstanding(conn)) {
+      due = conn->timer + 1;
+    }
+    if((conn->tcpstateflags & TS_MASK) == ESTABLISHED &&
+       CANSEND(conn) &&
+       (due == 0 || due > UIP_TCP_POLL_TICKS)) {
+      due = UIP_TCP_POLL_TICKS;
+    }
+#if UIP_TCP_DELAYED_ACK > 0
+    if((conn->tcpstateflags & UIP_ACKDELAYED) &&
+       (due == 0 || due > conn->acktimer)) {
+      due = conn->acktimer;
+    }
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
+  }
+#if UIP_TCP_SYN_BACKLOG > 0
+  /* A connection that can be reused for a waiting SYN is processed
+     at the next pulse. */
+  if(synq_len > 0) {
+    if(conn->tcpstateflags == CLOSED) {
+      wheel_synced[i] = wheel_now;
+      due = 1;
+    } else if(conn->tcpstateflags == TIME_WAIT) {
+      due = 1;
+    }
+  }
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
+
+  if(due == 0) {
+    wheel_remove(conn);
+    return;
+  }
+  /* A connection is never put in a slot that already has been
+     processed. */
+  due += wheel_synced[i];
+  if((u16_t)(due - wheel_now) == 0 ||
+     (u16_t)(due - wheel_now) > 0x8000) {
+    due = wheel_now + 1;
+  }
+  if(wheel_slot[i] != 0 && wheel_expires[i] == due) {
+    return;
+  }
+  wheel_remove(conn);
+  wheel_expires[i] = due;
+  wheel_insert(i);
+}
+#endif /* UIP_TCP_TIMER_WHEEL */
+/*-----------------------------------------------------------------------------------*/
+#if UIP_TCP_HASHSIZE > 0 || UIP_TCP_WINDOW_SEGS > 1 || UIP_TCP_TIMER_WHEEL
+void
+uip_conn_release(struct uip_conn *conn)
+{
+#if UIP_TCP_WINDOW_SEGS > 1
+  struct uip_tcp_seg *seg;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+  
+#if UIP_TCP_HASHSIZE > 0
+  connhash_remove(conn);
+#endif /* UIP_TCP_HASHSIZE > 0 */
+#if UIP_TCP_WINDOW_SEGS > 1
+  /* Put the unacknowledged segments back on the free list. */
+  while(conn->segs != NULL) {
+    seg = conn->segs;
+    conn->segs = seg->next;
+    seg->next = segs_free;
+    segs_free = seg;
+  }
+  conn->nsegs = 0;
+  conn->wflags = 0;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+#if UIP_TCP_TIMER_WHEEL
+  wheel_remove(conn);
+#endif /* UIP_TCP_TIMER_WHEEL */
+}
+#endif /* UIP_TCP_HASHSIZE > 0 || UIP_TCP_WINDOW_SEGS > 1 ||
+          UIP_TCP_TIMER_WHEEL */
+/*-----------------------------------------------------------------------------------*/
+#if UIP_TCP_WINDOW_SEGS > 1
+u8_t
+uip_window_open(struct uip_conn *conn)
+{
+  /* An empty window is always open, since the retransmission timer
+     will probe a zero window for us. */
+  return segs_free != NULL && conn->nsegs < UIP_TCP_WINDOW_SEGS &&
+    (conn->len == 0 || conn->len + conn->mss <= conn->snd_wnd);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Drop the first len bytes from the retransmission queue of a
+   connection, after they have been acknowledged by the remote
+   host. */
+static void
+segs_ack(struct uip_conn *conn, u16_t len)
+{
+  struct uip_tcp_seg *seg;
+
+  while(len > 0 && (seg = conn->segs) != NULL) {
+    if(len < seg->len) {
+      /* Only a part of the segment was acknowledged. */
+      seg->len -= len;
+      memmove(seg->data, &seg->data[len], seg->len);
+      return;
+    }
+    len -= seg->len;
+    conn->segs = seg->next;
+    seg->next = segs_free;
+    segs_free = seg;
+    --conn->nsegs;
+  }
+}
+#if UIP_TCP_SACK
+/*-----------------------------------------------------------------------------------*/
+/* Mark the segments in the retransmission queue that are covered by
+   the SACK option of the incoming segment. */
+static void
+sack_input(struct uip_conn *conn)
+{
+  struct uip_tcp_seg *seg;
+  u16_t i, n, l, r, off;
+  u8_t *sack;
+
+  for(i = 0; i < (((BUF->tcpoffset >> 4) - 5) << 2);) {
+    sack = &uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + i];
+    if(sack[0] == TCP_OPT_END) {
+      break;
+    } else if(sack[0] == TCP_OPT_NOOP) {
+      ++i;
+      continue;
+    } else if(sack[1] == 0) {
+      break;
+    }
+    if(sack[0] == TCP_OPT_SACK) {
+      /* Each block is the sequence numbers of its left and right
+	 edges, which we make relative to snd_nxt. Blocks that do not
+	 fall within the outstanding data are ignored. */
+      for(n = 2; n + 8 <= sack[1]; n += 8) {
+	l = (((u16_t)sack[n + 2] << 8) | sack[n + 3]) -
+	  (((u16_t)conn->snd_nxt[2] << 8) | conn->snd_nxt[3]);
+	uip_add32(conn->snd_nxt, l);
+	if(sack[n] != uip_acc32[0] || sack[n + 1] != uip_acc32[1]) {
+	  continue;
+	}
+	r = (((u16_t)sack[n + 6] << 8) | sack[n + 7]) -
+	  (((u16_t)conn->snd_nxt[2] << 8) | conn->snd_nxt[3]);
+	uip_add32(conn->snd_nxt, r);
+	if(sack[n + 4] != uip_acc32[0] || sack[n + 5] != uip_acc32[1] ||
+	   l >= r || r > conn->len) {
+	  continue;
+	}
+	off = 0;
+	for(seg = conn->segs; seg != NULL && off < r; seg = seg->next) {
+	  if(off >= l && off + seg->len <= r) {
+	    seg->flags |= UIP_SEG_SACKED;
+	  }
+	  off += seg->len;
+	}
+      }
+    }
+    i += sack[1];
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+/* Find the first segment in the retransmission queue that has not
+   been received by the remote host although a later segment has, and
+   that has not already been retransmitted. The seqoff variable is set
+   to the offset of the segment. */
+static struct uip_tcp_seg *
+sack_lost(struct uip_conn *conn)
+{
+  struct uip_tcp_seg *seg, *lost;
+  u16_t off;
+
+  lost = NULL;
+  off = 0;
+  for(seg = conn->segs; seg != NULL; seg = seg->next) {
+    if(seg->flags & UIP_SEG_SACKED) {
+      if(lost != NULL) {
+	lost->flags |= UIP_SEG_REXMIT;
+	return lost;
+      }
+    } else if(lost == NULL && !(seg->flags & UIP_SEG_REXMIT)) {
+      lost = seg;
+      seqoff = off;
+    }
+    off += seg->len;
+  }
+  seqoff = 0;
+  return NULL;
+}
+#endif /* UIP_TCP_SACK */
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+
+/*-----------------------------------------------------------------------------------*/
+/* Get the MSS to use for the connection that is opened by the SYN
+   or SYNACK in uip_buf, from the TCP MSS option if present. The window
+   scale and SACK permitted options are put in synopts. */
+static u16_t
+tcp_synopts(void)
+{
+  u16_t mss;
+  
+  mss = UIP_TCP_MSS;
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  synopts = 0;
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
+  if((BUF->tcpoffset & 0xf0) > 0x50) {
+    for(c = 0; c < ((BUF->tcpoffset >> 4) - 5) << 2 ;) {
+      opt = uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + c];
+      if(opt == TCP_OPT_END) {
+	/* End of options. */	
+	break;
+      } else if(opt == TCP_OPT_NOOP) {
+	++c;
+	/* NOP option. */
+      } else {
+	/* All other options have a length field, so that we easily
+	   can skip past them. */
+	if(uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == 0) {
+	  /* If the length field is zero, the options are malformed
+	     and we don't process them further. */
+	  break;
+	}
+	if(opt == TCP_OPT_MSS &&
+	   uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == TCP_OPT_MSS_LEN) {
+	  /* An MSS option with the right option length. */	
+	  mss = ((u16_t)uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
+	    (u16_t)uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + 3 + c];
+	  if(mss > UIP_TCP_MSS) {
+	    mss = UIP_TCP_MSS;
+	  }
+#if UIP_TCP_WINDOW_SCALE > 0
+	} else if(opt == TCP_OPT_WSCALE &&
+		  uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] ==
+		  TCP_OPT_WSCALE_LEN) {
+	  /* Shift counts larger than 14 are treated as 14 (RFC 7323,
+	     section 2.3). */
+	  opt = uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c];
+	  synopts |= UIP_TO_WSCALE | (opt > 14? 14: opt);
+#endif /* UIP_TCP_WINDOW_SCALE > 0 */
+#if UIP_TCP_SACK
+	} else if(opt == TCP_OPT_SACK_PERM &&
+		  uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] ==
+		  TCP_OPT_SACK_PERM_LEN) {
+	  synopts |= UIP_TO_SACK;
+#endif /* UIP_TCP_SACK */
+	}
+	c += uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c];
+      }      
+    }
+  }
+  return mss;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Put the TCP options of a SYN or SYNACK in uip_buf, and set the TCP
+   header length accordingly. The window scale and SACK permitted
+   options are included as indicated by tcpopts, of which the lower
+   four bits are the shift count to send. Returns the length of the
+   options. */
+static u8_t
+tcp_putsynopts(u16_t mss, u8_t tcpopts)
+{
+  u8_t *optdata;
+
+  optdata = &uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN];
+  optdata[0] = TCP_OPT_MSS;
+  optdata[1] = TCP_OPT_MSS_LEN;
+  optdata[2] = mss >> 8;
+  optdata[3] = mss & 0xff;
+  optdata += TCP_OPT_MSS_LEN;
+#if UIP_TCP_WINDOW_SCALE > 0
+  if(tcpopts & UIP_TO_WSCALE) {
+    optdata[0] = TCP_OPT_NOOP;
+    optdata[1] = TCP_OPT_WSCALE;
+    optdata[2] = TCP_OPT_WSCALE_LEN;
+    optdata[3] = tcpopts & 0x0f;
+    optdata += 4;
+  }
+#endif /* UIP_TCP_WINDOW_SCALE > 0 */
+#if UIP_TCP_SACK
+  if(tcpopts & UIP_TO_SACK) {
+    optdata[0] = TCP_OPT_NOOP;
+    optdata[1] = TCP_OPT_NOOP;
+    optdata[2] = TCP_OPT_SACK_PERM;
+    optdata[3] = TCP_OPT_SACK_PERM_LEN;
+    optdata += 4;
+  }
+#endif /* UIP_TCP_SACK */
+  c = (u8_t)(optdata - &uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN]);
+  BUF->tcpoffset = ((UIP_TCPH_LEN + c) / 4) << 4;
+  return c;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Get the window that the remote host advertises in the segment in
+   uip_buf. */
+static u16_t
+tcp_wnd(struct uip_conn *conn)
+{
+  u16_t wnd;
+
+  wnd = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+#if UIP_TCP_WINDOW_SCALE > 0
+  /* The window is never scaled in SYN segments. Windows that do not
+     fit in 16 bits are rounded down, since the amount of outstanding
+     data is limited to 16 bits anyway. */
+  if((conn->tcpopts & UIP_TO_WSCALE) && !(BUF->flags & TCP_SYN)) {
+    if(wnd > (0xffff >> (conn->tcpopts & 0x0f))) {
+      wnd = 0xffff;
+    } else {
+      wnd <<= conn->tcpopts & 0x0f;
+    }
+  }
+#endif /* UIP_TCP_WINDOW_SCALE > 0 */
+  return wnd;
+}
+/*-----------------------------------------------------------------------------------*/
+#if UIP_TCP_SYN_BACKLOG > 0
+/* Put the SYN in uip_buf in the SYN backlog. A retransmission of a
+   SYN that already is in the backlog only updates the entry. */
+static void
+synq_put(void)
+{
+  struct synq_entry *e;
+
+  for(e = &synq[0]; e < &synq[synq_len]; ++e) {
+    if(e->rport == BUF->srcport &&
+       e->lport == BUF->destport &&
+       e->ripaddr[0] == BUF->srcipaddr[0] &&
+       e->ripaddr[1] == BUF->srcipaddr[1]) {
+      break;
+    }
+  }
+  if(e == &synq[synq_len]) {
+    if(synq_len == UIP_TCP_SYN_BACKLOG) {
+      UIP_STAT(++uip_stat.tcp.syndrop);
+      UIP_STAT(++uip_stat.tcp.synoverflow);
+      UIP_LOG("tcp: SYN backlog full.");
+      return;
+    }
+    ++synq_len;
+    UIP_STAT(++uip_stat.tcp.synqueued);
+  }
+  e->ripaddr[0] = BUF->srcipaddr[0];
+  e->ripaddr[1] = BUF->srcipaddr[1];
+  e->rport = BUF->srcport;
+  e->lport = BUF->destport;
+  e->seqno[0] = BUF->seqno[0];
+  e->seqno[1] = BUF->seqno[1];
+  e->seqno[2] = BUF->seqno[2];
+  e->seqno[3] = BUF->seqno[3];
+  e->mss = tcp_synopts();
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  e->tcpopts = synopts;
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
+}
+/*-----------------------------------------------------------------------------------*/
+/* Remove the oldest SYN from the SYN backlog and recreate it in
+   uip_buf. */
+static void
+synq_get(void)
+{
+  BUF->srcipaddr[0] = synq[0].ripaddr[0];
+  BUF->srcipaddr[1] = synq[0].ripaddr[1];
+  BUF->srcport = synq[0].rport;
+  BUF->destport = synq[0].lport;
+  BUF->seqno[0] = synq[0].seqno[0];
+  BUF->seqno[1] = synq[0].seqno[1];
+  BUF->seqno[2] = synq[0].seqno[2];
+  BUF->seqno[3] = synq[0].seqno[3];
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  tcp_putsynopts(synq[0].mss, synq[0].tcpopts);
+#else /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
+  tcp_putsynopts(synq[0].mss, 0);
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
+  
+  --synq_len;
+  for(c = 0; c < synq_len; ++c) {
+    synq[c] = synq[c + 1];
+  }
+}
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
 /*-----------------------------------------------------------------------------------*/
 void
 uip_init(void)
@@ -207,9 +887,37 @@ uip_init(void)
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     uip_listenports[c] = 0;
   }
-  for(c = 0; c < UIP_CONNS; ++c) {
-    uip_conns[c].tcpstateflags = CLOSED;
+  for(tmp16 = 0; tmp16 < UIP_CONNS; ++tmp16) {
+    uip_conns[tmp16].tcpstateflags = CLOSED;
+  }
+#if UIP_TCP_HASHSIZE > 0
+  for(tmp16 = 0; tmp16 < UIP_TCP_HASHSIZE; ++tmp16) {
+    connhash[tmp16] = 0;
   }
+#endif /* UIP_TCP_HASHSIZE > 0 */
+#if UIP_TCP_WINDOW_SEGS > 1
+  segs_free = NULL;
+  for(tmp16 = 0; tmp16 < UIP_TCP_REXMIT_SEGS; ++tmp16) {
+    segbufs[tmp16].next = segs_free;
+    segs_free = &segbufs[tmp16];
+  }
+  for(tmp16 = 0; tmp16 < UIP_CONNS; ++tmp16) {
+    uip_conns[tmp16].segs = NULL;
+    uip_conns[tmp16].nsegs = 0;
+    uip_conns[tmp16].wflags = 0;
+  }
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+#if UIP_TCP_TIMER_WHEEL
+  for(tmp16 = 0; tmp16 < WHEEL_L0_SIZE + WHEEL_L1_SIZE; ++tmp16) {
+    wheel[tmp16] = 0;
+  }
+  for(tmp16 = 0; tmp16 < UIP_CONNS; ++tmp16) {
+    wheel_slot[tmp16] = 0;
+  }
+#endif /* UIP_TCP_TIMER_WHEEL */
+#if UIP_TCP_SYN_BACKLOG > 0
+  synq_len = 0;
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
 #if UIP_ACTIVE_OPEN
   lastport = 1024;
 #endif /* UIP_ACTIVE_OPEN */
@@ -218,6 +926,11 @@ uip_init(void)
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     uip_udp_conns[c].lport = 0;
   }
+#if UIP_UDP_HASHSIZE > 0
+  for(c = 0; c < UIP_UDP_HASHSIZE; ++c) {
+    udphash[c] = 0;
+  }
+#endif /* UIP_UDP_HASHSIZE > 0 */
 #endif /* UIP_UDP */
   
 
@@ -244,8 +957,7 @@ uip_connect(u16_t *ripaddr, u16_t rport)
 
   /* Check if this port is already in use, and if so try to find
      another one. */
-  for(c = 0; c < UIP_CONNS; ++c) {
-    conn = &uip_conns[c];
+  for(conn = &uip_conns[0]; conn < &uip_conns[UIP_CONNS]; ++conn) {
     if(conn->tcpstateflags != CLOSED &&
        conn->lport == htons(lastport)) {
       goto again;
@@ -253,13 +965,15 @@ uip_connect(u16_t *ripaddr, u16_t rport)
   }
 
   conn = 0;
-  for(c = 0; c < UIP_CONNS; ++c) {
-    cconn = &uip_conns[c]; 
+  for(cconn = &uip_conns[0]; cconn < &uip_conns[UIP_CONNS]; ++cconn) {
     if(cconn->tcpstateflags == CLOSED) {
       conn = cconn;
       break;
     }
     if(cconn->tcpstateflags == TIME_WAIT) {
+#if UIP_TCP_TIMER_WHEEL
+      wheel_sync(cconn);
+#endif /* UIP_TCP_TIMER_WHEEL */
       if(conn == 0 ||
 	 cconn->timer > conn->timer) {
 	conn = cconn;
@@ -270,6 +984,10 @@ uip_connect(u16_t *ripaddr, u16_t rport)
   if(conn == 0) {
     return 0;
   }
+
+  /* The connection may have been in TIME_WAIT, in which case it still
+     is in the hash table under its old address. */
+  uip_conn_release(conn);
   
   conn->tcpstateflags = SYN_SENT;
 
@@ -279,6 +997,16 @@ uip_connect(u16_t *ripaddr, u16_t rport)
   conn->snd_nxt[3] = iss[3];
 
   conn->initialmss = conn->mss = UIP_TCP_MSS;
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  /* The options that we offer in the SYN. */
+  conn->tcpopts = 0;
+#if UIP_TCP_WINDOW_SCALE > 0
+  conn->tcpopts |= UIP_TO_WSCALE;
+#endif /* UIP_TCP_WINDOW_SCALE > 0 */
+#if UIP_TCP_SACK
+  conn->tcpopts |= UIP_TO_SACK;
+#endif /* UIP_TCP_SACK */
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
   
   conn->len = 1;   /* TCP length of the SYN is one. */
   conn->nrtx = 0;
@@ -290,6 +1018,14 @@ uip_connect(u16_t *ripaddr, u16_t rport)
   conn->rport = rport;
   conn->ripaddr[0] = ripaddr[0];
   conn->ripaddr[1] = ripaddr[1];
+#if UIP_TCP_WINDOW_SEGS > 1
+  conn->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+  CONNHASH_INSERT(conn);
+#if UIP_TCP_TIMER_WHEEL
+  wheel_synced[conn - uip_conns] = wheel_now;
+  wheel_schedule(conn);
+#endif /* UIP_TCP_TIMER_WHEEL */
   
   return conn;
 }
@@ -309,11 +1045,20 @@ uip_udp_new(u16_t *ripaddr, u16_t rport)
     lastport = 4096;
   }
   
+#if UIP_UDP_HASHSIZE > 0
+  for(c = udphash[UDPHASH_KEY(HTONS(lastport))];
+      c != 0; c = udphash_next[c - 1]) {
+    if(uip_udp_conns[c - 1].lport == HTONS(lastport)) {
+      goto again;
+    }
+  }
+#else /* UIP_UDP_HASHSIZE > 0 */
   for(c = 0; c < UIP_UDP_CONNS; ++c) {
     if(uip_udp_conns[c].lport == htons(lastport)) {
       goto again;
     }
   }
+#endif /* UIP_UDP_HASHSIZE > 0 */
 
 
   conn = 0;
@@ -328,7 +1073,7 @@ uip_udp_new(u16_t *ripaddr, u16_t rport)
     return 0;
   }
   
-  conn->lport = HTONS(lastport);
+  uip_udp_bind(conn, HTONS(lastport));
   conn->rport = rport;
   conn->ripaddr[0] = ripaddr[0];
   conn->ripaddr[1] = ripaddr[1];
@@ -340,6 +1085,18 @@ uip_udp_new(u16_t *ripaddr, u16_t rport)
 void
 uip_unlisten(u16_t port)
 {
+#if UIP_TCP_SYN_BACKLOG > 0
+  u8_t i;
+
+  /* SYNs for the port that are waiting in the backlog are
+     forgotten. */
+  for(c = i = 0; c < synq_len; ++c) {
+    if(synq[c].lport != port) {
+      synq[i++] = synq[c];
+    }
+  }
+  synq_len = i;
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
   for(c = 0; c < UIP_LISTENPORTS; ++c) {
     if(uip_listenports[c] == port) {
       uip_listenports[c] = 0;
@@ -362,128 +1119,176 @@ uip_listen(u16_t port)
 /* XXX: IP fragment reassembly: not well-tested. */
 
 #if UIP_REASSEMBLY
-#define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
-static u8_t uip_reassbuf[UIP_REASS_BUFSIZE];
-static u8_t uip_reassbitmap[UIP_REASS_BUFSIZE / (8 * 8)];
+struct uip_reass {
+  u8_t buf[UIP_REASS_BUFSIZE];
+  u8_t bitmap[UIP_REASS_BUFSIZE / (8 * 8) + 1];
+  u16_t len;
+  u16_t used;
+  u8_t flags;
+  u16_t tmr;
+};
+static struct uip_reass UIP_CONTEXT_DECL(uip_reass_ctx)[UIP_REASS_CONTEXTS];
+                             /* The uip_reass_ctx array holds the
+				datagrams that are being reassembled.
+				A context is unused when its timer
+				is zero. */
+static u16_t UIP_CONTEXT_DECL(uip_reass_clock);
+                             /* Incremented for every fragment, used
+				for finding the least recently used
+				context. */
 static const u8_t bitmap_bits[8] = {0xff, 0x7f, 0x3f, 0x1f,
 				    0x0f, 0x07, 0x03, 0x01};
-static u16_t uip_reasslen;
-static u8_t uip_reassflags;
 #define UIP_REASS_FLAG_LASTFRAG 0x01
-static u8_t uip_reasstmr;
 
 #define IP_MF   0x20
 
-static u8_t
+/*-----------------------------------------------------------------------------------*/
+/* Decrease the age timers of all reassembly contexts. */
+static void
+uip_reass_age(void)
+{
+  struct uip_reass *f;
+  
+  for(f = &uip_reass_ctx[0]; f < &uip_reass_ctx[UIP_REASS_CONTEXTS]; ++f) {
+    if(f->tmr != 0) {
+      --f->tmr;
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+static u16_t
 uip_reass(void)
 {
+  struct uip_reass *f, *lru;
   u16_t offset, len;
   u16_t i;
 
-  /* If ip_reasstmr is zero, no packet is present in the buffer, so we
-     write the IP header of the fragment into the reassembly
-     buffer. The timer is updated with the maximum age. */
-  if(uip_reasstmr == 0) {
-    memcpy(uip_reassbuf, &BUF->vhl, UIP_IPH_LEN);
-    uip_reasstmr = UIP_REASS_MAXAGE;
-    uip_reassflags = 0;
-    /* Clear the bitmap. */
-    memset(uip_reassbitmap, 0, sizeof(uip_reassbitmap));
-  }
-
-  /* Check if the incoming fragment matches the one currently present
-     in the reasembly buffer. If so, we proceed with copying the
-     fragment into the buffer. */
-  if(BUF->srcipaddr[0] == FBUF->srcipaddr[0] &&
-     BUF->srcipaddr[1] == FBUF->srcipaddr[1] &&
-     BUF->destipaddr[0] == FBUF->destipaddr[0] &&
-     BUF->destipaddr[1] == FBUF->destipaddr[1] &&
-     BUF->ipid[0] == FBUF->ipid[0] &&
-     BUF->ipid[1] == FBUF->ipid[1]) {
-
-    len = (BUF->len[0] << 8) + BUF->len[1] - (BUF->vhl & 0x0f) * 4;
-    offset = (((BUF->ipoffset[0] & 0x3f) << 8) + BUF->ipoffset[1]) * 8;
-
-    /* If the offset or the offset + fragment length overflows the
-       reassembly buffer, we discard the entire packet. */
-    if(offset > UIP_REASS_BUFSIZE ||
-       offset + len > UIP_REASS_BUFSIZE) {
-      uip_reasstmr = 0;
-      goto nullreturn;
+  /* Find the context that holds the datagram that the incoming
+     fragment belongs to. If there is none, a free context is used,
+     or the one that least recently received a fragment. */
+  ++uip_reass_clock;
+  lru = NULL;
+  for(f = &uip_reass_ctx[0]; f < &uip_reass_ctx[UIP_REASS_CONTEXTS]; ++f) {
+    if(f->tmr == 0) {
+      if(lru == NULL || lru->tmr != 0) {
+	lru = f;
+      }
+    } else if(BUF->srcipaddr[0] == FBUF(f)->srcipaddr[0] &&
+	      BUF->srcipaddr[1] == FBUF(f)->srcipaddr[1] &&
+	      BUF->destipaddr[0] == FBUF(f)->destipaddr[0] &&
+	      BUF->destipaddr[1] == FBUF(f)->destipaddr[1] &&
+	      BUF->ipid[0] == FBUF(f)->ipid[0] &&
+	      BUF->ipid[1] == FBUF(f)->ipid[1] &&
+	      BUF->proto == FBUF(f)->proto) {
+      break;
+    } else if(lru == NULL ||
+	      (lru->tmr != 0 &&
+	       (u16_t)(uip_reass_clock - f->used) >
+	       (u16_t)(uip_reass_clock - lru->used))) {
+      lru = f;
+    }
+  }
+
+  /* If no context matched, we write the IP header of the fragment
+     into the chosen context. The timer is updated with the maximum
+     age. */
+  if(f == &uip_reass_ctx[UIP_REASS_CONTEXTS]) {
+    f = lru;
+    if(f->tmr != 0) {
+      UIP_STAT(++uip_stat.ip.drop);
+      UIP_LOG("ip: reassembly context evicted.");
     }
+    memcpy(f->buf, &BUF->vhl, UIP_IPH_LEN);
+    f->tmr = UIP_REASS_MAXAGE;
+    f->flags = 0;
+    /* Clear the bitmap. */
+    memset(f->bitmap, 0, sizeof(f->bitmap));
+  }
+  f->used = uip_reass_clock;
+
+  len = (BUF->len[0] << 8) + BUF->len[1] - (BUF->vhl & 0x0f) * 4;
+  offset = (((BUF->ipoffset[0] & 0x3f) << 8) + BUF->ipoffset[1]) * 8;
 
-    /* Copy the fragment into the reassembly buffer, at the right
-       offset. */
-    memcpy(&uip_reassbuf[UIP_IPH_LEN + offset],
-	   (char *)BUF + (int)((BUF->vhl & 0x0f) * 4),
-	   len);
+  /* If the offset or the offset + fragment length overflows the
+     reassembly buffer, we discard the entire packet. */
+  if(offset > UIP_REASS_BUFSIZE - UIP_IPH_LEN ||
+     offset + len > UIP_REASS_BUFSIZE - UIP_IPH_LEN) {
+    f->tmr = 0;
+    goto nullreturn;
+  }
+
+  /* Copy the fragment into the reassembly buffer, at the right
+     offset. */
+  memcpy(&f->buf[UIP_IPH_LEN + offset],
+	 (char *)BUF + (int)((BUF->vhl & 0x0f) * 4),
+	 len);
       
-    /* Update the bitmap. */
-    if(offset / (8 * 8) == (offset + len) / (8 * 8)) {
-      /* If the two endpoints are in the same byte, we only update
-	 that byte. */
+  /* Update the bitmap. */
+  if(offset / (8 * 8) == (offset + len) / (8 * 8)) {
+    /* If the two endpoints are in the same byte, we only update
+       that byte. */
 	     
-      uip_reassbitmap[offset / (8 * 8)] |=
-	     bitmap_bits[(offset / 8 ) & 7] &
-	     ~bitmap_bits[((offset + len) / 8 ) & 7];
-    } else {
-      /* If the two endpoints are in different bytes, we update the
-	 bytes in the endpoints and fill the stuff inbetween with
-	 0xff. */
-      uip_reassbitmap[offset / (8 * 8)] |=
-	bitmap_bits[(offset / 8 ) & 7];
-      for(i = 1 + offset / (8 * 8); i < (offset + len) / (8 * 8); ++i) {
-	uip_reassbitmap[i] = 0xff;
-      }      
-      uip_reassbitmap[(offset + len) / (8 * 8)] |=
-	~bitmap_bits[((offset + len) / 8 ) & 7];
-    }
+    f->bitmap[offset / (8 * 8)] |=
+      bitmap_bits[(offset / 8 ) & 7] &
+      ~bitmap_bits[((offset + len) / 8 ) & 7];
+  } else {
+    /* If the two endpoints are in different bytes, we update the
+       bytes in the endpoints and fill the stuff inbetween with
+       0xff. */
+    f->bitmap[offset / (8 * 8)] |=
+      bitmap_bits[(offset / 8 ) & 7];
+    for(i = 1 + offset / (8 * 8); i < (offset + len) / (8 * 8); ++i) {
+      f->bitmap[i] = 0xff;
+    }      
+    f->bitmap[(offset + len) / (8 * 8)] |=
+      ~bitmap_bits[((offset + len) / 8 ) & 7];
+  }
     
-    /* If this fragment has the More Fragments flag set to zero, we
-       know that this is the last fragment, so we can calculate the
-       size of the entire packet. We also set the
-       IP_REASS_FLAG_LASTFRAG flag to indicate that we have received
-       the final fragment. */
-
-    if((BUF->ipoffset[0] & IP_MF) == 0) {
-      uip_reassflags |= UIP_REASS_FLAG_LASTFRAG;
-      uip_reasslen = offset + len;
-    }
+  /* If this fragment has the More Fragments flag set to zero, we
+     know that this is the last fragment, so we can calculate the
+     size of the entire packet. We also set the
+     IP_REASS_FLAG_LASTFRAG flag to indicate that we have received
+     the final fragment. */
+
+  if((BUF->ipoffset[0] & IP_MF) == 0) {
+    f->flags |= UIP_REASS_FLAG_LASTFRAG;
+    f->len = offset + len;
+  }
     
-    /* Finally, we check if we have a full packet in the buffer. We do
-       this by checking if we have the last fragment and if all bits
-       in the bitmap are set. */
-    if(uip_reassflags & UIP_REASS_FLAG_LASTFRAG) {
-      /* Check all bytes up to and including all but the last byte in
-	 the bitmap. */
-      for(i = 0; i < uip_reasslen / (8 * 8) - 1; ++i) {
-	if(uip_reassbitmap[i] != 0xff) {
-	  goto nullreturn;
-	}
-      }
-      /* Check the last byte in the bitmap. It should contain just the
-	 right amount of bits. */
-      if(uip_reassbitmap[uip_reasslen / (8 * 8)] !=
-	 (u8_t)~bitmap_bits[uip_reasslen / 8 & 7]) {
+  /* Finally, we check if we have a full packet in the buffer. We do
+     this by checking if we have the last fragment and if all bits
+     in the bitmap are set. */
+  if(f->flags & UIP_REASS_FLAG_LASTFRAG) {
+    /* Check all bytes up to but not including the last byte in the
+       bitmap. */
+    for(i = 0; i < f->len / (8 * 8); ++i) {
+      if(f->bitmap[i] != 0xff) {
 	goto nullreturn;
       }
-
-      /* If we have come this far, we have a full packet in the
-	 buffer, so we allocate a pbuf and copy the packet into it. We
-	 also reset the timer. */
-      uip_reasstmr = 0;
-      memcpy(BUF, FBUF, uip_reasslen);
-
-      /* Pretend to be a "normal" (i.e., not fragmented) IP packet
-	 from now on. */
-      BUF->ipoffset[0] = BUF->ipoffset[1] = 0;
-      BUF->len[0] = uip_reasslen >> 8;
-      BUF->len[1] = uip_reasslen & 0xff;
-      BUF->ipchksum = 0;
-      BUF->ipchksum = ~(uip_ipchksum());
-
-      return uip_reasslen;
     }
+    /* Check the last byte in the bitmap. It should contain just the
+       right amount of bits. */
+    if(f->bitmap[f->len / (8 * 8)] !=
+       (u8_t)~bitmap_bits[f->len / 8 & 7]) {
+      goto nullreturn;
+    }
+
+    /* If we have come this far, we have a full packet in the
+       buffer, so we copy the packet, including its IP header, into
+       uip_buf and free the context. */
+    f->tmr = 0;
+    len = f->len + UIP_IPH_LEN;
+    memcpy(BUF, FBUF(f), len);
+
+    /* Pretend to be a "normal" (i.e., not fragmented) IP packet
+       from now on. */
+    BUF->ipoffset[0] = BUF->ipoffset[1] = 0;
+    BUF->len[0] = len >> 8;
+    BUF->len[1] = len & 0xff;
+    BUF->ipchksum = 0;
+    BUF->ipchksum = ~(uip_ipchksum());
+
+    return len;
   }
 
  nullreturn:
@@ -501,30 +1306,112 @@ uip_add_rcv_nxt(u16_t n)
   uip_conn->rcv_nxt[3] = uip_acc32[3];
 }
 /*-----------------------------------------------------------------------------------*/
+#if UIP_TCP_TIMER_WHEEL
+void
+uip_wheel_tick(void)
+{
+  u16_t i, n, *p;
+  
+  ++wheel_now;
+
+  /* Increase the initial sequence number. */
+  if(++iss[3] == 0) {
+    if(++iss[2] == 0) {
+      if(++iss[1] == 0) {
+	++iss[0];
+      }
+    }
+  }
+#if UIP_REASSEMBLY
+  uip_reass_age();
+#endif /* UIP_REASSEMBLY */
+
+  /* When the first level of the wheel has gone full circle, the
+     connections in the next slot of the second level are moved down
+     into the first level. */
+  if((wheel_now & (WHEEL_L0_SIZE - 1)) == 0) {
+    p = &wheel[WHEEL_L0_SIZE +
+	       ((wheel_now >> WHEEL_L0_BITS) & (WHEEL_L1_SIZE - 1))];
+    /* The chain is detached from the slot before the connections are
+       reinserted, since a connection that is due a full turn of the
+       second level or more ahead goes back into the same slot. */
+    i = *p;
+    *p = 0;
+    while(i != 0) {
+      n = wheel_next[i - 1];
+      wheel_insert(i - 1);
+      i = n;
+    }
+  }
+}
+/*-----------------------------------------------------------------------------------*/
+struct uip_conn *
+uip_wheel_due(void)
+{
+  u16_t i, *p;
+
+  p = &wheel[wheel_now & (WHEEL_L0_SIZE - 1)];
+  if(*p == 0) {
+    return NULL;
+  }
+  i = *p - 1;
+  *p = wheel_next[i];
+  wheel_slot[i] = 0;
+  return &uip_conns[i];
+}
+#endif /* UIP_TCP_TIMER_WHEEL */
+/*-----------------------------------------------------------------------------------*/
 void
 uip_process(u8_t flag)
 {
   register struct uip_conn *uip_connr = uip_conn;
+#if UIP_TCP_WINDOW_SEGS > 1
+  struct uip_tcp_seg *seg;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
   
   uip_appdata = &uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN];
+#if UIP_TCP_WINDOW_SEGS > 1
+  seqoff = 0;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
 
   /* Check if we were invoked because of a poll request for a
      particular connection. */
   if(flag == UIP_POLL_REQUEST) {
+#if UIP_TCP_TIMER_WHEEL
+    wheel_sync(uip_connr);
+#endif /* UIP_TCP_TIMER_WHEEL */
     if((uip_connr->tcpstateflags & TS_MASK) == ESTABLISHED &&
-       !uip_outstanding(uip_connr)) {
-	uip_flags = UIP_POLL;
-	UIP_APPCALL();
-	goto appsend;      
+       CANSEND(uip_connr)) {
+      goto poll;
     }
+#if UIP_ACTIVE_OPEN
+    /* A connection that has been opened with uip_connect() sends its
+       SYN when it is polled, instead of waiting for the periodic
+       timer. The timers are set up as if the periodic timer had sent
+       it. */
+    if(uip_connr->tcpstateflags == SYN_SENT &&
+       uip_connr->nrtx == 0) {
+      uip_connr->timer = UIP_RTO;
+      uip_connr->nrtx = 1;
+      BUF->flags = 0;
+      goto tcp_send_syn;
+    }
+#endif /* UIP_ACTIVE_OPEN */
     goto drop;
     
     /* Check if we were invoked because of the perodic timer fireing. */
   } else if(flag == UIP_TIMER) {
-#if UIP_REASSEMBLY
-    if(uip_reasstmr != 0) {
-      --uip_reasstmr;
+#if UIP_TCP_TIMER_WHEEL
+    /* The timers of the connection are advanced to the previous
+       pulse, and the processing below takes care of this pulse. */
+    tmp16 = (u16_t)(uip_connr - uip_conns);
+    if(wheel_synced[tmp16] != wheel_now) {
+      wheel_elapse(uip_connr, wheel_now - wheel_synced[tmp16] - 1);
+      wheel_synced[tmp16] = wheel_now;
     }
+#else /* UIP_TCP_TIMER_WHEEL */
+#if UIP_REASSEMBLY
+    uip_reass_age();
 #endif /* UIP_REASSEMBLY */
     /* Increase the initial sequence number. */
     if(++iss[3] == 0) {
@@ -534,6 +1421,17 @@ uip_process(u8_t flag)
 	}
       }
     }    
+#endif /* UIP_TCP_TIMER_WHEEL */
+#if UIP_TCP_SYN_BACKLOG > 0
+    /* A free connection is used for the oldest SYN in the backlog,
+       just as if the SYN had arrived now. */
+    if(synq_len > 0 &&
+       (uip_connr->tcpstateflags == CLOSED ||
+	uip_connr->tcpstateflags == TIME_WAIT)) {
+      synq_get();
+      goto syn_accept;
+    }
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
     uip_len = 0;
     uip_slen = 0;
     if(uip_connr->tcpstateflags == TIME_WAIT ||
@@ -541,6 +1439,7 @@ uip_process(u8_t flag)
       ++(uip_connr->timer);
       if(uip_connr->timer == UIP_TIME_WAIT_TIMEOUT) {
 	uip_connr->tcpstateflags = CLOSED;
+	uip_conn_release(uip_connr);
       }
     } else if(uip_connr->tcpstateflags != CLOSED) {
       /* If the connection has outstanding data, we increase the
@@ -553,6 +1452,7 @@ uip_process(u8_t flag)
 	       uip_connr->tcpstateflags == SYN_RCVD) &&
 	      uip_connr->nrtx == UIP_MAXSYNRTX)) {
 	    uip_connr->tcpstateflags = CLOSED;
+	    uip_conn_release(uip_connr);
 
 	    /* We call UIP_APPCALL() with uip_flags set to
 	       UIP_TIMEDOUT to inform the application that the
@@ -578,6 +1478,27 @@ uip_process(u8_t flag)
 	     SYNACK that we sent earlier and in LAST_ACK we have to
 	     retransmit our FINACK. */
 	  UIP_STAT(++uip_stat.tcp.rexmit);
+#if UIP_TCP_WINDOW_SEGS > 1
+	  /* If there are segments in the retransmission queue, the
+	     oldest one is retransmitted regardless of the state. A
+	     FIN that was sent after them is retransmitted once all
+	     the segments have been acknowledged. */
+	  if(uip_connr->segs != NULL) {
+#if UIP_TCP_SACK
+	    /* Segments that are reported missing may be retransmitted
+	       again after the timeout. */
+	    for(seg = uip_connr->segs; seg != NULL; seg = seg->next) {
+	      seg->flags &= ~UIP_SEG_REXMIT;
+	    }
+#endif /* UIP_TCP_SACK */
+	    seg = uip_connr->segs;
+	  tcp_send_seg:
+	    uip_appdata = seg->data;
+	    uip_len = seg->len + UIP_TCPIP_HLEN;
+	    BUF->flags = TCP_ACK | TCP_PSH;
+	    goto tcp_send_noopts;
+	  }
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
 	  switch(uip_connr->tcpstateflags & TS_MASK) {
 	  case SYN_RCVD:
 	    /* In the SYN_RCVD state, we should retransmit our
@@ -608,16 +1529,53 @@ uip_process(u8_t flag)
 	    
 	  }
 	}
-      } else if((uip_connr->tcpstateflags & TS_MASK) == ESTABLISHED) {
+      }
+#if UIP_TCP_DELAYED_ACK > 0
+      /* If a delayed ACK has timed out, we send it out now unless the
+	 application is about to be polled, in which case the ACK is
+	 sent after the application has had a chance to send data on
+	 which the ACK can be piggybacked. */
+      if((uip_connr->tcpstateflags & UIP_ACKDELAYED) &&
+	 --(uip_connr->acktimer) == 0 &&
+	 !CANSEND(uip_connr)) {
+	goto tcp_send_ack;
+      }
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
+      if((uip_connr->tcpstateflags & TS_MASK) == ESTABLISHED &&
+	 CANSEND(uip_connr)) {
 	/* If there was no need for a retransmission, we poll the
            application for new data. */
+      poll:
+	/* The application may not have anything to send, so the
+	   length of the data it sent the last time must not be used
+	   again. */
+	uip_slen = 0;
+#if UIP_TCP_WINDOW_SEGS > 1
+	/* If the application has had data put in the retransmission
+	   queue, it is told that the data has been acknowledged so
+	   that it may send more. If its data did not fit in the send
+	   window, it is asked to send the same data again. */
+	if(uip_connr->wflags & UIP_WF_ACCEPTED) {
+	  uip_flags = UIP_ACKDATA;
+	} else if(uip_connr->wflags & UIP_WF_REJECTED) {
+	  uip_flags = UIP_REXMIT;
+	} else {
+	  uip_flags = UIP_POLL;
+	}
+	uip_connr->wflags = 0;
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
 	uip_flags = UIP_POLL;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
 	UIP_APPCALL();
 	goto appsend;
       }
     }
     goto drop;
   }
+
+  /* From here on, uip_connr only points to a connection if the
+     packet belongs to one. */
+  uip_connr = NULL;
 #if UIP_UDP 
   if(flag == UIP_UDP_TIMER) {
     if(uip_udp_conn->lport != 0) {
@@ -768,12 +1726,9 @@ uip_process(u8_t flag)
 #endif /* UIP_PINGADDRCONF */  
   
   ICMPBUF->type = ICMP_ECHO_REPLY;
-  
-  if(ICMPBUF->icmpchksum >= HTONS(0xffff - (ICMP_ECHO << 8))) {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8) + 1;
-  } else {
-    ICMPBUF->icmpchksum += HTONS(ICMP_ECHO << 8);
-  }
+  ICMPBUF->icmpchksum = uip_chksum_update(ICMPBUF->icmpchksum,
+					  HTONS(ICMP_ECHO << 8),
+					  HTONS(ICMP_ECHO_REPLY << 8));
   
   /* Swap IP addresses. */
   tmp16 = BUF->destipaddr[0];
@@ -812,9 +1767,17 @@ uip_process(u8_t flag)
 #endif /* UIP_UDP_CHECKSUMS */
 
   /* Demultiplex this UDP packet between the UDP "connections". */
+#if UIP_UDP_HASHSIZE > 0
+  /* Only the connections in the hash chain for the destination port
+     need to be checked. */
+  for(c = udphash[UDPHASH_KEY(UDPBUF->destport)];
+      c != 0; c = udphash_next[c - 1]) {
+    uip_udp_conn = &uip_udp_conns[c - 1];
+#else /* UIP_UDP_HASHSIZE > 0 */
   for(uip_udp_conn = &uip_udp_conns[0];
       uip_udp_conn < &uip_udp_conns[UIP_UDP_CONNS];
       ++uip_udp_conn) {
+#endif /* UIP_UDP_HASHSIZE > 0 */
     /* If the local UDP port is non-zero, the connection is considered
        to be used. If so, the local port number is checked against the
        destination port number in the received packet. If the two port
@@ -894,8 +1857,17 @@ uip_process(u8_t flag)
   
   /* Demultiplex this segment. */
   /* First check any active connections. */
+#if UIP_TCP_HASHSIZE > 0
+  /* Only the connections in the hash chain for this segment's port
+     numbers and source address need to be checked. */
+  for(tmp16 = connhash[connhash_key(BUF->destport, BUF->srcport,
+				    BUF->srcipaddr)];
+      tmp16 != 0; tmp16 = connhash_next[tmp16 - 1]) {
+    uip_connr = &uip_conns[tmp16 - 1];
+#else /* UIP_TCP_HASHSIZE > 0 */
   for(uip_connr = &uip_conns[0]; uip_connr <= &uip_conns[UIP_CONNS - 1];
       ++uip_connr) {
+#endif /* UIP_TCP_HASHSIZE > 0 */
     if(uip_connr->tcpstateflags != CLOSED &&
        BUF->destport == uip_connr->lport &&
        BUF->srcport == uip_connr->rport &&
@@ -904,6 +1876,7 @@ uip_process(u8_t flag)
       goto found;    
     }
   }
+  uip_connr = NULL;
 
   /* If we didn't find and active connection that expected the packet,
      either this packet is an old duplicate, or this is a SYN packet
@@ -991,15 +1964,18 @@ uip_process(u8_t flag)
      CLOSED connections are found. Thanks to Eddie C. Dost for a very
      nice algorithm for the TIME_WAIT search. */
   uip_connr = 0;
-  for(c = 0; c < UIP_CONNS; ++c) {
-    if(uip_conns[c].tcpstateflags == CLOSED) {
-      uip_connr = &uip_conns[c];
+  for(tmp16 = 0; tmp16 < UIP_CONNS; ++tmp16) {
+    if(uip_conns[tmp16].tcpstateflags == CLOSED) {
+      uip_connr = &uip_conns[tmp16];
       break;
     }
-    if(uip_conns[c].tcpstateflags == TIME_WAIT) {
+    if(uip_conns[tmp16].tcpstateflags == TIME_WAIT) {
+#if UIP_TCP_TIMER_WHEEL
+      wheel_sync(&uip_conns[tmp16]);
+#endif /* UIP_TCP_TIMER_WHEEL */
       if(uip_connr == 0 ||
-	 uip_conns[c].timer > uip_connr->timer) {
-	uip_connr = &uip_conns[c];
+	 uip_conns[tmp16].timer > uip_connr->timer) {
+	uip_connr = &uip_conns[tmp16];
       }
     }
   }
@@ -1008,11 +1984,25 @@ uip_process(u8_t flag)
     /* All connections are used already, we drop packet and hope that
        the remote end will retransmit the packet at a time when we
        have more spare connections. */
-    UIP_STAT(++uip_stat.tcp.syndrop);
     UIP_LOG("tcp: found no unused connections.");
+#if UIP_TCP_SYN_BACKLOG > 0
+    /* Unless the SYN can wait in the backlog until a connection is
+       freed. It is only counted as dropped if the backlog is
+       full. */
+    synq_put();
+#else /* UIP_TCP_SYN_BACKLOG > 0 */
+    UIP_STAT(++uip_stat.tcp.syndrop);
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
     goto drop;
   }
+#if UIP_TCP_SYN_BACKLOG > 0
+ syn_accept:
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
   uip_conn = uip_connr;
+
+  /* A reused TIME_WAIT connection must be removed from the hash
+     table before its address is overwritten. */
+  uip_conn_release(uip_connr);
   
   /* Fill in the necessary fields for the new connection. */
   uip_connr->rto = uip_connr->timer = UIP_RTO;
@@ -1024,6 +2014,13 @@ uip_process(u8_t flag)
   uip_connr->ripaddr[0] = BUF->srcipaddr[0];
   uip_connr->ripaddr[1] = BUF->srcipaddr[1];
   uip_connr->tcpstateflags = SYN_RCVD;
+#if UIP_TCP_TIMER_WHEEL
+  wheel_synced[uip_connr - uip_conns] = wheel_now;
+#endif /* UIP_TCP_TIMER_WHEEL */
+#if UIP_TCP_WINDOW_SEGS > 1
+  uip_connr->snd_wnd = UIP_TCP_MSS;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+  CONNHASH_INSERT(uip_connr);
 
   uip_connr->snd_nxt[0] = iss[0];
   uip_connr->snd_nxt[1] = iss[1];
@@ -1038,38 +2035,11 @@ uip_process(u8_t flag)
   uip_connr->rcv_nxt[0] = BUF->seqno[0];
   uip_add_rcv_nxt(1);
 
-  /* Parse the TCP MSS option, if present. */
-  if((BUF->tcpoffset & 0xf0) > 0x50) {
-    for(c = 0; c < ((BUF->tcpoffset >> 4) - 5) << 2 ;) {
-      opt = uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + c];
-      if(opt == TCP_OPT_END) {
-	/* End of options. */	
-	break;
-      } else if(opt == TCP_OPT_NOOP) {
-	++c;
-	/* NOP option. */
-      } else if(opt == TCP_OPT_MSS &&
-		uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == TCP_OPT_MSS_LEN) {
-	/* An MSS option with the right option length. */	
-	tmp16 = ((u16_t)uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
-	  (u16_t)uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + 3 + c];
-	uip_connr->initialmss = uip_connr->mss =
-	  tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
-	
-	/* And we are done processing options. */
-	break;
-      } else {
-	/* All other options have a length field, so that we easily
-	   can skip past them. */
-	if(uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == 0) {
-	  /* If the length field is zero, the options are malformed
-	     and we don't process them further. */
-	  break;
-	}
-	c += uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c];
-      }      
-    }
-  }
+  /* Parse the TCP options, if present. */
+  uip_connr->initialmss = uip_connr->mss = tcp_synopts();
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  uip_connr->tcpopts = synopts;
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
   
   /* Our response will be a SYNACK. */
 #if UIP_ACTIVE_OPEN
@@ -1084,25 +2054,31 @@ uip_process(u8_t flag)
 #endif /* UIP_ACTIVE_OPEN */
   
   /* We send out the TCP Maximum Segment Size option with our
-     SYNACK. */
-  BUF->optdata[0] = TCP_OPT_MSS;
-  BUF->optdata[1] = TCP_OPT_MSS_LEN;
-  BUF->optdata[2] = (UIP_TCP_MSS) / 256;
-  BUF->optdata[3] = (UIP_TCP_MSS) & 255;
-  uip_len = UIP_IPTCPH_LEN + TCP_OPT_MSS_LEN;
-  BUF->tcpoffset = ((UIP_TCPH_LEN + TCP_OPT_MSS_LEN) / 4) << 4;
+     SYNACK, and the window scale and SACK permitted options if the
+     remote host sent them or if we are offering them. */
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  uip_len = UIP_IPTCPH_LEN +
+    tcp_putsynopts(UIP_TCP_MSS, (uip_connr->tcpopts & ~0x0f) |
+		   UIP_TCP_WINDOW_SCALE);
+#else /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
+  uip_len = UIP_IPTCPH_LEN + tcp_putsynopts(UIP_TCP_MSS, 0);
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
   goto tcp_send;
 
   /* This label will be jumped to if we found an active connection. */
  found:
   uip_conn = uip_connr;
   uip_flags = 0;
+#if UIP_TCP_TIMER_WHEEL
+  wheel_sync(uip_connr);
+#endif /* UIP_TCP_TIMER_WHEEL */
   /* We do a very naive form of TCP reset processing; we just accept
      any RST and kill our connection. We should in fact check if the
      sequence number of this reset is wihtin our advertised window
      before we accept the reset. */
   if(BUF->flags & TCP_RST) {
     uip_connr->tcpstateflags = CLOSED;
+    uip_conn_release(uip_connr);
     UIP_LOG("tcp: got reset, aborting connection.");
     uip_flags = UIP_ABORT;
     UIP_APPCALL();
@@ -1135,12 +2111,27 @@ uip_process(u8_t flag)
      the outstanding data, calculate RTT estimations, and reset the
      retransmission timer. */
   if((BUF->flags & TCP_ACK) && uip_outstanding(uip_connr)) {
+#if UIP_TCP_WINDOW_SEGS > 1
+    /* With several segments in flight, the incoming segment may
+       acknowledge only some of them. We find out how much is
+       acknowledged from the lower half of the sequence numbers and
+       check that the upper half matches as well. */
+    tmp16 = (((u16_t)BUF->ackno[2] << 8) | BUF->ackno[3]) -
+      (((u16_t)uip_connr->snd_nxt[2] << 8) | uip_connr->snd_nxt[3]);
+    uip_add32(uip_connr->snd_nxt, tmp16);
+
+    if(tmp16 > 0 && tmp16 <= uip_connr->len &&
+       BUF->ackno[0] == uip_acc32[0] &&
+       BUF->ackno[1] == uip_acc32[1]) {
+      segs_ack(uip_connr, tmp16);
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
     uip_add32(uip_connr->snd_nxt, uip_connr->len);
 
     if(BUF->ackno[0] == uip_acc32[0] &&
        BUF->ackno[1] == uip_acc32[1] &&
        BUF->ackno[2] == uip_acc32[2] &&
        BUF->ackno[3] == uip_acc32[3]) {
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
       /* Update sequence number. */
       uip_connr->snd_nxt[0] = uip_acc32[0];
       uip_connr->snd_nxt[1] = uip_acc32[1];
@@ -1163,17 +2154,43 @@ uip_process(u8_t flag)
 	uip_connr->rto = (uip_connr->sa >> 3) + uip_connr->sv;
 
       }
-      /* Set the acknowledged flag. */
-      uip_flags = UIP_ACKDATA;
       /* Reset the retransmission timer. */
       uip_connr->timer = uip_connr->rto;
 
+#if UIP_TCP_WINDOW_SEGS > 1
+      /* The acknowledged flag is only set when everything has been
+	 acknowledged, since that is what the states that wait for
+	 an ACK of a SYN or a FIN expect. */
+      uip_connr->len -= tmp16;
+      uip_connr->nrtx = 0;
+      if(uip_connr->len == 0) {
+	uip_flags = UIP_ACKDATA;
+      }
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
+      /* Set the acknowledged flag. */
+      uip_flags = UIP_ACKDATA;
+
       /* Reset length of outstanding data. */
       uip_connr->len = 0;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
     }
     
   }
 
+#if UIP_TCP_WINDOW_SEGS > 1
+  /* Remember the window that the remote host advertises, so that we
+     know how many segments we can have in flight. */
+  if(BUF->flags & TCP_ACK) {
+    uip_connr->snd_wnd = tcp_wnd(uip_connr);
+#if UIP_TCP_SACK
+    if(uip_connr->segs != NULL &&
+       (uip_connr->tcpopts & UIP_TO_SACK)) {
+      sack_input(uip_connr);
+    }
+#endif /* UIP_TCP_SACK */
+  }
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+
   /* Do different things depending on in what state the connection is. */
   switch(uip_connr->tcpstateflags & TS_MASK) {
     /* CLOSED and LISTEN are not handled here. CLOSE_WAIT is not
@@ -1207,38 +2224,11 @@ uip_process(u8_t flag)
     if((uip_flags & UIP_ACKDATA) &&
        (BUF->flags & TCP_CTL) == (TCP_SYN | TCP_ACK)) {
 
-      /* Parse the TCP MSS option, if present. */
-      if((BUF->tcpoffset & 0xf0) > 0x50) {
-	for(c = 0; c < ((BUF->tcpoffset >> 4) - 5) << 2 ;) {
-	  opt = uip_buf[UIP_IPTCPH_LEN + UIP_LLH_LEN + c];
-	  if(opt == TCP_OPT_END) {
-	    /* End of options. */	
-	    break;
-	  } else if(opt == TCP_OPT_NOOP) {
-	    ++c;
-	    /* NOP option. */
-	  } else if(opt == TCP_OPT_MSS &&
-		    uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == TCP_OPT_MSS_LEN) {
-	    /* An MSS option with the right option length. */
-	    tmp16 = (uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 2 + c] << 8) |
-	      uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 3 + c];
-	    uip_connr->initialmss =
-	      uip_connr->mss = tmp16 > UIP_TCP_MSS? UIP_TCP_MSS: tmp16;
-
-	    /* And we are done processing options. */
-	    break;
-	  } else {
-	    /* All other options have a length field, so that we easily
-	       can skip past them. */
-	    if(uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c] == 0) {
-	      /* If the length field is zero, the options are malformed
-		 and we don't process them further. */
-	      break;
-	    }
-	    c += uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN + 1 + c];
-	  }      
-	}
-      }
+      /* Parse the TCP options, if present. */
+      uip_connr->initialmss = uip_connr->mss = tcp_synopts();
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+      uip_connr->tcpopts = synopts;
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
       uip_connr->tcpstateflags = ESTABLISHED;      
       uip_connr->rcv_nxt[0] = BUF->seqno[0];
       uip_connr->rcv_nxt[1] = BUF->seqno[1];
@@ -1257,6 +2247,7 @@ uip_process(u8_t flag)
     UIP_APPCALL();
     /* The connection is closed after we send the RST */
     uip_conn->tcpstateflags = CLOSED;
+    uip_conn_release(uip_conn);
     goto reset;
 #endif /* UIP_ACTIVE_OPEN */
     
@@ -1319,6 +2310,19 @@ uip_process(u8_t flag)
     if(uip_len > 0 && !(uip_connr->tcpstateflags & UIP_STOPPED)) {
       uip_flags |= UIP_NEWDATA;
       uip_add_rcv_nxt(uip_len);
+#if UIP_TCP_DELAYED_ACK > 0
+      /* With delayed ACKs, full-sized segments are counted so that
+	 every second one is acknowledged right away. A segment is
+	 taken to be full-sized if it is as large as the MSS of the
+	 connection. */
+      if(uip_len >= uip_connr->initialmss) {
+	if(uip_connr->tcpstateflags & UIP_ACKFULL) {
+	  uip_connr->tcpstateflags |= UIP_ACKNOW;
+	} else {
+	  uip_connr->tcpstateflags |= UIP_ACKFULL;
+	}
+      }
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
     }
 
     /* Check if the available buffer space advertised by the other end
@@ -1332,13 +2336,20 @@ uip_process(u8_t flag)
        of data. This data will not be acknowledged by the receiver,
        and the application will retransmit it. This is called the
        "persistent timer" and uses the retransmission mechanim.
+
+       With a send window, the window is instead checked before each
+       segment is put in the retransmission queue, and the MSS is
+       kept constant so that applications can rely on uip_mss() not
+       changing between sending data and having it acknowledged.
     */
-    tmp16 = ((u16_t)BUF->wnd[0] << 8) + (u16_t)BUF->wnd[1];
+#if UIP_TCP_WINDOW_SEGS <= 1
+    tmp16 = tcp_wnd(uip_connr);
     if(tmp16 > uip_connr->initialmss ||
        tmp16 == 0) {
       tmp16 = uip_connr->initialmss;
     }
     uip_connr->mss = tmp16;
+#endif /* UIP_TCP_WINDOW_SEGS <= 1 */
 
     /* If this packet constitutes an ACK for outstanding data (flagged
        by the UIP_ACKDATA flag, we should call the application since it
@@ -1356,6 +2367,29 @@ uip_process(u8_t flag)
        put into the uip_appdata and the length of the data should be
        put into uip_len. If the application don't have any data to
        send, uip_len must be set to 0. */
+#if UIP_TCP_SACK
+    /* If the remote host has received later segments but not the
+       first segment that it has not acknowledged, that segment is
+       retransmitted at once instead of waiting for the
+       retransmission timer. The application is asked for new data
+       when the remote host acknowledges the segment. */
+    if(uip_len == 0 && (seg = sack_lost(uip_connr)) != NULL) {
+      UIP_STAT(++uip_stat.tcp.rexmit);
+      goto tcp_send_seg;
+    }
+#endif /* UIP_TCP_SACK */
+#if UIP_TCP_WINDOW_SEGS > 1
+    /* With a send window, the application has been told about
+       acknowledged data already when its data was put in the
+       retransmission queue. It is instead told that its data has
+       been acknowledged once there is room for another segment. */
+    uip_flags &= ~UIP_ACKDATA;
+    if((uip_connr->wflags & UIP_WF_ACCEPTED) &&
+       uip_window_open(uip_connr)) {
+      uip_flags |= UIP_ACKDATA;
+      uip_connr->wflags &= ~UIP_WF_ACCEPTED;
+    }
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
     if(uip_flags & (UIP_NEWDATA | UIP_ACKDATA)) {
       uip_slen = 0;
       UIP_APPCALL();
@@ -1365,13 +2399,21 @@ uip_process(u8_t flag)
       if(uip_flags & UIP_ABORT) {
 	uip_slen = 0;
 	uip_connr->tcpstateflags = CLOSED;
+	uip_conn_release(uip_connr);
 	BUF->flags = TCP_RST | TCP_ACK;
 	goto tcp_send_nodata;
       }
 
       if(uip_flags & UIP_CLOSE) {
 	uip_slen = 0;
+#if UIP_TCP_WINDOW_SEGS > 1
+	/* The FIN is sent after any segments that still are in the
+	   retransmission queue. */
+	seqoff = uip_connr->len;
+	uip_connr->len += 1;
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
 	uip_connr->len = 1;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
 	uip_connr->tcpstateflags = FIN_WAIT_1;
 	uip_connr->nrtx = 0;
 	BUF->flags = TCP_FIN | TCP_ACK;
@@ -1380,6 +2422,40 @@ uip_process(u8_t flag)
 
       /* If uip_slen > 0, the application has data to be sent. */
       if(uip_slen > 0) {
+#if UIP_TCP_WINDOW_SEGS > 1
+	struct uip_tcp_seg **segp;
+
+	if(uip_slen > uip_connr->mss) {
+	  uip_slen = uip_connr->mss;
+	}
+	
+	if(!uip_window_open(uip_connr)) {
+	  /* There is no room for the data, so it is dropped and the
+	     application will be asked to send it again later. */
+	  uip_connr->wflags = UIP_WF_REJECTED;
+	  uip_slen = 0;
+	} else {
+	  /* Copy the data into a retransmission buffer and put it
+	     last in the retransmission queue. The segment follows
+	     directly after the data that already is in flight. */
+	  seg = segs_free;
+	  segs_free = seg->next;
+	  seg->next = NULL;
+	  seg->len = uip_slen;
+#if UIP_TCP_SACK
+	  seg->flags = 0;
+#endif /* UIP_TCP_SACK */
+	  memcpy(seg->data, uip_sappdata, uip_slen);
+	  for(segp = &uip_connr->segs; *segp != NULL; segp = &(*segp)->next);
+	  *segp = seg;
+	  ++uip_connr->nsegs;
+	  
+	  seqoff = uip_connr->len;
+	  uip_connr->len += uip_slen;
+	  uip_connr->wflags = UIP_WF_ACCEPTED;
+	}
+      }
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
 
 	/* If the connection has acknowledged data, the contents of
 	   the ->len variable should be discarded. */ 
@@ -1411,6 +2487,7 @@ uip_process(u8_t flag)
 	}
       }
       uip_connr->nrtx = 0;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
     apprexmit:
       uip_appdata = uip_sappdata;
       
@@ -1418,7 +2495,11 @@ uip_process(u8_t flag)
          packet had new data in it, we must send out a packet. */
       if(uip_slen > 0 && uip_connr->len > 0) {
 	/* Add the length of the IP and TCP headers. */
+#if UIP_TCP_WINDOW_SEGS > 1
+	uip_len = uip_slen + UIP_TCPIP_HLEN;
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
 	uip_len = uip_connr->len + UIP_TCPIP_HLEN;
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
 	/* We always set the ACK flag in response packets. */
 	BUF->flags = TCP_ACK | TCP_PSH;
 	/* Send the packet. */
@@ -1427,10 +2508,33 @@ uip_process(u8_t flag)
       /* If there is no data to send, just send out a pure ACK if
 	 there is newdata. */
       if(uip_flags & UIP_NEWDATA) {
+#if UIP_TCP_DELAYED_ACK > 0
+	/* With delayed ACKs, only every second full-sized segment is
+	   acknowledged right away. The ACK for other segments is sent
+	   when the delayed ACK timer, started by the first of them,
+	   expires, or together with the next packet that we send. */
+	if(!(uip_connr->tcpstateflags & UIP_ACKDELAYED)) {
+	  uip_connr->tcpstateflags |= UIP_ACKDELAYED;
+	  uip_connr->acktimer = UIP_TCP_DELAYED_ACK;
+	}
+	if(!(uip_connr->tcpstateflags & UIP_ACKNOW)) {
+	  goto drop;
+	}
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
+	uip_len = UIP_TCPIP_HLEN;
+	BUF->flags = TCP_ACK;
+	goto tcp_send_noopts;
+      }
+#if UIP_TCP_DELAYED_ACK > 0
+      /* If we were polled because of an expired delayed ACK and the
+	 application had nothing to send, we send a pure ACK. */
+      if((uip_connr->tcpstateflags & UIP_ACKDELAYED) &&
+	 uip_connr->acktimer == 0) {
 	uip_len = UIP_TCPIP_HLEN;
 	BUF->flags = TCP_ACK;
 	goto tcp_send_noopts;
       }
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
     }
     goto drop;
   case LAST_ACK:
@@ -1438,6 +2542,7 @@ uip_process(u8_t flag)
        FIN. This is indicated by the UIP_ACKDATA flag. */     
     if(uip_flags & UIP_ACKDATA) {
       uip_connr->tcpstateflags = CLOSED;
+      uip_conn_release(uip_connr);
       uip_flags = UIP_CLOSE;
       UIP_APPCALL();
     }
@@ -1518,11 +2623,23 @@ uip_process(u8_t flag)
   BUF->ackno[1] = uip_connr->rcv_nxt[1];
   BUF->ackno[2] = uip_connr->rcv_nxt[2];
   BUF->ackno[3] = uip_connr->rcv_nxt[3];
+#if UIP_TCP_DELAYED_ACK > 0
+  /* Any pending ACK is piggybacked on this packet. */
+  uip_connr->tcpstateflags &= ~(UIP_ACKDELAYED | UIP_ACKFULL | UIP_ACKNOW);
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
   
+#if UIP_TCP_WINDOW_SEGS > 1
+  uip_add32(uip_connr->snd_nxt, seqoff);
+  BUF->seqno[0] = uip_acc32[0];
+  BUF->seqno[1] = uip_acc32[1];
+  BUF->seqno[2] = uip_acc32[2];
+  BUF->seqno[3] = uip_acc32[3];
+#else /* UIP_TCP_WINDOW_SEGS > 1 */
   BUF->seqno[0] = uip_connr->snd_nxt[0];
   BUF->seqno[1] = uip_connr->snd_nxt[1];
   BUF->seqno[2] = uip_connr->snd_nxt[2];
   BUF->seqno[3] = uip_connr->snd_nxt[3];
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
 
   BUF->proto = UIP_PROTO_TCP;
   
@@ -1539,9 +2656,15 @@ uip_process(u8_t flag)
     /* If the connection has issued uip_stop(), we advertise a zero
        window so that the remote host will stop sending data. */
     BUF->wnd[0] = BUF->wnd[1] = 0;
+#if UIP_TCP_WINDOW_SCALE > 0
+  } else if((uip_connr->tcpopts & UIP_TO_WSCALE) &&
+	    !(BUF->flags & TCP_SYN)) {
+    BUF->wnd[0] = ((UIP_RECEIVE_WINDOW >> UIP_TCP_WINDOW_SCALE) >> 8);
+    BUF->wnd[1] = ((UIP_RECEIVE_WINDOW >> UIP_TCP_WINDOW_SCALE) & 0xff);
+#endif /* UIP_TCP_WINDOW_SCALE > 0 */
   } else {
-    BUF->wnd[0] = ((UIP_RECEIVE_WINDOW) >> 8);
-    BUF->wnd[1] = ((UIP_RECEIVE_WINDOW) & 0xff); 
+    BUF->wnd[0] = ((TCP_RCV_WND_UNSCALED) >> 8);
+    BUF->wnd[1] = ((TCP_RCV_WND_UNSCALED) & 0xff); 
   }
 
  tcp_send_noconn:
@@ -1573,10 +2696,22 @@ uip_process(u8_t flag)
  send:
   
   UIP_STAT(++uip_stat.ip.sent);
+#if UIP_TCP_TIMER_WHEEL
+  /* The timers of the connection may have changed, so it may have
+     to be moved to another slot in the timer wheel. */
+  if(uip_connr != NULL) {
+    wheel_schedule(uip_connr);
+  }
+#endif /* UIP_TCP_TIMER_WHEEL */
   /* Return and let the caller do the actual transmission. */
   return;
  drop:
   uip_len = 0;
+#if UIP_TCP_TIMER_WHEEL
+  if(uip_connr != NULL) {
+    wheel_schedule(uip_connr);
+  }
+#endif /* UIP_TCP_TIMER_WHEEL */
   return;
 }
 /*-----------------------------------------------------------------------------------*/
@@ -1586,4 +2721,23 @@ htons(u16_t val)
   return HTONS(val);
 }
 /*-----------------------------------------------------------------------------------*/
+u16_t
+uip_chksum_update(u16_t chksum, u16_t oldval, u16_t newval)
+{
+  u16_t sum;
+
+  /* HC' = ~(~HC + ~m + m'), with end-around carry (RFC 1624, eqn. 3). */
+  sum = ~chksum;
+  oldval = ~oldval;
+  sum += oldval;
+  if(sum < oldval) {
+    ++sum;
+  }
+  sum += newval;
+  if(sum < newval) {
+    ++sum;
+  }
+  return ~sum;
+}
+/*-----------------------------------------------------------------------------------*/
 /** @} */
@@ -296,6 +296,37 @@ void uip_init(void);
 #define uip_poll_conn(conn) do { uip_conn = conn; \
                                  uip_process(UIP_POLL_REQUEST); } while (0)
 
+#if UIP_TCP_TIMER_WHEEL
+/**
+ * Advance the TCP timer wheel by one periodic timer pulse.
+ *
+ * When uIP is configured with UIP_TCP_TIMER_WHEEL, this function
+ * should be called instead of calling uip_periodic() for every
+ * connection. It is followed by calls to uip_wheel_due() that return
+ * the connections whose timers have expired, each of which should be
+ * processed with uip_periodic_conn():
+ \code
+  uip_wheel_tick();
+  while((conn = uip_wheel_due()) != NULL) {
+    uip_periodic_conn(conn);
+    if(uip_len > 0) {
+      devicedriver_send();
+    }
+  }
+ \endcode
+ */
+void uip_wheel_tick(void);
+
+/**
+ * Get the next connection that is due for periodic processing.
+ *
+ * \return A pointer to a connection that should be processed with
+ * uip_periodic_conn(), or NULL if no more connections are due at the
+ * current periodic timer pulse.
+ */
+struct uip_conn *uip_wheel_due(void);
+#endif /* UIP_TCP_TIMER_WHEEL */
+
 
 #if UIP_UDP
 /**
@@ -378,7 +409,7 @@ void uip_init(void);
  }
  \endcode
  */
-extern u8_t uip_buf[UIP_BUFSIZE+2];
+extern UIP_CONTEXT_TLS u8_t uip_buf[UIP_BUFSIZE+2];
 
 /** @} */
 
@@ -470,6 +501,52 @@ struct uip_conn *uip_connect(u16_t *ripaddr, u16_t port);
  */
 #define uip_outstanding(conn) ((conn)->len)
 
+#if UIP_TCP_WINDOW_SEGS > 1
+/**
+ * \internal
+ *
+ * Check if a connection has room for another segment in its send
+ * window.
+ *
+ * \param conn A pointer to the uip_conn structure for the connection.
+ *
+ * \return Non-zero if another segment can be sent.
+ */
+u8_t uip_window_open(struct uip_conn *conn);
+
+/**
+ * \internal
+ *
+ * Check if the application should be polled for more data in order
+ * to fill up the send window of a connection.
+ *
+ * \param conn A pointer to the uip_conn structure for the connection.
+ *
+ * \hideinitializer
+ */
+#define uip_window_fill(conn) (((conn)->wflags & (UIP_WF_ACCEPTED | \
+                                                  UIP_WF_REJECTED)) && \
+                               ((conn)->tcpstateflags & TS_MASK) == \
+                               ESTABLISHED && uip_window_open(conn))
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+
+#if UIP_TCP_HASHSIZE > 0 || UIP_TCP_WINDOW_SEGS > 1 || UIP_TCP_TIMER_WHEEL
+/**
+ * \internal
+ *
+ * Release the resources held by a connection that has been closed.
+ *
+ * This function must be called whenever a connection is moved to the
+ * CLOSED state outside of uIP itself.
+ *
+ * \param conn A pointer to the uip_conn structure for the connection.
+ */
+void uip_conn_release(struct uip_conn *conn);
+#else
+#define uip_conn_release(conn)
+#endif /* UIP_TCP_HASHSIZE > 0 || UIP_TCP_WINDOW_SEGS > 1 ||
+          UIP_TCP_TIMER_WHEEL */
+
 /**
  * Send data on the current connection.
  *
@@ -715,7 +792,11 @@ struct uip_udp_conn *uip_udp_new(u16_t *ripaddr, u16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_UDP_HASHSIZE > 0
+#define uip_udp_remove(conn) uip_udp_setlport(conn, 0)
+#else /* UIP_UDP_HASHSIZE > 0 */
 #define uip_udp_remove(conn) (conn)->lport = 0
+#endif /* UIP_UDP_HASHSIZE > 0 */
 
 /**
  * Bind a UDP connection to a local port.
@@ -727,7 +808,28 @@ struct uip_udp_conn *uip_udp_new(u16_t *ripaddr, u16_t rport);
  *
  * \hideinitializer
  */
+#if UIP_UDP_HASHSIZE > 0
+#define uip_udp_bind(conn, port) uip_udp_setlport(conn, port)
+#else /* UIP_UDP_HASHSIZE > 0 */
 #define uip_udp_bind(conn, port) (conn)->lport = port
+#endif /* UIP_UDP_HASHSIZE > 0 */
+
+#if UIP_UDP_HASHSIZE > 0
+/**
+ * Change the local port of a UDP connection and move it to the
+ * right chain in the UDP port hash table.
+ *
+ * This function is used by uip_udp_bind() and uip_udp_remove() when
+ * UIP_UDP_HASHSIZE is set, and should not be called directly.
+ *
+ * \param conn A pointer to the uip_udp_conn structure for the
+ * connection.
+ *
+ * \param port The new local port number in network byte order, or 0
+ * to remove the connection.
+ */
+void uip_udp_setlport(struct uip_udp_conn *conn, u16_t port);
+#endif /* UIP_UDP_HASHSIZE > 0 */
 
 /**
  * Send a UDP datagram of length len on the current connection.
@@ -990,6 +1092,35 @@ struct uip_udp_conn *uip_udp_new(u16_t *ripaddr, u16_t rport);
  */
 u16_t htons(u16_t val);
 
+/**
+ * Incrementally update an Internet checksum.
+ *
+ * This function adjusts a checksum when a 16-bit word in the data
+ * that the checksum covers is changed, without having to recompute
+ * the checksum over all of the data (RFC 1624). Several words are
+ * changed by calling the function once for each word. A part of the
+ * data can be removed from the checksum by passing the one's
+ * complement sum of that part, as computed by uip_chksum(), as the
+ * old value and zero as the new value.
+ *
+ * Both the checksum and the words are given as they appear in the
+ * packet, i.e., in network byte order.
+ *
+ \code
+ BUF->ttl = BUF->ttl - 1;
+ BUF->ipchksum = uip_chksum_update(BUF->ipchksum,
+                                   HTONS(((BUF->ttl + 1) << 8) | BUF->proto),
+                                   HTONS((BUF->ttl << 8) | BUF->proto));
+ \endcode
+ *
+ * \param chksum The checksum field of the packet before the change.
+ * \param oldval The old value of the word that was changed.
+ * \param newval The new value of the word.
+ *
+ * \return The new value of the checksum field.
+ */
+u16_t uip_chksum_update(u16_t chksum, u16_t oldval, u16_t newval);
+
 /** @} */
 
 /**
@@ -999,8 +1130,8 @@ u16_t htons(u16_t val);
  * called. If the application wishes to send data, the application may
  * use this space to write the data into before calling uip_send().
  */
-extern u8_t *uip_appdata;
-extern u8_t *uip_sappdata; 
+extern UIP_CONTEXT_TLS u8_t *uip_appdata;
+extern UIP_CONTEXT_TLS u8_t *uip_sappdata; 
 
 #if UIP_URGDATA > 0 
 /* u8_t *uip_urgdata:
@@ -1008,7 +1139,7 @@ extern u8_t *uip_sappdata;
  * This pointer points to any urgent data that has been received. Only
  * present if compiled with support for urgent data (UIP_URGDATA).
  */
-extern u8_t *uip_urgdata; 
+extern UIP_CONTEXT_TLS u8_t *uip_urgdata; 
 #endif /* UIP_URGDATA > 0 */
 
 
@@ -1021,10 +1152,10 @@ extern u8_t *uip_urgdata;
  * output function is called, uip_len should contain the length of the
  * outgoing packet.
  */
-extern u16_t uip_len, uip_slen;
+extern UIP_CONTEXT_TLS u16_t uip_len, uip_slen;
 
 #if UIP_URGDATA > 0 
-extern u8_t uip_urglen, uip_surglen;
+extern UIP_CONTEXT_TLS u8_t uip_urglen, uip_surglen;
 #endif /* UIP_URGDATA > 0 */
 
 
@@ -1063,6 +1194,19 @@ struct uip_conn {
   u8_t timer;         /**< The retransmission timer. */
   u8_t nrtx;          /**< The number of retransmissions for the last
 			 segment sent. */
+#if UIP_TCP_WINDOW_SEGS > 1
+  struct uip_tcp_seg *segs; /**< The unacknowledged segments, oldest
+			       first. */
+  u16_t snd_wnd;      /**< The window advertised by the remote host. */
+  u8_t nsegs;         /**< The number of unacknowledged segments. */
+  u8_t wflags;        /**< Send window flags. */
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+#if UIP_TCP_DELAYED_ACK > 0
+  u8_t acktimer;      /**< The delayed ACK timer. */
+#endif /* UIP_TCP_DELAYED_ACK > 0 */
+#if UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK
+  u8_t tcpopts;       /**< The TCP options in use. */
+#endif /* UIP_TCP_WINDOW_SCALE > 0 || UIP_TCP_SACK */
 
   /** The application state. */
   u8_t appstate[UIP_APPSTATE_SIZE];  
@@ -1070,9 +1214,9 @@ struct uip_conn {
 
 
 /* Pointer to the current connection. */
-extern struct uip_conn *uip_conn;
+extern UIP_CONTEXT_TLS struct uip_conn *uip_conn;
 /* The array containing all uIP connections. */
-extern struct uip_conn uip_conns[UIP_CONNS];
+extern struct uip_conn UIP_CONTEXT_DECL(uip_conns)[UIP_CONNS];
 /**
  * \addtogroup uiparch
  * @{
@@ -1081,7 +1225,7 @@ extern struct uip_conn uip_conns[UIP_CONNS];
 /**
  * 4-byte array used for the 32-bit sequence number calculations.
  */
-extern u8_t uip_acc32[4];
+extern UIP_CONTEXT_TLS u8_t uip_acc32[4];
 
 /** @} */
 
@@ -1099,8 +1243,8 @@ struct uip_udp_conn {
   u8_t appstate[UIP_APPSTATE_SIZE];    
 };
 
-extern struct uip_udp_conn *uip_udp_conn;
-extern struct uip_udp_conn uip_udp_conns[UIP_UDP_CONNS];
+extern UIP_CONTEXT_TLS struct uip_udp_conn *uip_udp_conn;
+extern struct uip_udp_conn UIP_CONTEXT_DECL(uip_udp_conns)[UIP_UDP_CONNS];
 #endif /* UIP_UDP */
 
 /**
@@ -1147,9 +1291,16 @@ struct uip_stats {
     uip_stats_t rst;      /**< Number of recevied TCP RST (reset) segments. */
     uip_stats_t rexmit;   /**< Number of retransmitted TCP segments. */
     uip_stats_t syndrop;  /**< Number of dropped SYNs due to too few
-			     connections was avaliable. */
+			     connections was avaliable, and no room in
+			     the SYN backlog. */
     uip_stats_t synrst;   /**< Number of SYNs for closed ports,
 			     triggering a RST. */
+#if UIP_TCP_SYN_BACKLOG > 0
+    uip_stats_t synqueued; /**< Number of SYNs put in the SYN
+			      backlog. */
+    uip_stats_t synoverflow; /**< Number of SYNs dropped because
+				the SYN backlog was full. */
+#endif /* UIP_TCP_SYN_BACKLOG > 0 */
   } tcp;                  /**< TCP statistics. */
 };
 
@@ -1158,7 +1309,7 @@ struct uip_stats {
  *
  * This is the variable in which the uIP TCP/IP statistics are gathered.
  */
-extern struct uip_stats uip_stat;
+extern struct uip_stats UIP_CONTEXT_DECL(uip_stat);
 
 
 /*-----------------------------------------------------------------------------------*/
@@ -1172,7 +1323,7 @@ extern struct uip_stats uip_stat;
  * that are defined in this file. Please read below for more
  * infomation.
  */
-extern u8_t uip_flags;
+extern UIP_CONTEXT_TLS u8_t uip_flags;
 
 /* The following flags may be set in the global variable uip_flags
    before calling the application callback. The UIP_ACKDATA and
@@ -1248,9 +1399,49 @@ void uip_process(u8_t flag);
 #define TS_MASK     15
   
 #define UIP_STOPPED      16
+#define UIP_ACKDELAYED   32
+#define UIP_ACKFULL      64
+#define UIP_ACKNOW       128
 
 #define UIP_TCPIP_HLEN 40
 
+/* Flags in the tcpopts field of the uip_conn structure. */
+#define UIP_TO_WSCALE   0x10 /* Window scaling is used. The lower four
+				bits hold the shift count of the remote
+				host. */
+#define UIP_TO_SACK     0x20 /* The remote host sends selective
+				acknowledgments. */
+
+#if UIP_TCP_WINDOW_SEGS > 1
+/**
+ * \internal
+ *
+ * A TCP segment that has been sent but not yet acknowledged. The
+ * segments are allocated from a pool that is shared by all
+ * connections.
+ */
+struct uip_tcp_seg {
+  struct uip_tcp_seg *next; /**< The next segment in the queue. */
+  u16_t len;                /**< The length of the segment data. */
+#if UIP_TCP_SACK
+  u8_t flags;               /**< Selective acknowledgment flags. */
+#endif /* UIP_TCP_SACK */
+  u8_t data[UIP_TCP_MSS];   /**< The segment data. */
+};
+
+/* Flags in the flags field of the uip_tcp_seg structure. */
+#define UIP_SEG_SACKED  1   /* The remote host has received the
+			       segment. */
+#define UIP_SEG_REXMIT  2   /* The segment has been retransmitted
+			       since it was reported missing. */
+
+/* Flags in the wflags field of the uip_conn structure. */
+#define UIP_WF_ACCEPTED 1   /* The last data sent by the application
+			       was put in the retransmission queue. */
+#define UIP_WF_REJECTED 2   /* The last data sent by the application
+			       did not fit in the send window. */
+#endif /* UIP_TCP_WINDOW_SEGS > 1 */
+
 /**
  * The buffer size available for user data in the \ref uip_buf buffer.
  *
@@ -1351,7 +1542,8 @@ typedef struct {
 #if UIP_FIXEDADDR
 extern const u16_t uip_hostaddr[2], uip_netmask[2], uip_draddr[2];
 #else /* UIP_FIXEDADDR */
-extern u16_t uip_hostaddr[2], uip_netmask[2], uip_draddr[2];
+extern u16_t UIP_CONTEXT_DECL(uip_hostaddr)[2],
+  UIP_CONTEXT_DECL(uip_netmask)[2], UIP_CONTEXT_DECL(uip_draddr)[2];
 #endif /* UIP_FIXEDADDR */
 
 
@@ -1363,6 +1555,55 @@ struct uip_eth_addr {
   u8_t addr[6];
 };
 
+#if UIP_CONTEXTS > 0
+/**
+ * The stack that is currently used by uIP.
+ *
+ * This variable is only present if UIP_CONTEXTS is set. It should
+ * only be changed with uip_setcontext().
+ */
+extern UIP_CONTEXT_TLS u8_t uip_context;
+
+/**
+ * Select the stack that is to be used by uIP.
+ *
+ * All calls into uIP, as well as the uip_conns, uip_hostaddr and
+ * other state variables, refer to the selected stack until another
+ * stack is selected. The stacks are numbered from 0 to
+ * UIP_CONTEXTS - 1, and stack 0 is selected initially.
+ *
+ * \note This macro is only available if UIP_CONTEXTS is set, and it
+ * must not be used while a stack is in the middle of a call. Each
+ * stack must be initialized with uip_init() after it has been
+ * selected.
+ *
+ * \param n The number of the stack.
+ *
+ * \hideinitializer
+ */
+#define uip_setcontext(n) (uip_context = (n))
+
+/**
+ * Get the number of the stack that is currently used by uIP.
+ *
+ * \hideinitializer
+ */
+#define uip_getcontext() uip_context
+
+#define uip_conns        UIP_CONTEXT_REF(uip_conns)
+#define uip_listenports  UIP_CONTEXT_REF(uip_listenports)
+#define uip_udp_conns    UIP_CONTEXT_REF(uip_udp_conns)
+#define uip_stat         UIP_CONTEXT_REF(uip_stat)
+#if !UIP_FIXEDADDR
+#define uip_hostaddr     UIP_CONTEXT_REF(uip_hostaddr)
+#define uip_draddr       UIP_CONTEXT_REF(uip_draddr)
+#define uip_netmask      UIP_CONTEXT_REF(uip_netmask)
+#endif /* !UIP_FIXEDADDR */
+#if !UIP_FIXEDETHADDR
+#define uip_ethaddr      UIP_CONTEXT_REF(uip_ethaddr)
+#endif /* !UIP_FIXEDETHADDR */
+#endif /* UIP_CONTEXTS > 0 */
+
 #endif /* __UIP_H__ */
 
 
@@ -100,22 +100,175 @@ struct arp_entry {
   u16_t ipaddr[2];
   struct uip_eth_addr ethaddr;
   u8_t time;
+#if UIP_ARP_HASHSIZE > 0
+  u16_t used;
+#endif /* UIP_ARP_HASHSIZE > 0 */
 };
 
+#if UIP_ARP_QUEUE > 0
+struct arp_pkt {
+  u16_t ipaddr[2];      /* The next hop that is being resolved. */
+  u16_t len;            /* The length of the IP packet, or 0 if the
+			   slot is unused. */
+  u8_t time, seq;
+  u8_t data[UIP_BUFSIZE - UIP_LLH_LEN];
+};
+#endif /* UIP_ARP_QUEUE > 0 */
+
 static const struct uip_eth_addr broadcast_ethaddr =
   {{0xff,0xff,0xff,0xff,0xff,0xff}};
 static const u16_t broadcast_ipaddr[2] = {0xffff,0xffff};
 
-static struct arp_entry arp_table[UIP_ARPTAB_SIZE];
-static u16_t ipaddr[2];
-static u8_t i, c;
-
-static u8_t arptime;
-static u8_t tmpage;
+static struct arp_entry UIP_CONTEXT_DECL(arp_table)[UIP_ARPTAB_SIZE];
+static UIP_CONTEXT_TLS u16_t ipaddr[2];
+static UIP_CONTEXT_TLS u8_t i, c;
+
+static u8_t UIP_CONTEXT_DECL(arptime);
+#if UIP_ARP_HASHSIZE == 0
+static UIP_CONTEXT_TLS u8_t tmpage;
+#endif /* UIP_ARP_HASHSIZE == 0 */
+
+#if UIP_ARP_HASHSIZE > 0
+static u8_t UIP_CONTEXT_DECL(arp_hash)[UIP_ARP_HASHSIZE];
+                             /* The arp_hash table holds the index +
+				1 of the first ARP table entry in each
+				hash chain, or 0 if the chain is
+				empty. */
+static u8_t UIP_CONTEXT_DECL(arp_next)[UIP_ARPTAB_SIZE];
+                             /* The arp_next array links the entries
+				within a hash chain. */
+static u16_t UIP_CONTEXT_DECL(arpused);
+                             /* Stamps the entries on every use, for
+				LRU replacement. */
+#endif /* UIP_ARP_HASHSIZE > 0 */
+
+#if UIP_ARP_QUEUE > 0
+static struct arp_pkt UIP_CONTEXT_DECL(arp_queue)[UIP_ARP_QUEUE];
+static u8_t UIP_CONTEXT_DECL(arpseq);
+#endif /* UIP_ARP_QUEUE > 0 */
+
+#if UIP_CONTEXTS > 0
+/* Make the ARP state of each stack refer to the current stack. */
+#define arp_table UIP_CONTEXT_REF(arp_table)
+#define arptime   UIP_CONTEXT_REF(arptime)
+#define arp_hash  UIP_CONTEXT_REF(arp_hash)
+#define arp_next  UIP_CONTEXT_REF(arp_next)
+#define arpused   UIP_CONTEXT_REF(arpused)
+#define arp_queue UIP_CONTEXT_REF(arp_queue)
+#define arpseq    UIP_CONTEXT_REF(arpseq)
+#endif /* UIP_CONTEXTS > 0 */
 
 #define BUF   ((struct arp_hdr *)&uip_buf[0])
 #define IPBUF ((struct ethip_hdr *)&uip_buf[0])
 /*-----------------------------------------------------------------------------------*/
+#if UIP_ARP_HASHSIZE > 0
+static u8_t
+arp_key(u16_t *ipaddr)
+{
+  u16_t h;
+
+  h = ipaddr[0] ^ ipaddr[1];
+  return (h ^ (h >> 8)) & (UIP_ARP_HASHSIZE - 1);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Unlink an ARP table entry from its hash chain. Must be called
+   before the IP address of the entry is changed. */
+static void
+arp_unhash(struct arp_entry *tabptr)
+{
+  u8_t *p, n;
+
+  n = (u8_t)(tabptr - arp_table) + 1;
+  for(p = &arp_hash[arp_key(tabptr->ipaddr)]; *p != 0; p = &arp_next[*p - 1]) {
+    if(*p == n) {
+      *p = arp_next[n - 1];
+      return;
+    }
+  }
+}
+#endif /* UIP_ARP_HASHSIZE > 0 */
+/*-----------------------------------------------------------------------------------*/
+/* Find the ARP table entry for an IP address. Returns NULL if there
+   is no such entry. */
+static struct arp_entry *
+arp_lookup(u16_t *ipaddr)
+{
+  struct arp_entry *tabptr;
+#if UIP_ARP_HASHSIZE > 0
+  u8_t n;
+
+  for(n = arp_hash[arp_key(ipaddr)]; n != 0; n = arp_next[n - 1]) {
+    tabptr = &arp_table[n - 1];
+    if(uip_ipaddr_cmp(ipaddr, tabptr->ipaddr)) {
+      tabptr->used = ++arpused;
+      return tabptr;
+    }
+  }
+#else /* UIP_ARP_HASHSIZE > 0 */
+  for(tabptr = arp_table; tabptr < &arp_table[UIP_ARPTAB_SIZE]; ++tabptr) {
+    if(uip_ipaddr_cmp(ipaddr, tabptr->ipaddr)) {
+      return tabptr;
+    }
+  }
+#endif /* UIP_ARP_HASHSIZE > 0 */
+  return NULL;
+}
+/*-----------------------------------------------------------------------------------*/
+#if UIP_ARP_QUEUE > 0
+/* Keep a copy of the outbound IP packet in uip_buf[] until the next
+   hop in ipaddr has been resolved. The packet is not queued if the
+   queue is full or if there already are UIP_ARP_QUEUE_DEST packets
+   waiting for the same next hop. */
+static void
+arp_enqueue(void)
+{
+  struct arp_pkt *q, *freeq;
+  u16_t hlen;
+
+  if(uip_len > sizeof(freeq->data)) {
+    return;
+  }
+  
+  freeq = NULL;
+  c = 0;
+  for(q = arp_queue; q < &arp_queue[UIP_ARP_QUEUE]; ++q) {
+    if(q->len == 0) {
+      freeq = q;
+    } else if(uip_ipaddr_cmp(q->ipaddr, ipaddr) &&
+	      ++c == UIP_ARP_QUEUE_DEST) {
+      return;
+    }
+  }
+  if(freeq == NULL) {
+    return;
+  }
+
+  /* The headers are in uip_buf[] and the rest of the packet is in
+     uip_appdata, just as for the device driver. */
+  hlen = uip_len < UIP_TCPIP_HLEN? uip_len: UIP_TCPIP_HLEN;
+  memcpy(freeq->data, &uip_buf[UIP_LLH_LEN], hlen);
+  memcpy(&freeq->data[hlen], uip_appdata, uip_len - hlen);
+  uip_ipaddr_copy(freeq->ipaddr, ipaddr);
+  freeq->len = uip_len;
+  freeq->time = arptime;
+  freeq->seq = arpseq++;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Check if there are packets queued for the next hop in addr. */
+static u8_t
+arp_queued(u16_t *addr)
+{
+  struct arp_pkt *q;
+
+  for(q = arp_queue; q < &arp_queue[UIP_ARP_QUEUE]; ++q) {
+    if(q->len != 0 && uip_ipaddr_cmp(q->ipaddr, addr)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+#endif /* UIP_ARP_QUEUE > 0 */
+/*-----------------------------------------------------------------------------------*/
 /**
  * Initialize the ARP module.
  *
@@ -127,6 +280,14 @@ uip_arp_init(void)
   for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
     memset(arp_table[i].ipaddr, 0, 4);
   }
+#if UIP_ARP_HASHSIZE > 0
+  memset(arp_hash, 0, sizeof(arp_hash));
+#endif /* UIP_ARP_HASHSIZE > 0 */
+#if UIP_ARP_QUEUE > 0
+  for(i = 0; i < UIP_ARP_QUEUE; ++i) {
+    arp_queue[i].len = 0;
+  }
+#endif /* UIP_ARP_QUEUE > 0 */
 }
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -148,38 +309,41 @@ uip_arp_timer(void)
     tabptr = &arp_table[i];
     if((tabptr->ipaddr[0] | tabptr->ipaddr[1]) != 0 &&
        arptime - tabptr->time >= UIP_ARP_MAXAGE) {
+#if UIP_ARP_HASHSIZE > 0
+      arp_unhash(tabptr);
+#endif /* UIP_ARP_HASHSIZE > 0 */
       memset(tabptr->ipaddr, 0, 4);
     }
   }
 
+#if UIP_ARP_QUEUE > 0
+  /* Drop the queued packets that have waited for a full timer
+     interval without their next hop being resolved. */
+  for(i = 0; i < UIP_ARP_QUEUE; ++i) {
+    if((u8_t)(arptime - arp_queue[i].time) >= 2) {
+      arp_queue[i].len = 0;
+    }
+  }
+#endif /* UIP_ARP_QUEUE > 0 */
+
 }
 /*-----------------------------------------------------------------------------------*/
 static void
 uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
 {
   register struct arp_entry *tabptr;
-  /* Walk through the ARP mapping table and try to find an entry to
-     update. If none is found, the IP -> MAC address mapping is
-     inserted in the ARP table. */
-  for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
-
-    tabptr = &arp_table[i];
-    /* Only check those entries that are actually in use. */
-    if(tabptr->ipaddr[0] != 0 &&
-       tabptr->ipaddr[1] != 0) {
-
-      /* Check if the source IP address of the incoming packet matches
-         the IP address in this ARP table entry. */
-      if(ipaddr[0] == tabptr->ipaddr[0] &&
-	 ipaddr[1] == tabptr->ipaddr[1]) {
-	 
-	/* An old entry found, update this and return. */
-	memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
-	tabptr->time = arptime;
-
-	return;
-      }
-    }
+#if UIP_ARP_HASHSIZE > 0
+  u16_t lru;
+#endif /* UIP_ARP_HASHSIZE > 0 */
+
+  /* Try to find an entry to update. If none is found, the IP -> MAC
+     address mapping is inserted in the ARP table. */
+  tabptr = arp_lookup(ipaddr);
+  if(tabptr != NULL) {
+    /* An old entry found, update this and return. */
+    memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
+    tabptr->time = arptime;
+    return;
   }
 
   /* If we get here, no existing ARP table entry was found, so we
@@ -195,8 +359,23 @@ uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
   }
 
   /* If no unused entry is found, we try to find the oldest entry and
-     throw it away. */
+     throw it away. With a hashed table, this is the entry that was
+     least recently used. */
   if(i == UIP_ARPTAB_SIZE) {
+#if UIP_ARP_HASHSIZE > 0
+    lru = 0;
+    c = 0;
+    for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
+      tabptr = &arp_table[i];
+      if((u16_t)(arpused - tabptr->used) > lru) {
+	lru = arpused - tabptr->used;
+	c = i;
+      }
+    }
+    i = c;
+    tabptr = &arp_table[i];
+    arp_unhash(tabptr);
+#else /* UIP_ARP_HASHSIZE > 0 */
     tmpage = 0;
     c = 0;
     for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
@@ -208,6 +387,7 @@ uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
     }
     i = c;
     tabptr = &arp_table[i];
+#endif /* UIP_ARP_HASHSIZE > 0 */
   }
 
   /* Now, i is the ARP table entry which we will fill with the new
@@ -215,6 +395,12 @@ uip_arp_update(u16_t *ipaddr, struct uip_eth_addr *ethaddr)
   memcpy(tabptr->ipaddr, ipaddr, 4);
   memcpy(tabptr->ethaddr.addr, ethaddr->addr, 6);
   tabptr->time = arptime;
+#if UIP_ARP_HASHSIZE > 0
+  tabptr->used = ++arpused;
+  c = arp_key(ipaddr);
+  arp_next[i] = arp_hash[c];
+  arp_hash[c] = i + 1;
+#endif /* UIP_ARP_HASHSIZE > 0 */
 }
 /*-----------------------------------------------------------------------------------*/
 /**
@@ -261,7 +447,13 @@ uip_arp_ipin(void)
  * that we previously sent out, the ARP cache will be filled in with
  * the values from the ARP reply. If the incoming ARP packet is an ARP
  * request for our IP address, an ARP reply packet is created and put
- * into the uip_buf[] buffer.
+ * into the uip_buf[] buffer. If UIP_ARP_QUEUE is set and the packet
+ * is an ARP reply, or an ARP request for another address from a host
+ * that queued packets are waiting for, the first queued IP packet for
+ * the newly resolved address is put into the uip_buf[] buffer
+ * instead. The queued packets that were not handed out, including
+ * those for the sender of an ARP request for our address, are
+ * fetched with uip_arp_flush().
  *
  * When the function returns, the value of the global variable uip_len
  * indicates whether the device driver should send out a packet or
@@ -311,6 +503,17 @@ uip_arp_arpin(void)
 
       BUF->ethhdr.type = HTONS(UIP_ETHTYPE_ARP);      
       uip_len = sizeof(struct arp_hdr);
+
+      /* If UIP_ARP_QUEUE is set, the packets that were waiting for
+	 the host are sent after the reply, by uip_arp_flush(). */
+#if UIP_ARP_QUEUE > 0
+    } else if(arp_queued(BUF->sipaddr)) {
+      /* A request for another address from a host that we are
+	 resolving tells us its Ethernet address as well as a reply
+	 would, so the packets that were waiting for it can go. */
+      uip_arp_update(BUF->sipaddr, &BUF->shwaddr);
+      uip_arp_flush();
+#endif /* UIP_ARP_QUEUE > 0 */
     }      
     break;
   case HTONS(ARP_REPLY):
@@ -320,6 +523,11 @@ uip_arp_arpin(void)
 	  BUF->dipaddr[1] == uip_hostaddr[1]) {*/
     if(uip_ipaddr_cmp(BUF->dipaddr, uip_hostaddr)) {
       uip_arp_update(BUF->sipaddr, &BUF->shwaddr);
+#if UIP_ARP_QUEUE > 0
+      /* Hand out the first of the packets that were waiting for
+	 this reply. */
+      uip_arp_flush();
+#endif /* UIP_ARP_QUEUE > 0 */
     }
     break;
   }
@@ -344,7 +552,9 @@ uip_arp_arpin(void)
  * destination IP address, the packet in the uip_buf[] is replaced by
  * an ARP request packet for the IP address. The IP packet is dropped
  * and it is assumed that they higher level protocols (e.g., TCP)
- * eventually will retransmit the dropped packet.
+ * eventually will retransmit the dropped packet. If UIP_ARP_QUEUE is
+ * set, a copy of the IP packet is queued first and is sent out by
+ * uip_arp_arpin() and uip_arp_flush() when the ARP reply arrives.
  *
  * If the destination IP address is not on the local network, the IP
  * address of the default router is used instead.
@@ -381,17 +591,16 @@ uip_arp_out(void)
       uip_ipaddr_copy(ipaddr, IPBUF->destipaddr); 
     }
       
-    for(i = 0; i < UIP_ARPTAB_SIZE; ++i) {
-      tabptr = &arp_table[i];
-      if(uip_ipaddr_cmp(ipaddr, tabptr->ipaddr)) {
-	break;
-      }
-    }
+    tabptr = arp_lookup(ipaddr);
 
-    if(i == UIP_ARPTAB_SIZE) {
+    if(tabptr == NULL) {
       /* The destination address was not in our ARP table, so we
 	 overwrite the IP packet with an ARP request. */
 
+#if UIP_ARP_QUEUE > 0
+      arp_enqueue();
+#endif /* UIP_ARP_QUEUE > 0 */
+
       memset(BUF->ethhdr.dest.addr, 0xff, 6);
       memset(BUF->dhwaddr.addr, 0x00, 6);
       memcpy(BUF->ethhdr.src.addr, uip_ethaddr.addr, 6);
@@ -422,6 +631,53 @@ uip_arp_out(void)
   uip_len += sizeof(struct uip_eth_hdr);
 }
 /*-----------------------------------------------------------------------------------*/
+#if UIP_ARP_QUEUE > 0
+/**
+ * Fetch a queued IP packet whose destination has been resolved.
+ *
+ * This function should be called by the device driver after a packet
+ * produced by uip_arp_arpin() has been sent out, and then again after
+ * each packet it produces, for as long as it produces packets. The
+ * oldest queued IP packet whose next hop now is in the ARP table is
+ * put into the uip_buf[] buffer with an Ethernet header prepended.
+ *
+ * When the function returns, the value of the global variable uip_len
+ * indicates whether the device driver should send out a packet or
+ * not. If uip_len is zero, no packet is waiting.
+ */
+/*-----------------------------------------------------------------------------------*/
+void
+uip_arp_flush(void)
+{
+  struct arp_pkt *q, *oldest;
+  struct arp_entry *tabptr;
+
+  uip_len = 0;
+  oldest = NULL;
+  for(q = arp_queue; q < &arp_queue[UIP_ARP_QUEUE]; ++q) {
+    if(q->len != 0 &&
+       (oldest == NULL ||
+	(u8_t)(arpseq - q->seq) > (u8_t)(arpseq - oldest->seq)) &&
+       arp_lookup(q->ipaddr) != NULL) {
+      oldest = q;
+    }
+  }
+  if(oldest == NULL) {
+    return;
+  }
+  tabptr = arp_lookup(oldest->ipaddr);
+
+  memcpy(&uip_buf[UIP_LLH_LEN], oldest->data, oldest->len);
+  uip_len = oldest->len + sizeof(struct uip_eth_hdr);
+  uip_appdata = &uip_buf[UIP_TCPIP_HLEN + UIP_LLH_LEN];
+  oldest->len = 0;
+
+  memcpy(IPBUF->ethhdr.dest.addr, tabptr->ethaddr.addr, 6);
+  memcpy(IPBUF->ethhdr.src.addr, uip_ethaddr.addr, 6);
+  IPBUF->ethhdr.type = HTONS(UIP_ETHTYPE_IP);
+}
+#endif /* UIP_ARP_QUEUE > 0 */
+/*-----------------------------------------------------------------------------------*/
 
 /** @} */
 /** @} */
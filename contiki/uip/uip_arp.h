@@ -55,7 +55,7 @@
 #include "uip.h"
 
 
-extern struct uip_eth_addr uip_ethaddr;
+extern struct uip_eth_addr UIP_CONTEXT_DECL(uip_ethaddr);
 
 /**
  * The Ethernet header. 
@@ -103,6 +103,16 @@ void uip_arp_arpin(void);
    the Ethernet frame that should be transmitted. */
 void uip_arp_out(void);
 
+/* If UIP_ARP_QUEUE is set, the uip_arp_flush() function should be
+   called after every call to uip_arp_arpin(), once the packet it
+   produced, if any, has been sent out. It is then called repeatedly
+   for as long as uip_len is > 0 on return. Each
+   call puts the next queued IP packet whose destination has been
+   resolved, with an Ethernet header, into the uip_buf buffer. */
+#if UIP_ARP_QUEUE > 0
+void uip_arp_flush(void);
+#endif /* UIP_ARP_QUEUE > 0 */
+
 /* The uip_arp_timer() function should be called every ten seconds. It
    is responsible for flushing old entries in the ARP table. */
 void uip_arp_timer(void);
@@ -187,14 +187,55 @@ typedef unsigned short uip_stats_t;
  *
  * \hideinitializer
  */
+#ifdef UIP_CONF_REASSEMBLY
+#define UIP_REASSEMBLY UIP_CONF_REASSEMBLY
+#else /* UIP_CONF_REASSEMBLY */
 #define UIP_REASSEMBLY 0
+#endif /* UIP_CONF_REASSEMBLY */
 
 /**
  * The maximum time an IP fragment should wait in the reassembly
  * buffer before it is dropped.
  *
+ * The time is counted in periodic timer pulses, 40 seconds by
+ * default.
  */
-#define UIP_REASS_MAXAGE 40
+#define UIP_REASS_MAXAGE (40 * UIP_TCP_TIMER_HZ)
+
+/**
+ * The number of IP datagrams that can be reassembled at the same
+ * time.
+ *
+ * Fragments are matched to a reassembly buffer by their source and
+ * destination addresses, IP ID and protocol, so that fragments from
+ * several datagrams may arrive interleaved. When a fragment of a new
+ * datagram arrives and all reassembly buffers are in use, the buffer
+ * that least recently received a fragment is reused. The reassembly
+ * code uses approximately (UIP_REASS_BUFSIZE * 65 / 64 + 7) bytes of
+ * memory per buffer.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_REASS_CONTEXTS
+#define UIP_REASS_CONTEXTS UIP_CONF_REASS_CONTEXTS
+#else /* UIP_CONF_REASS_CONTEXTS */
+#define UIP_REASS_CONTEXTS 1
+#endif /* UIP_CONF_REASS_CONTEXTS */
+
+/**
+ * The size of each reassembly buffer, including the IP header.
+ *
+ * Datagrams that are larger than this are dropped. The size should
+ * not be larger than the size of the uip_buf buffer minus the link
+ * level header, which is the default.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_REASS_BUFSIZE
+#define UIP_REASS_BUFSIZE UIP_CONF_REASS_BUFSIZE
+#else /* UIP_CONF_REASS_BUFSIZE */
+#define UIP_REASS_BUFSIZE (UIP_BUFSIZE - UIP_LLH_LEN)
+#endif /* UIP_CONF_REASS_BUFSIZE */
 
 /** @} */
 
@@ -245,6 +286,28 @@ typedef unsigned short uip_stats_t;
 #define UIP_UDP_CONNS    10
 #endif /* UIP_CONF_UDP_CONNS */
 
+/**
+ * The number of buckets in the UDP port hash table.
+ *
+ * If this is set to a non-zero value, uIP keeps the UDP connections
+ * hashed on their local port and only searches the connections bound
+ * to the destination port of an incoming datagram, instead of the
+ * entire connection table. This is useful only if UIP_UDP_CONNS is
+ * large. The number of buckets must be a power of two. Each bucket
+ * requires 1 byte of memory, and each connection requires an
+ * additional byte.
+ *
+ * \note With the hash table, the local port of a connection must
+ * only be changed with uip_udp_bind() and uip_udp_remove().
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_UDP_HASHSIZE
+#define UIP_UDP_HASHSIZE UIP_CONF_UDP_HASHSIZE
+#else /* UIP_CONF_UDP_HASHSIZE */
+#define UIP_UDP_HASHSIZE 0
+#endif /* UIP_CONF_UDP_HASHSIZE */
+
 /**
  * The name of the function that should be called when UDP datagrams arrive.
  *
@@ -300,6 +363,141 @@ typedef unsigned short uip_stats_t;
 #define UIP_LISTENPORTS UIP_CONF_MAX_LISTENPORTS       
 #endif /* UIP_CONF_MAX_LISTENPORTS */
 
+/**
+ * The number of SYNs that can be kept waiting for a free connection.
+ *
+ * When a SYN arrives for a listening port and all connections are in
+ * use, uIP normally drops the SYN and relies on the remote host to
+ * retransmit it, which may take several seconds. If this option is
+ * set, the SYN is instead put in a backlog that is shared by all
+ * listening ports, and the connection is accepted at the first
+ * periodic timer pulse after a connection has become free. Each
+ * backlog entry requires 14 bytes of memory.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_SYN_BACKLOG
+#define UIP_TCP_SYN_BACKLOG UIP_CONF_TCP_SYN_BACKLOG
+#else /* UIP_CONF_TCP_SYN_BACKLOG */
+#define UIP_TCP_SYN_BACKLOG 0
+#endif /* UIP_CONF_TCP_SYN_BACKLOG */
+
+/**
+ * The number of buckets in the TCP connection hash table.
+ *
+ * If this is set to a non-zero value, uIP keeps a hash table over the
+ * active TCP connections and uses it for finding the connection that
+ * an incoming segment belongs to, instead of searching through the
+ * entire connection table. This is useful only if UIP_CONNS is
+ * large. The number of buckets must be a power of two. Each bucket
+ * requires 2 bytes of memory, and each connection requires an
+ * additional 2 bytes.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_HASHSIZE
+#define UIP_TCP_HASHSIZE UIP_CONF_TCP_HASHSIZE
+#else /* UIP_CONF_TCP_HASHSIZE */
+#define UIP_TCP_HASHSIZE 0
+#endif /* UIP_CONF_TCP_HASHSIZE */
+
+/**
+ * The maximum number of unacknowledged TCP segments per connection.
+ *
+ * By default, uIP only allows a single segment in flight for each
+ * connection, and the application must be able to regenerate the
+ * data of that segment if it has to be retransmitted. If this is set
+ * to a value larger than one, every segment that is sent is copied
+ * into a retransmission buffer and the application is told that its
+ * data has been acknowledged as soon as there is room for another
+ * segment. uIP then does the retransmissions itself, without calling
+ * the application.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_WINDOW_SEGS
+#define UIP_TCP_WINDOW_SEGS UIP_CONF_TCP_WINDOW_SEGS
+#else /* UIP_CONF_TCP_WINDOW_SEGS */
+#define UIP_TCP_WINDOW_SEGS 1
+#endif /* UIP_CONF_TCP_WINDOW_SEGS */
+
+/**
+ * The number of TCP retransmission buffers.
+ *
+ * The retransmission buffers are shared by all connections and are
+ * only used if UIP_TCP_WINDOW_SEGS is larger than one. Each buffer
+ * requires UIP_TCP_MSS bytes of memory plus a few bytes of
+ * bookkeeping.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_REXMIT_SEGS
+#define UIP_TCP_REXMIT_SEGS UIP_CONF_TCP_REXMIT_SEGS
+#else /* UIP_CONF_TCP_REXMIT_SEGS */
+#define UIP_TCP_REXMIT_SEGS (2 * UIP_TCP_WINDOW_SEGS)
+#endif /* UIP_CONF_TCP_REXMIT_SEGS */
+
+/**
+ * The TCP window scale shift count that uIP advertises.
+ *
+ * If this is set to a non-zero value, uIP negotiates the TCP window
+ * scale option (RFC 7323) in its SYN and SYNACK segments. This makes
+ * it possible to set UIP_RECEIVE_WINDOW larger than 65535 bytes, and
+ * to use windows that the remote host advertises scaled. The shift
+ * count should be the smallest value for which UIP_RECEIVE_WINDOW
+ * shifted right this many bits fits in 16 bits, and may not be larger
+ * than 14. Window scaling requires one additional byte of memory per
+ * connection.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_WINDOW_SCALE
+#define UIP_TCP_WINDOW_SCALE UIP_CONF_TCP_WINDOW_SCALE
+#else /* UIP_CONF_TCP_WINDOW_SCALE */
+#define UIP_TCP_WINDOW_SCALE 0
+#endif /* UIP_CONF_TCP_WINDOW_SCALE */
+
+/**
+ * Determines if the TCP selective acknowledgment option should be
+ * used.
+ *
+ * If this option is set, uIP tells the remote host that it accepts
+ * selective acknowledgments (RFC 2018). A segment in the
+ * retransmission queue that the remote host reports missing while it
+ * has received later segments is retransmitted at once, without
+ * waiting for the retransmission timer. uIP never sends selective
+ * acknowledgments itself, since it does not keep segments that arrive
+ * out of order. This option is only used if UIP_TCP_WINDOW_SEGS is
+ * larger than one.
+ *
+ * \hideinitializer
+ */
+#if defined(UIP_CONF_TCP_SACK) && UIP_TCP_WINDOW_SEGS > 1
+#define UIP_TCP_SACK UIP_CONF_TCP_SACK
+#else /* UIP_CONF_TCP_SACK */
+#define UIP_TCP_SACK 0
+#endif /* UIP_CONF_TCP_SACK */
+
+/**
+ * The number of periodic timer ticks that a TCP ACK may be delayed.
+ *
+ * If this is set to a non-zero value, uIP does not acknowledge every
+ * incoming data segment on its own, but waits for either a second
+ * full-sized segment to arrive, for the application to send data on
+ * which the ACK can be piggybacked, or for this many calls to
+ * uip_periodic() (RFC 1122, section 4.2.3.2). Segments smaller than
+ * the MSS of the connection only wait for the timer. This roughly
+ * halves the number of packets sent during bulk downloads. Zero
+ * disables delayed ACKs.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_DELAYED_ACK
+#define UIP_TCP_DELAYED_ACK UIP_CONF_TCP_DELAYED_ACK
+#else /* UIP_CONF_TCP_DELAYED_ACK */
+#define UIP_TCP_DELAYED_ACK 0
+#endif /* UIP_CONF_TCP_DELAYED_ACK */
+
 /**
  * The size of the advertised receiver's window.
  *
@@ -307,6 +505,10 @@ typedef unsigned short uip_stats_t;
  * application is slow to process incoming data, or high (32768 bytes)
  * if the application processes data quickly.
  *
+ * \note The window may only be larger than 65535 bytes if
+ * UIP_TCP_WINDOW_SCALE is set, and is advertised as 65535 bytes to
+ * remote hosts that do not support window scaling.
+ *
  * \hideinitializer
  */
 #ifndef UIP_CONF_RECEIVE_WINDOW
@@ -326,12 +528,65 @@ typedef unsigned short uip_stats_t;
  */
 #define UIP_URGDATA      0
 
+/**
+ * The number of periodic timer pulses per second.
+ *
+ * All TCP timeouts are counted in periodic timer pulses. A higher
+ * rate gives a finer granularity of the retransmission timeout, but
+ * should only be used together with UIP_TCP_TIMER_WHEEL since every
+ * connection otherwise is processed at every pulse. The rate should
+ * not be set higher than 10.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_TIMER_HZ
+#define UIP_TCP_TIMER_HZ UIP_CONF_TCP_TIMER_HZ
+#else /* UIP_CONF_TCP_TIMER_HZ */
+#define UIP_TCP_TIMER_HZ 2
+#endif /* UIP_CONF_TCP_TIMER_HZ */
+
+/**
+ * Determines if the TCP timers should be kept in a timer wheel.
+ *
+ * By default, the periodic timer calls uip_periodic() for every
+ * connection at every pulse. If this option is set, uIP instead
+ * keeps the connections that have a pending retransmission, TIME_WAIT
+ * timeout, delayed ACK or poll in a two-level timer wheel, and only
+ * the connections that are due are processed (see uip_wheel_tick()).
+ * This requires 7 additional bytes of memory per connection.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_TIMER_WHEEL
+#define UIP_TCP_TIMER_WHEEL UIP_CONF_TCP_TIMER_WHEEL
+#else /* UIP_CONF_TCP_TIMER_WHEEL */
+#define UIP_TCP_TIMER_WHEEL 0
+#endif /* UIP_CONF_TCP_TIMER_WHEEL */
+
+/**
+ * The number of periodic timer pulses between application polls.
+ *
+ * Only used with UIP_TCP_TIMER_WHEEL. An idle connection is normally
+ * polled at every pulse, which means that it has to be processed at
+ * every pulse. Raising this value lets idle connections stay out of
+ * the timer wheel for longer; applications that need to send data
+ * earlier can request a poll with tcpip_poll_tcp(). The value must
+ * be less than 32768.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_TCP_POLL_TICKS
+#define UIP_TCP_POLL_TICKS UIP_CONF_TCP_POLL_TICKS
+#else /* UIP_CONF_TCP_POLL_TICKS */
+#define UIP_TCP_POLL_TICKS 1
+#endif /* UIP_CONF_TCP_POLL_TICKS */
+
 /**
  * The initial retransmission timeout counted in timer pulses.
  *
  * This should not be changed.
  */
-#define UIP_RTO         3
+#define UIP_RTO         ((3 * UIP_TCP_TIMER_HZ) / 2)
 
 /**
  * The maximum number of times a segment should be retransmitted
@@ -361,10 +616,19 @@ typedef unsigned short uip_stats_t;
 /**
  * How long a connection should stay in the TIME_WAIT state.
  *
+ * The time is counted in periodic timer pulses, 60 seconds by
+ * default. Since the TIME_WAIT timeout is kept in the 8-bit
+ * connection timer, it can be no longer than 255 pulses, and with
+ * an UIP_TCP_TIMER_HZ above 4 it is cut down to 255 pulses.
+ *
  * This configiration option has no real implication, and it should be
  * left untouched.
  */ 
-#define UIP_TIME_WAIT_TIMEOUT 120
+#if 60 * UIP_TCP_TIMER_HZ <= 255
+#define UIP_TIME_WAIT_TIMEOUT (60 * UIP_TCP_TIMER_HZ)
+#else /* 60 * UIP_TCP_TIMER_HZ <= 255 */
+#define UIP_TIME_WAIT_TIMEOUT 255
+#endif /* 60 * UIP_TCP_TIMER_HZ <= 255 */
 
 
 /** @} */
@@ -396,6 +660,58 @@ typedef unsigned short uip_stats_t;
  */
 #define UIP_ARP_MAXAGE 120
 
+/**
+ * The number of buckets in the ARP table hash.
+ *
+ * If this is set to a non-zero value, the ARP table is hashed on the
+ * IP address so that lookups do not have to search through the
+ * entire table, and a full table replaces its least recently used
+ * entry instead of the least recently updated one. This is useful
+ * only if UIP_ARPTAB_SIZE is large. The number of buckets must be a
+ * power of two. Each bucket requires 1 byte of memory, and each ARP
+ * table entry requires an additional 3 bytes.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_ARP_HASHSIZE
+#define UIP_ARP_HASHSIZE UIP_CONF_ARP_HASHSIZE
+#else /* UIP_CONF_ARP_HASHSIZE */
+#define UIP_ARP_HASHSIZE 0
+#endif /* UIP_CONF_ARP_HASHSIZE */
+
+/**
+ * The number of outgoing packets that can be held while their
+ * destination is being resolved.
+ *
+ * By default, uip_arp_out() replaces a packet for which there is no
+ * ARP table entry with an ARP request, and the packet is lost. If
+ * this option is set, a copy of the packet is kept and handed out by
+ * uip_arp_flush() when the ARP reply has arrived. Packets that have
+ * not been resolved are dropped at the next call to
+ * uip_arp_timer(). Each queued packet requires UIP_BUFSIZE bytes of
+ * memory plus a few bytes of bookkeeping.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_ARP_QUEUE
+#define UIP_ARP_QUEUE UIP_CONF_ARP_QUEUE
+#else /* UIP_CONF_ARP_QUEUE */
+#define UIP_ARP_QUEUE 0
+#endif /* UIP_CONF_ARP_QUEUE */
+
+/**
+ * The maximum number of queued packets for a single destination.
+ *
+ * Only used if UIP_ARP_QUEUE is set.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_ARP_QUEUE_DEST
+#define UIP_ARP_QUEUE_DEST UIP_CONF_ARP_QUEUE_DEST
+#else /* UIP_CONF_ARP_QUEUE_DEST */
+#define UIP_ARP_QUEUE_DEST 2
+#endif /* UIP_CONF_ARP_QUEUE_DEST */
+
 /** @} */
 
 /*------------------------------------------------------------------------------*/
@@ -420,6 +736,109 @@ typedef unsigned short uip_stats_t;
 #define UIP_BUFSIZE UIP_CONF_BUFFER_SIZE
 #endif /* UIP_CONF_BUFFER_SIZE */
 
+/**
+ * The number of packet buffers in the input ring.
+ *
+ * If this is set to a non-zero value, device drivers can read
+ * several incoming frames into a ring of packet buffers with
+ * tcpip_input_slot() and tcpip_input_put(), and tcpip_input()
+ * processes a burst of them in one call instead of one frame per
+ * call. Each buffer requires UIP_BUFSIZE + 2 bytes of memory, and each
+ * frame is copied into uip_buf before it is processed. If this is
+ * zero, uip_buf is the only packet buffer.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_INPUT_RING
+#define UIP_INPUT_RING UIP_CONF_INPUT_RING
+#else /* UIP_CONF_INPUT_RING */
+#define UIP_INPUT_RING 0
+#endif /* UIP_CONF_INPUT_RING */
+
+/**
+ * The maximum number of frames from the input ring that are
+ * processed by one call to tcpip_input().
+ *
+ * The remaining frames are processed when the TCP/IP process is
+ * polled next.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_INPUT_BURST
+#define UIP_INPUT_BURST UIP_CONF_INPUT_BURST
+#else /* UIP_CONF_INPUT_BURST */
+#define UIP_INPUT_BURST UIP_INPUT_RING
+#endif /* UIP_CONF_INPUT_BURST */
+
+/**
+ * The number of independent uIP stacks.
+ *
+ * If this is set to a non-zero value, the connections, listening
+ * ports, addresses, statistics, ARP table, forwarding interfaces and
+ * the rest of the state that uIP keeps between calls is held once for
+ * each of UIP_CONTEXTS stacks. All uIP functions work on the stack
+ * that has been selected with uip_setcontext(). The packet buffer and
+ * the other variables that are only used during a call into uIP are
+ * shared by the stacks. If this is zero, uIP is built as a single
+ * stack with its state in ordinary global variables.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONTEXTS
+#define UIP_CONTEXTS UIP_CONF_CONTEXTS
+#else /* UIP_CONF_CONTEXTS */
+#define UIP_CONTEXTS 0
+#endif /* UIP_CONF_CONTEXTS */
+
+/**
+ * The storage class of the variables that are only used during a
+ * call into uIP.
+ *
+ * The packet buffer, uip_len, uip_conn and the other per-call
+ * variables, as well as the stack selected with uip_setcontext(), are
+ * declared with this storage class. If it is set to a thread-local
+ * storage class, such as __thread with GCC, each thread gets its own
+ * packet buffer and can run a stack of its own concurrently with the
+ * other threads. Two threads must never select the same stack at the
+ * same time.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONTEXT_TLS
+#define UIP_CONTEXT_TLS UIP_CONF_CONTEXT_TLS
+#else /* UIP_CONF_CONTEXT_TLS */
+#define UIP_CONTEXT_TLS
+#endif /* UIP_CONF_CONTEXT_TLS */
+
+/**
+ * Determines if each stack is run by a thread of its own.
+ *
+ * If this is set, every thread runs a Contiki instance of its own,
+ * with its own ek kernel and tcpip process, and selects its stack
+ * with uip_setcontext() before calling tcpip_init(). The tcpip
+ * process then only handles the stack of its own thread, instead of
+ * all UIP_CONTEXTS stacks. This requires UIP_CONTEXT_TLS and
+ * CC_CONF_THREAD_LOCAL to be set to a thread-local storage class.
+ *
+ * \hideinitializer
+ */
+#ifdef UIP_CONF_CONTEXT_THREADS
+#define UIP_CONTEXT_THREADS UIP_CONF_CONTEXT_THREADS
+#else /* UIP_CONF_CONTEXT_THREADS */
+#define UIP_CONTEXT_THREADS 0
+#endif /* UIP_CONF_CONTEXT_THREADS */
+
+/* Declaring a variable with UIP_CONTEXT_DECL() gives it one instance
+   per stack if UIP_CONTEXTS is set, and the variable is then
+   redefined with UIP_CONTEXT_REF() to refer to the instance of the
+   current stack. */
+#if UIP_CONTEXTS > 0
+#define UIP_CONTEXT_DECL(name) name##_contexts[UIP_CONTEXTS]
+#define UIP_CONTEXT_REF(name)  name##_contexts[uip_context]
+#else /* UIP_CONTEXTS > 0 */
+#define UIP_CONTEXT_DECL(name) name
+#endif /* UIP_CONTEXTS > 0 */
+
 
 /**
  * Determines if statistics support should be compiled in.
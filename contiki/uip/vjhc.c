@@ -0,0 +1,522 @@
+/**
+ * \addtogroup uip
+ * @{
+ */
+
+/**
+ * \defgroup vjhc Van Jacobson TCP/IP header compression
+ * @{
+ *
+ * The TCP/IP header compression of RFC 1144, for slow serial links.
+ * It is used by the SLIP implementation in CSLIP mode and by the PPP
+ * implementation when IPCP has negotiated it.
+ */
+
+/**
+ * \file
+ * Van Jacobson TCP/IP header compression.
+ * \author Adam Dunkels <adam@sics.se>
+ */
+
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+
+#include "uip.h"
+#include "vjhc.h"
+
+#include <string.h>
+
+/* The bits of the first byte of a compressed header, which tell what
+   fields follow. */
+#define NEW_C  0x40     /* The slot number follows. */
+#define NEW_I  0x20     /* The IP identification changed by other than 1. */
+#define PUSH   0x10     /* The TCP push flag is set. */
+#define NEW_S  0x08
+#define NEW_A  0x04
+#define NEW_W  0x02
+#define NEW_U  0x01
+
+/* Combinations of the bits above that cannot occur, and that are used
+   for the two most common cases: echoed interactive traffic, where the
+   sequence and acknowledgement numbers both grow by the length of the
+   previous packet, and unidirectional data, where only the sequence
+   number does. */
+#define SPECIAL_I (NEW_S | NEW_W | NEW_U)
+#define SPECIAL_D (NEW_S | NEW_A | NEW_W | NEW_U)
+#define SPECIALS  SPECIAL_D
+
+#define TCP_FIN 0x01
+#define TCP_SYN 0x02
+#define TCP_RST 0x04
+#define TCP_PSH 0x08
+#define TCP_ACK 0x10
+#define TCP_URG 0x20
+
+/* The offset of the TCP header in a packet that is compressed. */
+#define TH UIP_IPH_LEN
+
+#if UIP_STATISTICS == 1
+#define VJHC_STAT(s) s
+#else /* UIP_STATISTICS == 1 */
+#define VJHC_STAT(s)
+#endif /* UIP_STATISTICS == 1 */
+
+/*-----------------------------------------------------------------------------------*/
+static u16_t
+get16(u8_t *p)
+{
+  return (p[0] << 8) | p[1];
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+put16(u8_t *p, u16_t v)
+{
+  p[0] = v >> 8;
+  p[1] = v;
+}
+/*-----------------------------------------------------------------------------------*/
+static unsigned long
+get32(u8_t *p)
+{
+  return ((unsigned long)get16(p) << 16) | get16(&p[2]);
+}
+/*-----------------------------------------------------------------------------------*/
+static void
+put32(u8_t *p, unsigned long v)
+{
+  put16(p, v >> 16);
+  put16(&p[2], v);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Put a difference in a compressed header. Differences of up to 255
+   take one byte, larger ones a zero byte and two bytes. A zero
+   difference is only sent for the fields that would otherwise be
+   left out (encodez). */
+static u8_t *
+encode(u8_t *cp, u16_t n)
+{
+  if(n >= 256) {
+    *cp++ = 0;
+    *cp++ = n >> 8;
+  }
+  *cp++ = n;
+  return cp;
+}
+/*-----------------------------------------------------------------------------------*/
+static u8_t *
+encodez(u8_t *cp, u16_t n)
+{
+  if(n == 0) {
+    *cp++ = 0;
+    *cp++ = 0;
+    *cp++ = 0;
+    return cp;
+  }
+  return encode(cp, n);
+}
+/*-----------------------------------------------------------------------------------*/
+/* Get a difference from a compressed header, or return NULL if the
+   header ends before the difference. */
+static u8_t *
+decode(u8_t *cp, u8_t *end, u16_t *n)
+{
+  if(cp >= end) {
+    return NULL;
+  }
+  if(*cp != 0) {
+    *n = *cp;
+    return cp + 1;
+  }
+  if(cp + 3 > end) {
+    return NULL;
+  }
+  *n = get16(&cp[1]);
+  return cp + 3;
+}
+/*-----------------------------------------------------------------------------------*/
+static u16_t
+ipchksum(u8_t *hdr, u8_t len)
+{
+  unsigned long sum;
+  u8_t i;
+
+  sum = 0;
+  for(i = 0; i < len; i += 2) {
+    sum += get16(&hdr[i]);
+  }
+  while(sum >> 16) {
+    sum = (sum & 0xffff) + (sum >> 16);
+  }
+  return ~sum;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+vjhc_init(struct vjhc *vj)
+{
+  memset(vj, 0, sizeof(struct vjhc));
+  vj->tx_slots = VJHC_SLOTS;
+  vj->tx_cid = 1;
+  vj->tx_last = 0xff;
+  /* Nothing can be decompressed before the first full header. */
+  vj->rx_toss = 1;
+}
+/*-----------------------------------------------------------------------------------*/
+/* Find the slot of the connection of the packet, and move it first in
+   the order in which the slots were used. If the connection has no
+   slot, the slot that was used the longest time ago is given to it
+   and 0 is returned. */
+static u8_t
+find(struct vjhc *vj, u8_t *hdr, u8_t *slot)
+{
+  u8_t i, s, found;
+  u8_t *old;
+
+  found = 0;
+  for(i = 0; i < vj->tx_used; ++i) {
+    old = vj->tx_hdr[vj->tx_order[i]];
+    if(memcmp(&old[12], &hdr[12], 8) == 0 &&
+       memcmp(&old[TH], &hdr[TH], 4) == 0) {
+      found = 1;
+      break;
+    }
+  }
+
+  if(!found) {
+    if(vj->tx_used < vj->tx_slots) {
+      i = vj->tx_used++;
+      vj->tx_order[i] = i;
+    } else {
+      i = vj->tx_used - 1;
+    }
+  }
+
+  s = vj->tx_order[i];
+  for(; i > 0; --i) {
+    vj->tx_order[i] = vj->tx_order[i - 1];
+  }
+  vj->tx_order[0] = s;
+  *slot = s;
+  return found;
+}
+/*-----------------------------------------------------------------------------------*/
+u8_t
+vjhc_compress(struct vjhc *vj, u8_t *hdr, u16_t len,
+	      u8_t *out, u8_t *outlen)
+{
+  u8_t deltas[16];
+  u8_t *old, *cp;
+  u8_t s, changes;
+  u16_t d, oldlen;
+  unsigned long ds, da;
+
+  /* Only TCP segments that carry an acknowledgement and no SYN, FIN
+     or RST, and that have no IP or TCP options, are compressed. */
+  if(vj->tx_slots == 0 ||
+     len < UIP_TCPIP_HLEN ||
+     hdr[0] != 0x45 ||
+     (hdr[6] & 0x3f) != 0 || hdr[7] != 0 ||
+     hdr[9] != UIP_PROTO_TCP ||
+     (hdr[TH + 12] >> 4) != 5 ||
+     (hdr[TH + 13] & (TCP_SYN | TCP_FIN | TCP_RST | TCP_ACK)) != TCP_ACK) {
+    VJHC_STAT(++vj->stats.sent_ip);
+    return VJHC_TYPE_IP;
+  }
+
+  if(!find(vj, hdr, &s)) {
+    goto uncompressed;
+  }
+  old = vj->tx_hdr[s];
+
+  /* The fields that are not sent in a compressed header must be the
+     same as in the previous packet: the version, header length and
+     type of service, the fragment bits, the TTL and the protocol. */
+  if(hdr[1] != old[1] ||
+     hdr[6] != old[6] ||
+     hdr[8] != old[8]) {
+    goto uncompressed;
+  }
+
+  changes = 0;
+  cp = deltas;
+
+  if(hdr[TH + 13] & TCP_URG) {
+    cp = encodez(cp, get16(&hdr[TH + 18]));
+    changes |= NEW_U;
+  } else if(get16(&hdr[TH + 18]) != get16(&old[TH + 18])) {
+    goto uncompressed;
+  }
+
+  d = get16(&hdr[TH + 14]) - get16(&old[TH + 14]);
+  if(d != 0) {
+    cp = encode(cp, d);
+    changes |= NEW_W;
+  }
+
+  da = (get32(&hdr[TH + 8]) - get32(&old[TH + 8])) & 0xffffffffUL;
+  if(da != 0) {
+    if(da > 0xffff) {
+      goto uncompressed;
+    }
+    cp = encode(cp, da);
+    changes |= NEW_A;
+  }
+
+  ds = (get32(&hdr[TH + 4]) - get32(&old[TH + 4])) & 0xffffffffUL;
+  if(ds != 0) {
+    if(ds > 0xffff) {
+      goto uncompressed;
+    }
+    cp = encode(cp, ds);
+    changes |= NEW_S;
+  }
+
+  oldlen = get16(&old[2]);
+  switch(changes) {
+  case 0:
+    /* Nothing changed. This is either a data packet after a pure
+       acknowledgement, or a retransmission or window probe, which is
+       sent with a full header so that the peer can recover if the
+       previous packet was lost. */
+    if(get16(&hdr[2]) != oldlen && oldlen == UIP_TCPIP_HLEN) {
+      break;
+    }
+    goto uncompressed;
+  case SPECIAL_I:
+  case SPECIAL_D:
+    /* These would be taken for the special cases below. */
+    goto uncompressed;
+  case NEW_S | NEW_A:
+    if(ds == da && ds == oldlen - UIP_TCPIP_HLEN) {
+      changes = SPECIAL_I;
+      cp = deltas;
+    }
+    break;
+  case NEW_S:
+    if(ds == oldlen - UIP_TCPIP_HLEN) {
+      changes = SPECIAL_D;
+      cp = deltas;
+    }
+    break;
+  }
+
+  d = get16(&hdr[4]) - get16(&old[4]);
+  if(d != 1) {
+    cp = encodez(cp, d);
+    changes |= NEW_I;
+  }
+  if(hdr[TH + 13] & TCP_PSH) {
+    changes |= PUSH;
+  }
+
+  memcpy(old, hdr, UIP_TCPIP_HLEN);
+
+  /* The changes, the slot number if needed, the TCP checksum, and the
+     differences. */
+  *outlen = 0;
+  if(!vj->tx_cid || vj->tx_last != s) {
+    vj->tx_last = s;
+    out[(*outlen)++] = changes | NEW_C;
+    out[(*outlen)++] = s;
+  } else {
+    out[(*outlen)++] = changes;
+  }
+  out[(*outlen)++] = hdr[TH + 16];
+  out[(*outlen)++] = hdr[TH + 17];
+  memcpy(&out[*outlen], deltas, cp - deltas);
+  *outlen += cp - deltas;
+  VJHC_STAT(++vj->stats.sent_comp);
+  return VJHC_TYPE_COMPRESSED_TCP;
+
+ uncompressed:
+  /* The full header is sent with the slot number in place of the
+     protocol, which the peer knows is TCP. */
+  memcpy(vj->tx_hdr[s], hdr, UIP_TCPIP_HLEN);
+  vj->tx_last = s;
+  memcpy(out, hdr, UIP_TCPIP_HLEN);
+  out[9] = s;
+  *outlen = UIP_TCPIP_HLEN;
+  VJHC_STAT(++vj->stats.sent_uncomp);
+  return VJHC_TYPE_UNCOMPRESSED_TCP;
+}
+/*-----------------------------------------------------------------------------------*/
+u16_t
+vjhc_uncompress(struct vjhc *vj, u8_t type, u8_t *buf, u16_t len,
+		u8_t *out, u16_t maxlen)
+{
+  u8_t *cp, *end, *hdr, *th;
+  u8_t s, changes, iphlen, hlen;
+  u16_t d, oldlen;
+
+  if(len > maxlen) {
+    goto bad;
+  }
+
+  if(type == VJHC_TYPE_IP) {
+    memcpy(out, buf, len);
+    return len;
+  }
+
+  if(type == VJHC_TYPE_UNCOMPRESSED_TCP) {
+    if(len < UIP_IPH_LEN) {
+      goto bad;
+    }
+    s = buf[9];
+    iphlen = (buf[0] & 0x0f) << 2;
+    if(s >= VJHC_SLOTS || iphlen < UIP_IPH_LEN || len < iphlen + 20) {
+      goto bad;
+    }
+    hlen = iphlen + ((buf[iphlen + 12] >> 4) << 2);
+    if(hlen > VJHC_MAXHDR || len < hlen) {
+      vj->rx_hlen[s] = 0;
+      goto bad;
+    }
+    memcpy(out, buf, len);
+    out[9] = UIP_PROTO_TCP;
+    memcpy(vj->rx_hdr[s], out, hlen);
+    vj->rx_hlen[s] = hlen;
+    vj->rx_last = s;
+    vj->rx_toss = 0;
+    VJHC_STAT(++vj->stats.recv_uncomp);
+    return len;
+  }
+
+  cp = buf;
+  end = buf + len;
+  if(len < 3) {
+    goto bad;
+  }
+  changes = *cp++;
+  if(changes & NEW_C) {
+    if(*cp >= VJHC_SLOTS) {
+      goto bad;
+    }
+    vj->rx_toss = 0;
+    vj->rx_last = *cp++;
+  } else if(vj->rx_toss) {
+    VJHC_STAT(++vj->stats.recv_tossed);
+    return 0;
+  }
+
+  s = vj->rx_last;
+  hlen = vj->rx_hlen[s];
+  if(hlen == 0 || cp + 2 > end) {
+    goto bad;
+  }
+  hdr = vj->rx_hdr[s];
+  iphlen = (hdr[0] & 0x0f) << 2;
+  th = &hdr[iphlen];
+
+  th[16] = *cp++;
+  th[17] = *cp++;
+  if(changes & PUSH) {
+    th[13] |= TCP_PSH;
+  } else {
+    th[13] &= ~TCP_PSH;
+  }
+
+  oldlen = get16(&hdr[2]);
+  switch(changes & SPECIALS) {
+  case SPECIAL_I:
+    d = oldlen - hlen;
+    put32(&th[8], get32(&th[8]) + d);
+    put32(&th[4], get32(&th[4]) + d);
+    break;
+  case SPECIAL_D:
+    put32(&th[4], get32(&th[4]) + (u16_t)(oldlen - hlen));
+    break;
+  default:
+    if(changes & NEW_U) {
+      th[13] |= TCP_URG;
+      if((cp = decode(cp, end, &d)) == NULL) {
+	goto bad;
+      }
+      put16(&th[18], d);
+    } else {
+      th[13] &= ~TCP_URG;
+    }
+    if(changes & NEW_W) {
+      if((cp = decode(cp, end, &d)) == NULL) {
+	goto bad;
+      }
+      put16(&th[14], get16(&th[14]) + d);
+    }
+    if(changes & NEW_A) {
+      if((cp = decode(cp, end, &d)) == NULL) {
+	goto bad;
+      }
+      put32(&th[8], get32(&th[8]) + d);
+    }
+    if(changes & NEW_S) {
+      if((cp = decode(cp, end, &d)) == NULL) {
+	goto bad;
+      }
+      put32(&th[4], get32(&th[4]) + d);
+    }
+    break;
+  }
+  if(changes & NEW_I) {
+    if((cp = decode(cp, end, &d)) == NULL) {
+      goto bad;
+    }
+  } else {
+    d = 1;
+  }
+  put16(&hdr[4], get16(&hdr[4]) + d);
+
+  /* The rest of the packet is the TCP data. */
+  len = end - cp;
+  if(hlen + len > maxlen) {
+    goto bad;
+  }
+  put16(&hdr[2], hlen + len);
+  hdr[10] = hdr[11] = 0;
+  put16(&hdr[10], ipchksum(hdr, iphlen));
+
+  memcpy(out, hdr, hlen);
+  memcpy(&out[hlen], cp, len);
+  VJHC_STAT(++vj->stats.recv_comp);
+  return hlen + len;
+
+ bad:
+  vj->rx_toss = 1;
+  VJHC_STAT(++vj->stats.recv_error);
+  return 0;
+}
+/*-----------------------------------------------------------------------------------*/
+void
+vjhc_error(struct vjhc *vj)
+{
+  vj->rx_toss = 1;
+}
+/*-----------------------------------------------------------------------------------*/
+/** @} */
+/** @} */
@@ -0,0 +1,223 @@
+/**
+ * \addtogroup vjhc
+ * @{
+ */
+
+/**
+ * \file
+ * Van Jacobson TCP/IP header compression.
+ * \author Adam Dunkels <adam@sics.se>
+ */
+
+/*
+ * Copyright (c) 2005, Swedish Institute of Computer Science.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the Institute nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE INSTITUTE AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE INSTITUTE OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * This file is part of the uIP TCP/IP stack.
+ *
+ */
+#ifndef __VJHC_H__
+#define __VJHC_H__
+
+#include "uip.h"
+
+/*
+ * The header compression replaces the 40 bytes of TCP/IP header of
+ * the packets of a TCP connection with the differences from the
+ * previous packet of the connection, typically 3 to 5 bytes. It is
+ * meant for slow serial links such as SLIP (CSLIP) and PPP.
+ *
+ * Each end of a link keeps the last header of a number of
+ * connections in slots. The state is kept in a struct vjhc that the
+ * link driver allocates, one per link, and that holds the slots of
+ * both directions.
+ *
+ * A packet is sent as one of three types. The link layer tells the
+ * peer the type, in the protocol field of PPP or in the first byte of
+ * the packet with CSLIP:
+ *
+ * - VJHC_TYPE_IP: the packet is not TCP, or cannot be compressed,
+ *   and is sent unchanged.
+ * - VJHC_TYPE_UNCOMPRESSED_TCP: the full header is sent with the slot
+ *   number in the protocol field of the IP header, so that the peer
+ *   can store the header in the slot.
+ * - VJHC_TYPE_COMPRESSED_TCP: the header is sent compressed.
+ *
+ * Example:
+ \code
+ static struct vjhc vj;
+ u8_t hdr[UIP_TCPIP_HLEN], hdrlen, type;
+
+ vjhc_init(&vj);
+ ...
+ type = vjhc_compress(&vj, &uip_buf[UIP_LLH_LEN], uip_len, hdr, &hdrlen);
+ if(type == VJHC_TYPE_IP) {
+   send(&uip_buf[UIP_LLH_LEN], UIP_TCPIP_HLEN, type);
+ } else {
+   send(hdr, hdrlen, type);
+ }
+ send(uip_appdata, uip_len - UIP_TCPIP_HLEN, type);
+ ...
+ uip_len = vjhc_uncompress(&vj, type, buf, len,
+			   &uip_buf[UIP_LLH_LEN], UIP_BUFSIZE - UIP_LLH_LEN);
+ \endcode
+ */
+
+/**
+ * The number of connections whose headers are kept in each direction.
+ *
+ * CSLIP has no negotiation, and peers use 16 slots.
+ *
+ * \hideinitializer
+ */
+#ifdef VJHC_CONF_SLOTS
+#define VJHC_SLOTS VJHC_CONF_SLOTS
+#else /* VJHC_CONF_SLOTS */
+#define VJHC_SLOTS 16
+#endif /* VJHC_CONF_SLOTS */
+
+/**
+ * The largest header that is kept for the packets from the peer: an
+ * IP header without options and a TCP header with 40 bytes of
+ * options.
+ */
+#define VJHC_MAXHDR (UIP_IPH_LEN + 60)
+
+#define VJHC_TYPE_IP               0
+#define VJHC_TYPE_UNCOMPRESSED_TCP 1
+#define VJHC_TYPE_COMPRESSED_TCP   2
+
+/**
+ * The counters of the packets that have been compressed and
+ * decompressed.
+ */
+struct vjhc_stats {
+  uip_stats_t sent_ip;        /**< Packets sent unchanged. */
+  uip_stats_t sent_uncomp;    /**< Packets sent with a full header. */
+  uip_stats_t sent_comp;      /**< Packets sent with a compressed header. */
+  uip_stats_t recv_uncomp;    /**< Packets received with a full header. */
+  uip_stats_t recv_comp;      /**< Packets received with a compressed
+				 header. */
+  uip_stats_t recv_error;     /**< Packets dropped because they could not
+				 be decompressed. */
+  uip_stats_t recv_tossed;    /**< Compressed packets dropped after an
+				 error. */
+};
+
+/**
+ * The compression state of a link.
+ */
+struct vjhc {
+  u8_t tx_slots;              /**< The number of slots that the peer
+				 decompresses with, or zero if all
+				 packets are sent unchanged. */
+  u8_t tx_cid;                /**< Non-zero if the slot number may be
+				 left out when it is the same as in the
+				 previous packet. */
+  u8_t tx_used, tx_last;
+  u8_t tx_order[VJHC_SLOTS];
+  u8_t tx_hdr[VJHC_SLOTS][UIP_TCPIP_HLEN];
+
+  u8_t rx_last, rx_toss;
+  u8_t rx_hlen[VJHC_SLOTS];
+  u8_t rx_hdr[VJHC_SLOTS][VJHC_MAXHDR];
+
+#if UIP_STATISTICS == 1
+  struct vjhc_stats stats;
+#endif /* UIP_STATISTICS == 1 */
+};
+
+/**
+ * Initialize the compression state of a link.
+ *
+ * All slots are emptied, and tx_slots is set to VJHC_SLOTS and tx_cid
+ * to 1, which is what CSLIP uses. PPP sets them from the result of
+ * the IPCP negotiation.
+ */
+void vjhc_init(struct vjhc *vj);
+
+/**
+ * Compress the header of an outgoing packet.
+ *
+ * Only TCP packets with a 40 byte header are compressed, which are
+ * all the packets that uIP sends except the SYN packets.
+ *
+ * \param vj The compression state of the link.
+ *
+ * \param hdr The first 40 bytes of the packet, or all of it if it is
+ * shorter. The header is not modified.
+ *
+ * \param len The length of the packet.
+ *
+ * \param out A buffer of UIP_TCPIP_HLEN bytes that is filled in with
+ * the header that is to be sent instead of the first 40 bytes of the
+ * packet, unless the packet is sent unchanged.
+ *
+ * \param outlen Filled in with the length of the header in out.
+ *
+ * \return The type of the packet.
+ */
+u8_t vjhc_compress(struct vjhc *vj, u8_t *hdr, u16_t len,
+		   u8_t *out, u8_t *outlen);
+
+/**
+ * Decompress an incoming packet.
+ *
+ * \param vj The compression state of the link.
+ *
+ * \param type The type of the packet, as given by the link layer.
+ *
+ * \param buf The packet as it was received, with the IP version
+ * restored in the first byte if the link layer stores the type
+ * there. The buffer must not overlap out.
+ *
+ * \param len The length of the packet in buf.
+ *
+ * \param out The buffer that the packet is written to with its full
+ * header.
+ *
+ * \param maxlen The size of out.
+ *
+ * \return The length of the packet in out, or zero if the packet was
+ * dropped.
+ */
+u16_t vjhc_uncompress(struct vjhc *vj, u8_t type, u8_t *buf, u16_t len,
+		      u8_t *out, u16_t maxlen);
+
+/**
+ * Tell the decompressor that a packet was lost on the link.
+ *
+ * The compressed packets that follow are dropped until a packet with
+ * a full header or a slot number arrives, since they would otherwise
+ * be decompressed against the wrong header. The link layer calls
+ * this function when it drops a damaged frame.
+ */
+void vjhc_error(struct vjhc *vj);
+
+#endif /* __VJHC_H__ */
+
+/** @} */